@@ -1,6 +1,12 @@
 #include "pch.h"
 #include "Application.h"
 #include "Charon/Graphics/VulkanAllocator.h"
+#include "Charon/Graphics/GeometryPool.h"
+#include "Charon/Graphics/BindlessDescriptorSet.h"
+#include "Charon/Graphics/UniformBufferRing.h"
+#include "Charon/Graphics/ResidencyManager.h"
+#include "Charon/Graphics/LayoutCache.h"
+#include "Charon/Graphics/PipelineCache.h"
 #include "Charon/Asset/AssetManager.h"
 #include <imgui.h>
 
@@ -28,10 +34,18 @@ namespace Charon {
 		// Vulkan shutdown
 		m_SwapChain.reset();
 		AssetManager::Clear();
+		ResidencyManager::Shutdown();
+		BindlessDescriptorSet::Shutdown();
+		UniformBufferRing::Shutdown();
+		LayoutCache::Shutdown();
+		PipelineCache::Shutdown();
+		GeometryPool::Shutdown();
 		VulkanAllocator::Shutdown();
 		m_Device.reset();
 		m_Window.reset();
 		m_VulkanInstance.reset();
+
+		m_ThreadPool.reset();
 	}
 
 	void Application::Init()
@@ -40,6 +54,8 @@ namespace Charon {
 		s_Instance = this;
 
 		Log::Init();
+
+		m_ThreadPool = CreateRef<ThreadPool>();
 		
 		// Vulkan initialization
 		m_Window = CreateRef<Window>(m_Name, 1280, 720);
@@ -48,6 +64,12 @@ namespace Charon {
 		m_Device = CreateRef<VulkanDevice>();
 		m_SwapChain = CreateRef<SwapChain>();
 		VulkanAllocator::Init(m_Device);
+		PipelineCache::Init();
+		LayoutCache::Init();
+		GeometryPool::Init();
+		BindlessDescriptorSet::Init();
+		UniformBufferRing::Init();
+		ResidencyManager::Init();
 
 		m_Renderer = CreateRef<Renderer>();
 		m_ImGUILayer = CreateRef<ImGuiLayer>();
@@ -6,6 +6,7 @@
 #include "Charon/Graphics/SwapChain.h"
 #include "Charon/Graphics/Renderer.h"
 #include "Charon/Core/Layer.h"
+#include "Charon/Core/ThreadPool.h"
 
 namespace Charon {
 
@@ -22,6 +23,7 @@ namespace Charon {
 
 		inline Ref<Window> GetWindow() { return m_Window; }
 		inline Ref<Renderer> GetRenderer() { return m_Renderer; }
+		inline Ref<ThreadPool> GetThreadPool() { return m_ThreadPool; }
 
 		inline Ref<VulkanInstance> GetVulkanInstance() { return m_VulkanInstance; }
 		inline Ref<VulkanDevice> GetVulkanDevice() { return m_Device; }
@@ -45,6 +47,7 @@ namespace Charon {
 		Ref<ImGuiLayer> m_ImGUILayer;
 
 		Ref<Renderer> m_Renderer;
+		Ref<ThreadPool> m_ThreadPool;
 
 		Ref<VulkanInstance> m_VulkanInstance;
 		Ref<VulkanDevice> m_Device;
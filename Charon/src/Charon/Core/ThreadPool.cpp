@@ -0,0 +1,119 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+namespace Charon {
+
+	ThreadPool::ThreadPool(uint32_t workerCount)
+	{
+		if (workerCount == 0)
+			workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+		m_Workers.reserve(workerCount);
+		for (uint32_t i = 0; i < workerCount; i++)
+			m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+
+		CR_LOG_INFO("Initialized ThreadPool; workers = {0}", workerCount);
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Running = false;
+		}
+
+		m_Condition.notify_all();
+		for (std::thread& worker : m_Workers)
+			worker.join();
+	}
+
+	void ThreadPool::Submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Tasks.push(std::move(task));
+		}
+
+		m_Condition.notify_one();
+	}
+
+	void ThreadPool::ParallelFor(uint32_t count, uint32_t minChunkSize, const std::function<void(uint32_t, uint32_t, uint32_t)>& function)
+	{
+		if (count == 0)
+			return;
+
+		minChunkSize = std::max(minChunkSize, 1u);
+		uint32_t chunkCount = std::min(GetSlotCount(), (count + minChunkSize - 1) / minChunkSize);
+		uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+		chunkCount = (count + chunkSize - 1) / chunkSize;
+
+		if (chunkCount == 1)
+		{
+			function(0, count, 0);
+			return;
+		}
+
+		// Helpers that only get to run after every chunk was claimed find nothing left and return, so they share the state
+		auto data = std::make_shared<ParallelForData>();
+		data->Function = &function;
+		data->Count = count;
+		data->ChunkSize = chunkSize;
+		data->ChunkCount = chunkCount;
+		data->Remaining = chunkCount;
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (uint32_t i = 1; i < chunkCount; i++)
+				m_ParallelForTasks.push([data]() { RunChunks(*data); });
+		}
+
+		m_Condition.notify_all();
+
+		RunChunks(*data);
+
+		// Only chunks that are already running on other threads are left
+		std::unique_lock<std::mutex> lock(data->DoneMutex);
+		data->DoneCondition.wait(lock, [&]() { return data->Remaining == 0; });
+	}
+
+	void ThreadPool::RunChunks(ParallelForData& data)
+	{
+		while (true)
+		{
+			uint32_t chunk = data.NextChunk.fetch_add(1);
+			if (chunk >= data.ChunkCount)
+				return;
+
+			uint32_t begin = chunk * data.ChunkSize;
+			uint32_t end = std::min(begin + data.ChunkSize, data.Count);
+			(*data.Function)(begin, end, chunk);
+
+			std::lock_guard<std::mutex> lock(data.DoneMutex);
+			if (--data.Remaining == 0)
+				data.DoneCondition.notify_one();
+		}
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(m_Mutex);
+				m_Condition.wait(lock, [this]() { return !m_Running || !m_ParallelForTasks.empty() || !m_Tasks.empty(); });
+
+				if (!m_Running && m_ParallelForTasks.empty() && m_Tasks.empty())
+					return;
+
+				// Frame work goes ahead of background builds
+				std::queue<std::function<void()>>& queue = !m_ParallelForTasks.empty() ? m_ParallelForTasks : m_Tasks;
+				task = std::move(queue.front());
+				queue.pop();
+			}
+
+			task();
+		}
+	}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace Charon {
+
+	class ThreadPool
+	{
+	public:
+		// Defaults to one worker per hardware thread, minus the calling thread
+		ThreadPool(uint32_t workerCount = 0);
+		~ThreadPool();
+
+	public:
+		// Background work such as shader and pipeline builds, runs after any queued ParallelFor work
+		void Submit(std::function<void()> task);
+
+		// Splits [0, count) into at most GetSlotCount() contiguous chunks of at least minChunkSize and blocks until all are done.
+		// function(begin, end, slot) is never run concurrently for the same slot, so slots can index per-thread resources.
+		// The calling thread claims chunks too, so it never waits on chunks that haven't started. Safe to call from tasks
+		// running on the pool.
+		void ParallelFor(uint32_t count, uint32_t minChunkSize, const std::function<void(uint32_t, uint32_t, uint32_t)>& function);
+
+		uint32_t GetWorkerCount() const { return (uint32_t)m_Workers.size(); }
+		uint32_t GetSlotCount() const { return (uint32_t)m_Workers.size() + 1; }
+
+	private:
+		struct ParallelForData
+		{
+			const std::function<void(uint32_t, uint32_t, uint32_t)>* Function = nullptr;
+			uint32_t Count = 0;
+			uint32_t ChunkSize = 0;
+			uint32_t ChunkCount = 0;
+
+			std::atomic<uint32_t> NextChunk{ 0 };
+			uint32_t Remaining = 0;
+			std::mutex DoneMutex;
+			std::condition_variable DoneCondition;
+		};
+
+		// Runs unclaimed chunks until there are none left
+		static void RunChunks(ParallelForData& data);
+
+		void WorkerLoop();
+
+	private:
+		std::vector<std::thread> m_Workers;
+		std::queue<std::function<void()>> m_ParallelForTasks;
+		std::queue<std::function<void()>> m_Tasks;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_Condition;
+		bool m_Running = true;
+	};
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "Charon/Core/Core.h"
+#include "Charon/Core/Application.h"
+#include <future>
+
+namespace Charon {
+
+	// Holds a pipeline that is rebuilt on the thread pool without stalling the frame.
+	// The current pipeline stays in use while a build runs, Update swaps the new one in at a frame boundary.
+	template<typename T>
+	class AsyncPipeline
+	{
+	public:
+		// Returns nullptr when compilation fails, the current pipeline is kept in that case
+		using BuildFunction = std::function<Ref<T>()>;
+
+	public:
+		AsyncPipeline() = default;
+		~AsyncPipeline() { Wait(); }
+
+	public:
+		void Rebuild(BuildFunction build)
+		{
+			if (IsBuilding())
+			{
+				// Only the latest request matters, it starts once the running build is done
+				m_QueuedBuild = std::move(build);
+				return;
+			}
+
+			auto promise = std::make_shared<std::promise<Ref<T>>>();
+			m_Build = promise->get_future();
+
+			Application::GetApp().GetThreadPool()->Submit([promise, build = std::move(build)]()
+			{
+				promise->set_value(build());
+			});
+		}
+
+		// Call once per frame before recording, returns true when a new pipeline was swapped in
+		bool Update()
+		{
+			RetireOldPipelines();
+
+			if (!IsBuilding() || m_Build.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				return false;
+
+			Ref<T> pipeline = m_Build.get();
+			if (pipeline)
+			{
+				// Frames in flight may still use the old pipeline
+				if (m_Pipeline)
+					m_RetiredPipelines.push_back({ Application::GetApp().GetRenderer()->GetFrameCounter(), m_Pipeline });
+
+				m_Pipeline = pipeline;
+			}
+
+			if (m_QueuedBuild)
+				Rebuild(std::exchange(m_QueuedBuild, nullptr));
+
+			return pipeline != nullptr;
+		}
+
+		// Replaces the pipeline immediately, for pipelines built synchronously at startup
+		void Set(Ref<T> pipeline) { m_Pipeline = pipeline; }
+
+		// Waits for a running build, used before destroying anything the build reads
+		void Wait()
+		{
+			if (IsBuilding())
+				m_Build.wait();
+		}
+
+		Ref<T> Get() const { return m_Pipeline; }
+		bool IsReady() const { return m_Pipeline != nullptr; }
+		bool IsBuilding() const { return m_Build.valid(); }
+
+	private:
+		void RetireOldPipelines()
+		{
+			uint64_t frame = Application::GetApp().GetRenderer()->GetFrameCounter();
+			uint32_t framesInFlight = Application::GetApp().GetVulkanSwapChain()->GetFramesInFlight();
+
+			auto it = std::remove_if(m_RetiredPipelines.begin(), m_RetiredPipelines.end(), [&](const auto& retired) { return frame - retired.first > framesInFlight; });
+			m_RetiredPipelines.erase(it, m_RetiredPipelines.end());
+		}
+
+	private:
+		Ref<T> m_Pipeline;
+		std::future<Ref<T>> m_Build;
+		BuildFunction m_QueuedBuild;
+
+		std::vector<std::pair<uint64_t, Ref<T>>> m_RetiredPipelines;
+	};
+
+}
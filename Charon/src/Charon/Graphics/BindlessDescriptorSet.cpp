@@ -0,0 +1,232 @@
+#include "pch.h"
+#include "BindlessDescriptorSet.h"
+#include "Charon/Core/Application.h"
+#include "Charon/Graphics/VulkanTools.h"
+#include <mutex>
+
+namespace Charon {
+
+	// Indices into one of the runtime arrays, released indices wait out the frames in flight before reuse
+	struct BindlessSlots
+	{
+		uint32_t Capacity = 0;
+		uint32_t Next = 0;
+		std::vector<uint32_t> FreeIndices;
+		std::vector<std::vector<uint32_t>> PendingFrees;
+
+		uint32_t Allocate()
+		{
+			if (!FreeIndices.empty())
+			{
+				uint32_t index = FreeIndices.back();
+				FreeIndices.pop_back();
+				return index;
+			}
+
+			CR_ASSERT(Next < Capacity, "Bindless descriptor array is full");
+			return Next++;
+		}
+	};
+
+	struct BindlessDescriptorSetData
+	{
+		VkDescriptorPool DescriptorPool = nullptr;
+		VkDescriptorSetLayout DescriptorSetLayout = nullptr;
+		VkDescriptorSet DescriptorSet = nullptr;
+		VkSampler DefaultSampler = nullptr;
+
+		BindlessSlots Textures;
+		BindlessSlots Samplers;
+
+		uint32_t FrameIndex = 0;
+		std::mutex Mutex;
+	};
+
+	static BindlessDescriptorSetData* s_Data = nullptr;
+
+	namespace Utils {
+
+		static void WriteBindlessDescriptor(uint32_t binding, VkDescriptorType type, uint32_t index, const VkDescriptorImageInfo* imageInfo)
+		{
+			VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+			VkWriteDescriptorSet writeDescriptor = {};
+			writeDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writeDescriptor.dstSet = s_Data->DescriptorSet;
+			writeDescriptor.dstBinding = binding;
+			writeDescriptor.dstArrayElement = index;
+			writeDescriptor.descriptorCount = 1;
+			writeDescriptor.descriptorType = type;
+			writeDescriptor.pImageInfo = imageInfo;
+
+			vkUpdateDescriptorSets(device, 1, &writeDescriptor, 0, nullptr);
+		}
+
+		static void ReleaseBindlessSlot(BindlessSlots& slots, uint32_t index)
+		{
+			std::lock_guard<std::mutex> lock(s_Data->Mutex);
+			slots.PendingFrees[s_Data->FrameIndex].push_back(index);
+		}
+
+	}
+
+	void BindlessDescriptorSet::Init(uint32_t maxTextures, uint32_t maxSamplers)
+	{
+		s_Data = new BindlessDescriptorSetData();
+
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+		uint32_t framesInFlight = Application::GetApp().GetVulkanSwapChain()->GetFramesInFlight();
+
+		s_Data->Textures.Capacity = maxTextures;
+		s_Data->Textures.Next = InvalidTextureIndex + 1;
+		s_Data->Samplers.Capacity = maxSamplers;
+		for (BindlessSlots* slots : { &s_Data->Textures, &s_Data->Samplers })
+			slots->PendingFrees.resize(framesInFlight);
+
+		// Layout, descriptors can be written while the set is bound as long as the shader doesn't access them
+		std::array<VkDescriptorSetLayoutBinding, 2> layoutBindings = {};
+		layoutBindings[0] = { TextureBinding, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, maxTextures, VK_SHADER_STAGE_ALL, nullptr };
+		layoutBindings[1] = { SamplerBinding, VK_DESCRIPTOR_TYPE_SAMPLER, maxSamplers, VK_SHADER_STAGE_ALL, nullptr };
+
+		VkDescriptorBindingFlags flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+		std::array<VkDescriptorBindingFlags, layoutBindings.size()> bindingFlags = { flags, flags };
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = {};
+		bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsCreateInfo.bindingCount = (uint32_t)bindingFlags.size();
+		bindingFlagsCreateInfo.pBindingFlags = bindingFlags.data();
+
+		VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+		layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+		layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		layoutCreateInfo.bindingCount = (uint32_t)layoutBindings.size();
+		layoutCreateInfo.pBindings = layoutBindings.data();
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &layoutCreateInfo, nullptr, &s_Data->DescriptorSetLayout));
+
+		// Pool
+		VkDescriptorPoolSize poolSizes[] =
+		{
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, maxTextures },
+			{ VK_DESCRIPTOR_TYPE_SAMPLER, maxSamplers }
+		};
+
+		VkDescriptorPoolCreateInfo poolCreateInfo = {};
+		poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolCreateInfo.maxSets = 1;
+		poolCreateInfo.poolSizeCount = 2;
+		poolCreateInfo.pPoolSizes = poolSizes;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &poolCreateInfo, nullptr, &s_Data->DescriptorPool));
+
+		// Set
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = s_Data->DescriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &s_Data->DescriptorSetLayout;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &s_Data->DescriptorSet));
+
+		// Default sampler
+		VkSamplerCreateInfo samplerCreateInfo = {};
+		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+		samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+		samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		VK_CHECK_RESULT(vkCreateSampler(device, &samplerCreateInfo, nullptr, &s_Data->DefaultSampler));
+
+		uint32_t defaultSamplerIndex = RegisterSampler(s_Data->DefaultSampler);
+		CR_ASSERT(defaultSamplerIndex == DefaultSamplerIndex, "Default sampler must be registered first");
+
+		CR_LOG_INFO("Initialized BindlessDescriptorSet; textures = {0}, samplers = {1}", maxTextures, maxSamplers);
+	}
+
+	void BindlessDescriptorSet::Shutdown()
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+		vkDestroySampler(device, s_Data->DefaultSampler, nullptr);
+		vkDestroyDescriptorPool(device, s_Data->DescriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(device, s_Data->DescriptorSetLayout, nullptr);
+
+		delete s_Data;
+		s_Data = nullptr;
+	}
+
+	void BindlessDescriptorSet::BeginFrame(uint32_t frameIndex)
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+		s_Data->FrameIndex = frameIndex;
+
+		// The GPU is done with this frame slot, so its released indices can be handed out again
+		for (BindlessSlots* slots : { &s_Data->Textures, &s_Data->Samplers })
+		{
+			std::vector<uint32_t>& pendingFrees = slots->PendingFrees[frameIndex];
+			slots->FreeIndices.insert(slots->FreeIndices.end(), pendingFrees.begin(), pendingFrees.end());
+			pendingFrees.clear();
+		}
+	}
+
+	uint32_t BindlessDescriptorSet::RegisterTexture(const VkDescriptorImageInfo& imageInfo)
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+
+		VkDescriptorImageInfo sampledImageInfo = { nullptr, imageInfo.imageView, imageInfo.imageLayout };
+
+		uint32_t index = s_Data->Textures.Allocate();
+		Utils::WriteBindlessDescriptor(TextureBinding, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, index, &sampledImageInfo);
+		return index;
+	}
+
+	uint32_t BindlessDescriptorSet::RegisterSampler(VkSampler sampler)
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+
+		VkDescriptorImageInfo samplerInfo = { sampler, nullptr, VK_IMAGE_LAYOUT_UNDEFINED };
+
+		uint32_t index = s_Data->Samplers.Allocate();
+		Utils::WriteBindlessDescriptor(SamplerBinding, VK_DESCRIPTOR_TYPE_SAMPLER, index, &samplerInfo);
+		return index;
+	}
+
+	void BindlessDescriptorSet::UpdateTexture(uint32_t index, const VkDescriptorImageInfo& imageInfo)
+	{
+		CR_ASSERT(index != InvalidTextureIndex, "Texture index 0 is reserved");
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+
+		VkDescriptorImageInfo sampledImageInfo = { nullptr, imageInfo.imageView, imageInfo.imageLayout };
+		Utils::WriteBindlessDescriptor(TextureBinding, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, index, &sampledImageInfo);
+	}
+
+	void BindlessDescriptorSet::ReleaseTexture(uint32_t index)
+	{
+		CR_ASSERT(index != InvalidTextureIndex, "Texture index 0 is reserved");
+		Utils::ReleaseBindlessSlot(s_Data->Textures, index);
+	}
+
+	void BindlessDescriptorSet::ReleaseSampler(uint32_t index)
+	{
+		Utils::ReleaseBindlessSlot(s_Data->Samplers, index);
+	}
+
+	void BindlessDescriptorSet::Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout)
+	{
+		vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, SetIndex, 1, &s_Data->DescriptorSet, 0, nullptr);
+	}
+
+	VkDescriptorSetLayout BindlessDescriptorSet::GetDescriptorSetLayout()
+	{
+		return s_Data->DescriptorSetLayout;
+	}
+
+	VkDescriptorSet BindlessDescriptorSet::GetDescriptorSet()
+	{
+		return s_Data->DescriptorSet;
+	}
+
+}
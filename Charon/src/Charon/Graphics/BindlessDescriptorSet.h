@@ -0,0 +1,43 @@
+#pragma once
+#include "Charon/Core/Core.h"
+#include <vulkan/vulkan.h>
+
+namespace Charon {
+
+	// Global descriptor set holding runtime arrays of every texture and sampler, indexed from shaders by ID.
+	// Bound once at SetIndex, shaders declare:
+	//   layout(set = 1, binding = 0) uniform texture2D u_Textures[];
+	//   layout(set = 1, binding = 1) uniform sampler u_Samplers[];
+	class BindlessDescriptorSet
+	{
+	public:
+		static const uint32_t SetIndex = 1;
+		static const uint32_t TextureBinding = 0;
+		static const uint32_t SamplerBinding = 1;
+
+		// Texture index 0 is never handed out so it can mean "no texture", sampler 0 is a linear repeat sampler
+		static const uint32_t InvalidTextureIndex = 0;
+		static const uint32_t DefaultSamplerIndex = 0;
+	public:
+		static void Init(uint32_t maxTextures = 4096, uint32_t maxSamplers = 64);
+		static void Shutdown();
+
+		// Slots released during a frame are reused once that frame slot comes around again
+		static void BeginFrame(uint32_t frameIndex);
+
+		static uint32_t RegisterTexture(const VkDescriptorImageInfo& imageInfo);
+		static uint32_t RegisterSampler(VkSampler sampler);
+
+		// Points an existing slot at a new image, the slot must not be in use by any frame in flight
+		static void UpdateTexture(uint32_t index, const VkDescriptorImageInfo& imageInfo);
+
+		static void ReleaseTexture(uint32_t index);
+		static void ReleaseSampler(uint32_t index);
+
+		static void Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout);
+
+		static VkDescriptorSetLayout GetDescriptorSetLayout();
+		static VkDescriptorSet GetDescriptorSet();
+	};
+
+}
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Buffers.h"
+#include "Charon/Graphics/UniformBufferRing.h"
 
 namespace Charon {
 
@@ -68,62 +69,56 @@ namespace Charon {
 	}
 
 	UniformBuffer::UniformBuffer(void* data, uint32_t size)
-		: m_Size(size)
+		: m_Data(size), m_Size(size)
 	{
-		// Create buffer info
-		VkBufferCreateInfo uniformBufferCreateInfo = {};
-		uniformBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		uniformBufferCreateInfo.size = size;
-		uniformBufferCreateInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-
-		// Allocate memory
-		VulkanAllocator allocator("UniformBuffer");
-		m_BufferInfo.Allocation = allocator.AllocateBuffer(uniformBufferCreateInfo, VMA_MEMORY_USAGE_CPU_TO_GPU, m_BufferInfo.Buffer);
-
 		if (data)
-			UpdateBuffer(data);
+			memcpy(m_Data.data(), data, size);
 
-		m_DescriptorBufferInfo.buffer = m_BufferInfo.Buffer;
+		m_DescriptorBufferInfo.buffer = UniformBufferRing::GetBuffer();
 		m_DescriptorBufferInfo.offset = 0;
 		m_DescriptorBufferInfo.range = size;
+
+		m_DynamicDescriptorBufferInfo = m_DescriptorBufferInfo;
 	}
 
-	UniformBuffer::~UniformBuffer()
+	VkBuffer UniformBuffer::GetBuffer()
 	{
-		VulkanAllocator allocator("UniformBuffer");
-		allocator.DestroyBuffer(m_BufferInfo.Buffer, m_BufferInfo.Allocation);
+		return UniformBufferRing::GetBuffer();
 	}
 
-	void UniformBuffer::UpdateBuffer(void* data)
+	void UniformBuffer::UpdateBuffer(const void* data)
 	{
-		// Copy data into buffer
-		VulkanAllocator allocator("UniformBuffer");
-		void* dstBuffer = allocator.MapMemory<void>(m_BufferInfo.Allocation);
-		memcpy(dstBuffer, data, m_Size);
-		allocator.UnmapMemory(m_BufferInfo.Allocation);
+		memcpy(m_Data.data(), data, m_Size);
+		m_Dirty = true;
 	}
 
-	StorageBuffer::StorageBuffer(uint32_t size, bool cpu, bool vertex)
-		: m_Size(size)
+	void UniformBuffer::Upload()
 	{
-		// Create buffer info
-		VkBufferCreateInfo vertexBufferCreateInfo = {};
-		vertexBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		vertexBufferCreateInfo.size = size;
-		vertexBufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
-		if (vertex)
-			vertexBufferCreateInfo.usage |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		// Ring memory from an earlier frame may be overwritten by now, so the first upload in a frame always copies
+		if (!m_Dirty && m_UploadedFrame == UniformBufferRing::GetFrameCounter())
+			return;
 
-		// Allocate memory
-		VulkanAllocator allocator("StorageBuffer");
-		m_BufferInfo.Allocation = allocator.AllocateBuffer(vertexBufferCreateInfo, cpu ? VMA_MEMORY_USAGE_CPU_ONLY : VMA_MEMORY_USAGE_CPU_TO_GPU, m_BufferInfo.Buffer);
+		void* dstBuffer = UniformBufferRing::Allocate(m_Size, m_Offset);
+		memcpy(dstBuffer, m_Data.data(), m_Size);
 
-		m_DescriptorBufferInfo.buffer = m_BufferInfo.Buffer;
-		m_DescriptorBufferInfo.offset = 0;
-		m_DescriptorBufferInfo.range = size;
+		m_DescriptorBufferInfo.offset = m_Offset;
+		m_UploadedFrame = UniformBufferRing::GetFrameCounter();
+		m_Dirty = false;
 	}
 
-	StorageBuffer::StorageBuffer(uint32_t size, VkBufferUsageFlagBits usageFlags)
+	uint32_t UniformBuffer::GetDynamicOffset() const
+	{
+		CR_ASSERT(!m_Dirty && m_UploadedFrame == UniformBufferRing::GetFrameCounter(), "Uniform buffer has to be uploaded in the frame it is used");
+		return m_Offset;
+	}
+
+	const VkDescriptorBufferInfo& UniformBuffer::getDescriptorBufferInfo() const
+	{
+		CR_ASSERT(!m_Dirty && m_UploadedFrame == UniformBufferRing::GetFrameCounter(), "Uniform buffer has to be uploaded in the frame it is used");
+		return m_DescriptorBufferInfo;
+	}
+
+	StorageBuffer::StorageBuffer(uint32_t size, VkBufferUsageFlags usageFlags)
 		: m_Size(size)
 	{
 		// Create buffer info
@@ -134,7 +129,7 @@ namespace Charon {
 
 		// Allocate memory
 		VulkanAllocator allocator("StorageBuffer");
-		m_BufferInfo.Allocation = allocator.AllocateBuffer(vertexBufferCreateInfo, VMA_MEMORY_USAGE_CPU_TO_GPU, m_BufferInfo.Buffer);
+		m_BufferInfo.Allocation = allocator.AllocateBuffer(vertexBufferCreateInfo, VMA_MEMORY_USAGE_CPU_TO_GPU, m_BufferInfo.Buffer, VulkanMemoryPool::SmallBuffers);
 
 		m_DescriptorBufferInfo.buffer = m_BufferInfo.Buffer;
 		m_DescriptorBufferInfo.offset = 0;
@@ -156,8 +151,10 @@ namespace Charon {
 		vertexBufferCreateInfo.usage = bufferType;
 
 		// Allocate memory
+		// CPU only buffers are staging buffers that are freed as soon as the upload is done
 		VulkanAllocator allocator("VulkanBuffer");
-		m_BufferInfo.Allocation = allocator.AllocateBuffer(vertexBufferCreateInfo, memoryType, m_BufferInfo.Buffer);
+		VulkanMemoryPool pool = memoryType == VMA_MEMORY_USAGE_CPU_ONLY ? VulkanMemoryPool::Staging : VulkanMemoryPool::Default;
+		m_BufferInfo.Allocation = allocator.AllocateBuffer(vertexBufferCreateInfo, memoryType, m_BufferInfo.Buffer, pool);
 
 		// Copy data into buffer
 		if (data != nullptr)
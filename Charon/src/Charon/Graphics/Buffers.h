@@ -100,43 +100,51 @@ namespace Charon {
 	};
 
 	// Uniform Buffer
+	// Uniform data sub-allocated from the UniformBufferRing. Each frame the data is written to a new offset so it can be
+	// updated every frame, or several times a frame, without waiting on the GPU. Upload() has to be called in every frame
+	// the buffer is used, after the last UpdateBuffer() and before reading its offset. Descriptors declared
+	// UNIFORM_BUFFER_DYNAMIC are written once with GetDynamicDescriptorBufferInfo() and bound with GetDynamicOffset().
 	class UniformBuffer
 	{
 	public:
 		UniformBuffer(void* data, uint32_t size);
-		~UniformBuffer();
 
 	public:
-		VkBuffer GetBuffer() { return m_BufferInfo.Buffer; }
+		VkBuffer GetBuffer();
 
-		void UpdateBuffer(void* data);
-		const VkDescriptorBufferInfo& getDescriptorBufferInfo() { return m_DescriptorBufferInfo; }
+		// Copied by the next Upload(), draws recorded before then keep the data they were recorded with
+		void UpdateBuffer(const void* data);
 
-		template<typename T>
-		T* Map()
-		{
-			VulkanAllocator allocator("UniformBuffer");
-			return (T*)allocator.MapMemory<T>(m_BufferInfo.Allocation);
-		}
+		// Writes the data to this frame's ring region, does nothing if it is already there unchanged
+		void Upload();
 
-		void Unmap()
-		{
-			VulkanAllocator allocator("UniformBuffer");
-			return allocator.UnmapMemory(m_BufferInfo.Allocation);
-		}
+		// Offset of this frame's copy, passed to vkCmdBindDescriptorSets for dynamic uniform buffers
+		uint32_t GetDynamicOffset() const;
+
+		// Points at this frame's copy, for push descriptors and sets written every frame
+		const VkDescriptorBufferInfo& getDescriptorBufferInfo() const;
+
+		// Relative to the dynamic offset, stays the same every frame
+		const VkDescriptorBufferInfo& GetDynamicDescriptorBufferInfo() { return m_DynamicDescriptorBufferInfo; }
 
 	private:
-		BufferInfo m_BufferInfo;
-		VkDescriptorBufferInfo m_DescriptorBufferInfo;
+		std::vector<uint8_t> m_Data;
 		uint32_t m_Size = 0;
+
+		uint32_t m_Offset = 0;
+		uint64_t m_UploadedFrame = UINT64_MAX;
+		bool m_Dirty = true;
+
+		VkDescriptorBufferInfo m_DescriptorBufferInfo;
+		VkDescriptorBufferInfo m_DynamicDescriptorBufferInfo;
 	};
 
 	// Storage Buffer
 	class StorageBuffer
 	{
 	public:
-		StorageBuffer(uint32_t size, bool cpu = false, bool vertex = false);
-		StorageBuffer(uint32_t size, VkBufferUsageFlagBits usageFlags);
+		// STORAGE_BUFFER usage is always added
+		StorageBuffer(uint32_t size, VkBufferUsageFlags usageFlags = 0);
 		~StorageBuffer();
 
 	public:
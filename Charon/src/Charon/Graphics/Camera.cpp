@@ -44,6 +44,30 @@ namespace Charon {
 		m_ViewMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(0, 0, 1)) * glm::toMat4(glm::conjugate(orientation)) * glm::translate(glm::mat4(1.0f), -m_Position);
 	}
 
+	Frustum Camera::GetFrustum() const
+	{
+		glm::mat4 viewProjection = GetViewProjection();
+
+		// Rows of the view projection matrix
+		glm::vec4 row0 = glm::vec4(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 row1 = glm::vec4(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 row2 = glm::vec4(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		glm::vec4 row3 = glm::vec4(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		Frustum frustum;
+		frustum.Planes[0] = row3 + row0; // Left
+		frustum.Planes[1] = row3 - row0; // Right
+		frustum.Planes[2] = row3 + row1; // Bottom
+		frustum.Planes[3] = row3 - row1; // Top
+		frustum.Planes[4] = row3 + row2; // Near
+		frustum.Planes[5] = row3 - row2; // Far
+
+		for (glm::vec4& plane : frustum.Planes)
+			plane /= glm::length(glm::vec3(plane));
+
+		return frustum;
+	}
+
 	void Camera::Reset()
 	{
 		m_PanSpeed = 0.001f;
@@ -3,6 +3,12 @@
 
 namespace Charon {
 
+	// Planes are (normal, distance) with normals pointing inwards
+	struct Frustum
+	{
+		glm::vec4 Planes[6];
+	};
+
 	class Camera
 	{
 	public:
@@ -22,6 +28,8 @@ namespace Charon {
 
 		const glm::vec3& GetPosition() const { return m_Position; }
 
+		Frustum GetFrustum() const;
+
 	private:
 		void MousePan(const glm::vec2& delta);
 		void MouseRotate(const glm::vec2& delta);
@@ -0,0 +1,308 @@
+#include "pch.h"
+#include "DescriptorAllocator.h"
+#include "Charon/Core/Application.h"
+#include "Charon/Graphics/VulkanTools.h"
+
+namespace Charon {
+
+	namespace Utils {
+
+		// Descriptors of each type per set in a pool
+		static const std::pair<VkDescriptorType, float> s_PoolSizeRatios[] =
+		{
+			{ VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 0.5f }
+		};
+
+	}
+
+	DescriptorAllocator::DescriptorAllocator(uint32_t setsPerPool, VkDescriptorPoolCreateFlags flags)
+		: m_SetsPerPool(setsPerPool), m_Flags(flags)
+	{
+	}
+
+	DescriptorAllocator::~DescriptorAllocator()
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+		for (VkDescriptorPool pool : m_UsedPools)
+			vkDestroyDescriptorPool(device, pool, nullptr);
+
+		for (VkDescriptorPool pool : m_FreePools)
+			vkDestroyDescriptorPool(device, pool, nullptr);
+	}
+
+	VkDescriptorSet DescriptorAllocator::Allocate(VkDescriptorSetLayout layout, const void* next, VkDescriptorPool* outPool)
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+		if (!m_CurrentPool)
+			m_CurrentPool = GetPool();
+
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = next;
+		allocInfo.descriptorPool = m_CurrentPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		VkDescriptorSet descriptorSet = nullptr;
+		VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+
+		// Chain a new pool when the current one is exhausted
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			m_CurrentPool = GetPool();
+			allocInfo.descriptorPool = m_CurrentPool;
+			result = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
+		}
+
+		VK_CHECK_RESULT(result);
+
+		if (outPool)
+			*outPool = m_CurrentPool;
+
+		return descriptorSet;
+	}
+
+	void DescriptorAllocator::Free(VkDescriptorPool pool, VkDescriptorSet descriptorSet)
+	{
+		CR_ASSERT(m_Flags & VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, "Pools were not created with VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT");
+
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+		VK_CHECK_RESULT(vkFreeDescriptorSets(device, pool, 1, &descriptorSet));
+	}
+
+	void DescriptorAllocator::Reset()
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+		for (VkDescriptorPool pool : m_UsedPools)
+		{
+			VK_CHECK_RESULT(vkResetDescriptorPool(device, pool, 0));
+			m_FreePools.push_back(pool);
+		}
+
+		m_UsedPools.clear();
+		m_CurrentPool = nullptr;
+	}
+
+	VkDescriptorPool DescriptorAllocator::GetPool()
+	{
+		VkDescriptorPool pool;
+		if (!m_FreePools.empty())
+		{
+			pool = m_FreePools.back();
+			m_FreePools.pop_back();
+		}
+		else
+		{
+			pool = CreatePool();
+		}
+
+		m_UsedPools.push_back(pool);
+		return pool;
+	}
+
+	VkDescriptorPool DescriptorAllocator::CreatePool()
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+		std::vector<VkDescriptorPoolSize> poolSizes;
+		for (const auto& [type, ratio] : Utils::s_PoolSizeRatios)
+			poolSizes.push_back({ type, (uint32_t)(ratio * m_SetsPerPool) });
+
+		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
+		descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		descriptorPoolCreateInfo.flags = m_Flags;
+		descriptorPoolCreateInfo.maxSets = m_SetsPerPool;
+		descriptorPoolCreateInfo.poolSizeCount = (uint32_t)poolSizes.size();
+		descriptorPoolCreateInfo.pPoolSizes = poolSizes.data();
+
+		VkDescriptorPool pool;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &pool));
+
+		CR_LOG_INFO("Created descriptor pool; sets = {0}, pools = {1}", m_SetsPerPool, GetPoolCount() + 1);
+		return pool;
+	}
+
+	DescriptorSetCache::DescriptorSetCache()
+	{
+		m_Allocator = CreateRef<DescriptorAllocator>(256, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
+	}
+
+	DescriptorSetCache::~DescriptorSetCache()
+	{
+		m_Sets.clear();
+	}
+
+	size_t DescriptorSetCache::KeyHash::operator()(const std::vector<uint64_t>& key) const
+	{
+		// FNV-1a over the key words
+		uint64_t hash = 14695981039346656037ull;
+		for (uint64_t value : key)
+		{
+			hash ^= value;
+			hash *= 1099511628211ull;
+		}
+
+		return (size_t)hash;
+	}
+
+	VkDescriptorSet DescriptorSetCache::GetDescriptorSet(VkDescriptorSetLayout layout, std::vector<VkWriteDescriptorSet>& writes)
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		// Key is the layout followed by every resource handle written to the set
+		std::vector<uint64_t> key;
+		std::vector<uint64_t> handles;
+		key.push_back((uint64_t)layout);
+		for (const VkWriteDescriptorSet& write : writes)
+		{
+			key.push_back(((uint64_t)write.dstBinding << 32) | write.dstArrayElement);
+			key.push_back(((uint64_t)write.descriptorType << 32) | write.descriptorCount);
+
+			for (uint32_t i = 0; i < write.descriptorCount; i++)
+			{
+				if (write.pBufferInfo)
+				{
+					key.push_back((uint64_t)write.pBufferInfo[i].buffer);
+					handles.push_back((uint64_t)write.pBufferInfo[i].buffer);
+					key.push_back(write.pBufferInfo[i].offset);
+					key.push_back(write.pBufferInfo[i].range);
+				}
+				else if (write.pImageInfo)
+				{
+					key.push_back((uint64_t)write.pImageInfo[i].sampler);
+					key.push_back((uint64_t)write.pImageInfo[i].imageView);
+					handles.push_back((uint64_t)write.pImageInfo[i].sampler);
+					handles.push_back((uint64_t)write.pImageInfo[i].imageView);
+					key.push_back(write.pImageInfo[i].imageLayout);
+				}
+				else if (write.descriptorType == VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR)
+				{
+					const VkWriteDescriptorSetAccelerationStructureKHR* accelerationStructureWrite = (const VkWriteDescriptorSetAccelerationStructureKHR*)write.pNext;
+					key.push_back((uint64_t)accelerationStructureWrite->pAccelerationStructures[i]);
+					handles.push_back((uint64_t)accelerationStructureWrite->pAccelerationStructures[i]);
+				}
+			}
+		}
+
+		auto [it, inserted] = m_Sets.try_emplace(std::move(key));
+		CachedSet& cachedSet = it->second;
+		cachedSet.LastUsedFrame = m_CurrentFrame;
+
+		if (inserted)
+		{
+			cachedSet.Set = m_Allocator->Allocate(layout, nullptr, &cachedSet.Pool);
+
+			// Immutable samplers and unused bindings write null handles
+			handles.erase(std::remove(handles.begin(), handles.end(), 0), handles.end());
+			std::sort(handles.begin(), handles.end());
+			handles.erase(std::unique(handles.begin(), handles.end()), handles.end());
+
+			for (uint64_t handle : handles)
+				m_HandleReferences[handle]++;
+
+			cachedSet.Handles = std::move(handles);
+		}
+
+		for (VkWriteDescriptorSet& write : writes)
+			write.dstSet = cachedSet.Set;
+
+		if (inserted && !writes.empty())
+			vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+
+		return cachedSet.Set;
+	}
+
+	void DescriptorSetCache::Invalidate(uint64_t handle)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		// Most destroyed resources were never written to a cached set
+		if (m_HandleReferences.find(handle) == m_HandleReferences.end())
+			return;
+
+		for (auto it = m_Sets.begin(); it != m_Sets.end();)
+		{
+			if (std::binary_search(it->second.Handles.begin(), it->second.Handles.end(), handle))
+			{
+				ReleaseHandles(it->second);
+				m_InvalidatedSets.push_back(std::move(it->second));
+				it = m_Sets.erase(it);
+			}
+			else
+			{
+				it++;
+			}
+		}
+	}
+
+	void DescriptorSetCache::BeginFrame(uint64_t frame)
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		m_CurrentFrame = frame;
+
+		// Long enough that no frame in flight can still reference the set
+		for (auto it = m_Sets.begin(); it != m_Sets.end();)
+		{
+			if (m_CurrentFrame - it->second.LastUsedFrame > s_MaxUnusedFrames)
+			{
+				ReleaseHandles(it->second);
+				m_Allocator->Free(it->second.Pool, it->second.Set);
+				it = m_Sets.erase(it);
+			}
+			else
+			{
+				it++;
+			}
+		}
+
+		// Invalidated sets may still be bound by the frames in flight that last requested them
+		uint32_t framesInFlight = Application::GetApp().GetVulkanSwapChain()->GetFramesInFlight();
+		for (auto it = m_InvalidatedSets.begin(); it != m_InvalidatedSets.end();)
+		{
+			if (m_CurrentFrame - it->LastUsedFrame >= framesInFlight)
+			{
+				m_Allocator->Free(it->Pool, it->Set);
+				it = m_InvalidatedSets.erase(it);
+			}
+			else
+			{
+				it++;
+			}
+		}
+	}
+
+	void DescriptorSetCache::Clear()
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+
+		m_Sets.clear();
+		m_HandleReferences.clear();
+		m_InvalidatedSets.clear();
+		m_Allocator->Reset();
+	}
+
+	void DescriptorSetCache::ReleaseHandles(const CachedSet& cachedSet)
+	{
+		for (uint64_t handle : cachedSet.Handles)
+		{
+			auto it = m_HandleReferences.find(handle);
+			if (--it->second == 0)
+				m_HandleReferences.erase(it);
+		}
+	}
+
+}
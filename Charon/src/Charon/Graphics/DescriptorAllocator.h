@@ -0,0 +1,83 @@
+#pragma once
+#include "Charon/Core/Core.h"
+#include <vulkan/vulkan.h>
+#include <mutex>
+
+namespace Charon {
+
+	// Allocates descriptor sets from a chain of pools, a new pool is created whenever the current one runs out
+	class DescriptorAllocator
+	{
+	public:
+		DescriptorAllocator(uint32_t setsPerPool = 256, VkDescriptorPoolCreateFlags flags = 0);
+		~DescriptorAllocator();
+
+	public:
+		VkDescriptorSet Allocate(VkDescriptorSetLayout layout, const void* next = nullptr, VkDescriptorPool* outPool = nullptr);
+		void Free(VkDescriptorPool pool, VkDescriptorSet descriptorSet);
+
+		// Returns every set to the pools, sets allocated before are invalid afterwards
+		void Reset();
+
+		uint32_t GetPoolCount() const { return (uint32_t)(m_UsedPools.size() + m_FreePools.size()); }
+	private:
+		VkDescriptorPool GetPool();
+		VkDescriptorPool CreatePool();
+
+	private:
+		uint32_t m_SetsPerPool;
+		VkDescriptorPoolCreateFlags m_Flags;
+
+		VkDescriptorPool m_CurrentPool = nullptr;
+		std::vector<VkDescriptorPool> m_UsedPools;
+		std::vector<VkDescriptorPool> m_FreePools;
+	};
+
+	// Reuses descriptor sets across frames when the layout and everything written to them matches
+	class DescriptorSetCache
+	{
+	public:
+		DescriptorSetCache();
+		~DescriptorSetCache();
+
+	public:
+		// dstSet of every write is filled in, the writes are only applied when the set is new
+		VkDescriptorSet GetDescriptorSet(VkDescriptorSetLayout layout, std::vector<VkWriteDescriptorSet>& writes);
+
+		// Drops every set written with the handle, call before the handle is destroyed since Vulkan may hand the same value
+		// out again. The sets are freed once no frame in flight can use them.
+		void Invalidate(uint64_t handle);
+
+		// Frees sets that have not been requested for a while, call once per frame
+		void BeginFrame(uint64_t frame);
+		void Clear();
+
+		uint32_t GetSize() const { return (uint32_t)m_Sets.size(); }
+	private:
+		struct KeyHash
+		{
+			size_t operator()(const std::vector<uint64_t>& key) const;
+		};
+
+		struct CachedSet
+		{
+			VkDescriptorSet Set = nullptr;
+			VkDescriptorPool Pool = nullptr;
+			uint64_t LastUsedFrame = 0;
+			std::vector<uint64_t> Handles;
+		};
+
+		void ReleaseHandles(const CachedSet& cachedSet);
+
+	private:
+		static const uint64_t s_MaxUnusedFrames = 120;
+
+		Ref<DescriptorAllocator> m_Allocator;
+		std::unordered_map<std::vector<uint64_t>, CachedSet, KeyHash> m_Sets;
+		std::unordered_map<uint64_t, uint32_t> m_HandleReferences; // Cached sets written with each handle
+		std::vector<CachedSet> m_InvalidatedSets;
+		uint64_t m_CurrentFrame = 0;
+		std::mutex m_Mutex;
+	};
+
+}
@@ -20,6 +20,7 @@ namespace Charon {
 		return; // lol for now
 
 		vkDestroyRenderPass(device->GetLogicalDevice(), m_RenderPass, nullptr);
+		vkDestroyRenderPass(device->GetLogicalDevice(), m_LoadRenderPass, nullptr);
 		vkDestroyFramebuffer(device->GetLogicalDevice(), m_Framebuffer, nullptr);
 	}
 	
@@ -155,6 +156,15 @@ namespace Charon {
 		renderPassInfo.pDependencies = dependencies.data();
 		VK_CHECK_RESULT(vkCreateRenderPass(device->GetLogicalDevice(), &renderPassInfo, nullptr, &m_RenderPass));
 
+		// Create load render pass, attachments start in the layout the render pass above leaves them in
+		for (VkAttachmentDescription& description : attachmentDescriptions)
+		{
+			description.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+			description.initialLayout = description.finalLayout;
+		}
+
+		VK_CHECK_RESULT(vkCreateRenderPass(device->GetLogicalDevice(), &renderPassInfo, nullptr, &m_LoadRenderPass));
+
 		// Collect attachment image views
 		std::vector<VkImageView> attachmentViews;
 		for (auto attachment : m_Attachments)
@@ -37,6 +37,8 @@ namespace Charon {
 
 		inline VkFramebuffer GetFramebuffer() { return m_Framebuffer; }
 		inline VkRenderPass GetRenderPass() { return m_RenderPass; }
+		// Compatible with GetRenderPass(), but loads the contents left by a previous pass
+		inline VkRenderPass GetLoadRenderPass() { return m_LoadRenderPass; }
 
 		inline uint32_t GetWidth() { return m_Width; }
 		inline uint32_t GetHeight() { return m_Height; }
@@ -59,6 +61,7 @@ namespace Charon {
 
 		VkFramebuffer m_Framebuffer = nullptr;
 		VkRenderPass m_RenderPass = nullptr;
+		VkRenderPass m_LoadRenderPass = nullptr;
 
 		std::vector<FramebufferAttachment> m_Attachments;
 		FramebufferAttachment m_DepthAttachment;
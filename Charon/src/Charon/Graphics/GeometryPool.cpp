@@ -0,0 +1,202 @@
+#include "pch.h"
+#include "GeometryPool.h"
+#include "Charon/Core/Application.h"
+#include "Charon/Graphics/Buffers.h"
+#include "Charon/Graphics/Mesh.h"
+
+namespace Charon {
+
+	struct GeometryPoolData
+	{
+		BufferInfo VertexBuffer;
+		BufferInfo IndexBuffer;
+
+		FreeListAllocator VertexAllocator;
+		FreeListAllocator IndexAllocator;
+	};
+
+	static GeometryPoolData* s_Data = nullptr;
+
+	FreeListAllocator::FreeListAllocator(uint32_t capacity)
+		: m_Capacity(capacity)
+	{
+		m_FreeBlocks[0] = capacity;
+	}
+
+	bool FreeListAllocator::Allocate(uint32_t count, uint32_t& outOffset)
+	{
+		for (auto it = m_FreeBlocks.begin(); it != m_FreeBlocks.end(); it++)
+		{
+			if (it->second < count)
+				continue;
+
+			outOffset = it->first;
+			uint32_t remaining = it->second - count;
+			m_FreeBlocks.erase(it);
+
+			if (remaining > 0)
+				m_FreeBlocks[outOffset + count] = remaining;
+
+			m_Used += count;
+			return true;
+		}
+
+		return false;
+	}
+
+	void FreeListAllocator::Free(uint32_t offset, uint32_t count)
+	{
+		auto it = m_FreeBlocks.emplace(offset, count).first;
+
+		// Merge with next block
+		auto next = std::next(it);
+		if (next != m_FreeBlocks.end() && it->first + it->second == next->first)
+		{
+			it->second += next->second;
+			m_FreeBlocks.erase(next);
+		}
+
+		// Merge with previous block
+		if (it != m_FreeBlocks.begin())
+		{
+			auto prev = std::prev(it);
+			if (prev->first + prev->second == it->first)
+			{
+				prev->second += it->second;
+				m_FreeBlocks.erase(it);
+			}
+		}
+
+		m_Used -= count;
+	}
+
+	void GeometryPool::Init(uint32_t maxVertexCount, uint32_t maxIndexCount)
+	{
+		s_Data = new GeometryPoolData();
+
+		VulkanAllocator allocator("GeometryPool");
+
+		// Vertex buffer
+		VkBufferCreateInfo bufferCreateInfo = {};
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = (VkDeviceSize)maxVertexCount * sizeof(Vertex);
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		s_Data->VertexBuffer.Allocation = allocator.AllocateBuffer(bufferCreateInfo, VMA_MEMORY_USAGE_GPU_ONLY, s_Data->VertexBuffer.Buffer);
+
+		// Index buffer
+		bufferCreateInfo.size = (VkDeviceSize)maxIndexCount * sizeof(uint32_t);
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+		s_Data->IndexBuffer.Allocation = allocator.AllocateBuffer(bufferCreateInfo, VMA_MEMORY_USAGE_GPU_ONLY, s_Data->IndexBuffer.Buffer);
+
+		s_Data->VertexAllocator = FreeListAllocator(maxVertexCount);
+		s_Data->IndexAllocator = FreeListAllocator(maxIndexCount);
+
+		CR_LOG_INFO("Initialized GeometryPool; vertices = {0}, indices = {1}", maxVertexCount, maxIndexCount);
+	}
+
+	void GeometryPool::Shutdown()
+	{
+		VulkanAllocator allocator("GeometryPool");
+		allocator.DestroyBuffer(s_Data->VertexBuffer.Buffer, s_Data->VertexBuffer.Allocation);
+		allocator.DestroyBuffer(s_Data->IndexBuffer.Buffer, s_Data->IndexBuffer.Allocation);
+
+		delete s_Data;
+		s_Data = nullptr;
+	}
+
+	GeometryPoolAllocation GeometryPool::AllocateVertices(const void* vertexData, uint32_t vertexCount)
+	{
+		GeometryPoolAllocation allocation;
+		if (!s_Data->VertexAllocator.Allocate(vertexCount, allocation.Offset))
+		{
+			// Any offset handed out here would alias another mesh's geometry, so this fails in every configuration
+			CR_LOG_CRITICAL("GeometryPool out of vertex memory; requested = {0}, used = {1}/{2}", vertexCount, s_Data->VertexAllocator.GetUsed(), s_Data->VertexAllocator.GetCapacity());
+			std::abort();
+		}
+
+		allocation.Count = vertexCount;
+		Upload(s_Data->VertexBuffer.Buffer, (VkDeviceSize)allocation.Offset * sizeof(Vertex), vertexData, (VkDeviceSize)vertexCount * sizeof(Vertex));
+		return allocation;
+	}
+
+	GeometryPoolAllocation GeometryPool::AllocateIndices(const uint32_t* indexData, uint32_t indexCount)
+	{
+		GeometryPoolAllocation allocation;
+		if (!s_Data->IndexAllocator.Allocate(indexCount, allocation.Offset))
+		{
+			// Any offset handed out here would alias another mesh's geometry, so this fails in every configuration
+			CR_LOG_CRITICAL("GeometryPool out of index memory; requested = {0}, used = {1}/{2}", indexCount, s_Data->IndexAllocator.GetUsed(), s_Data->IndexAllocator.GetCapacity());
+			std::abort();
+		}
+
+		allocation.Count = indexCount;
+		Upload(s_Data->IndexBuffer.Buffer, (VkDeviceSize)allocation.Offset * sizeof(uint32_t), indexData, (VkDeviceSize)indexCount * sizeof(uint32_t));
+		return allocation;
+	}
+
+	void GeometryPool::FreeVertices(const GeometryPoolAllocation& allocation)
+	{
+		if (!s_Data || !allocation.IsValid())
+			return;
+
+		s_Data->VertexAllocator.Free(allocation.Offset, allocation.Count);
+	}
+
+	void GeometryPool::FreeIndices(const GeometryPoolAllocation& allocation)
+	{
+		if (!s_Data || !allocation.IsValid())
+			return;
+
+		s_Data->IndexAllocator.Free(allocation.Offset, allocation.Count);
+	}
+
+	void GeometryPool::Bind(VkCommandBuffer commandBuffer)
+	{
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &s_Data->VertexBuffer.Buffer, &offset);
+		vkCmdBindIndexBuffer(commandBuffer, s_Data->IndexBuffer.Buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+
+	VkBuffer GeometryPool::GetVertexBuffer()
+	{
+		return s_Data->VertexBuffer.Buffer;
+	}
+
+	VkBuffer GeometryPool::GetIndexBuffer()
+	{
+		return s_Data->IndexBuffer.Buffer;
+	}
+
+	uint32_t GeometryPool::GetVertexStride()
+	{
+		return sizeof(Vertex);
+	}
+
+	void GeometryPool::Upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+	{
+		Ref<VulkanDevice> device = Application::GetApp().GetVulkanDevice();
+
+		// Create staging buffer with geometry data
+		VulkanBuffer stagingBuffer((void*)data, (uint32_t)size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+
+		VkCommandBuffer commandBuffer = device->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.srcOffset = 0;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer.GetVulkanBuffer(), dstBuffer, 1, &copyRegion);
+
+		// Make copy visible to vertex input, shaders and acceleration structure builds
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		// Submit and free command buffer
+		device->FlushCommandBuffer(commandBuffer, true);
+	}
+
+}
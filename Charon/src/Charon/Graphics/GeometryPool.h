@@ -0,0 +1,57 @@
+#pragma once
+#include "Charon/Core/Core.h"
+#include <vulkan/vulkan.h>
+
+namespace Charon {
+
+	// Range of elements sub-allocated from a pool buffer
+	struct GeometryPoolAllocation
+	{
+		uint32_t Offset = 0;
+		uint32_t Count = 0;
+
+		bool IsValid() const { return Count != 0; }
+	};
+
+	// First-fit free-list over a range of elements, neighbouring free blocks are merged on free
+	class FreeListAllocator
+	{
+	public:
+		FreeListAllocator() = default;
+		FreeListAllocator(uint32_t capacity);
+
+		// Returns false if no free block is large enough
+		bool Allocate(uint32_t count, uint32_t& outOffset);
+		void Free(uint32_t offset, uint32_t count);
+
+		uint32_t GetCapacity() const { return m_Capacity; }
+		uint32_t GetUsed() const { return m_Used; }
+	private:
+		std::map<uint32_t, uint32_t> m_FreeBlocks; // offset -> count
+		uint32_t m_Capacity = 0;
+		uint32_t m_Used = 0;
+	};
+
+	// Shared vertex/index buffers that every Mesh is sub-allocated from
+	class GeometryPool
+	{
+	public:
+		static void Init(uint32_t maxVertexCount = 2 * 1024 * 1024, uint32_t maxIndexCount = 8 * 1024 * 1024);
+		static void Shutdown();
+
+		static GeometryPoolAllocation AllocateVertices(const void* vertexData, uint32_t vertexCount);
+		static GeometryPoolAllocation AllocateIndices(const uint32_t* indexData, uint32_t indexCount);
+
+		static void FreeVertices(const GeometryPoolAllocation& allocation);
+		static void FreeIndices(const GeometryPoolAllocation& allocation);
+
+		static void Bind(VkCommandBuffer commandBuffer);
+
+		static VkBuffer GetVertexBuffer();
+		static VkBuffer GetIndexBuffer();
+		static uint32_t GetVertexStride();
+	private:
+		static void Upload(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	};
+
+}
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "Image.h"
 #include "Charon/Core/Application.h"
+#include "Charon/ImGui/imgui_impl_vulkan_with_textures.h"
 
 namespace Charon {
 
@@ -19,6 +20,26 @@ namespace Charon {
 			vkSetDebugUtilsObjectNameEXT(device, &objectNameInfo);
 		}
 
+		static VkImageCreateInfo CreateImageCreateInfo(const ImageSpecification& specification)
+		{
+			VkImageCreateInfo imageCreateInfo = {};
+			imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageCreateInfo.format = specification.Format;
+			imageCreateInfo.extent.width = specification.Width;
+			imageCreateInfo.extent.height = specification.Height;
+			imageCreateInfo.extent.depth = 1;
+			imageCreateInfo.mipLevels = specification.MipLevels;
+			imageCreateInfo.arrayLayers = specification.LayerCount;
+			imageCreateInfo.samples = specification.SampleCount;
+			imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCreateInfo.usage = specification.Usage | VK_IMAGE_USAGE_SAMPLED_BIT;
+			if ((imageCreateInfo.usage & VK_IMAGE_USAGE_STORAGE_BIT) == 0)
+				imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+			return imageCreateInfo;
+		}
+
 	}
 
 	Image::Image(ImageSpecification specification)
@@ -40,14 +61,28 @@ namespace Charon {
 		Ref<Renderer> renderer = Application::GetApp().GetRenderer();
 		renderer->SubmitResourceFree([info = m_ImageInfo]()
 		{
+			// A new image may get the same handle value, it mustn't inherit this one's layout
+			Renderer::ForgetRenderGraphResource((uint64_t)info.Image);
+
 			VulkanAllocator allocator("Texture2D");
 			allocator.DestroyImage(info.Image, info.MemoryAlloc);
 
+			// ImGui and cached sets referencing the handles must go before the handles do
+			ImGui_ImplVulkan_RemoveTexture(info.ImageView);
+			Renderer::InvalidateCachedDescriptorSets((uint64_t)info.ImageView);
+			for (VkImageView mipImageView : info.MipImageViews)
+				Renderer::InvalidateCachedDescriptorSets((uint64_t)mipImageView);
+			Renderer::InvalidateCachedDescriptorSets((uint64_t)info.Sampler);
+
 			VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
 			vkDestroyImageView(device, info.ImageView, nullptr);
+			for (VkImageView mipImageView : info.MipImageViews)
+				vkDestroyImageView(device, mipImageView, nullptr);
 			vkDestroySampler(device, info.Sampler, nullptr);
 		});
 
+		m_ImageInfo.MipImageViews.clear();
+		m_MipDescriptorImageInfos.clear();
 		m_ImageInfo.Image = nullptr;
 		m_ImageInfo.MemoryAlloc = nullptr;
 		m_ImageInfo.ImageView = nullptr;
@@ -70,20 +105,7 @@ namespace Charon {
 		uint32_t size = m_Specification.Width * m_Specification.Height * 4;
 
 		// Image create info
-		VkImageCreateInfo imageCreateInfo = {};
-		imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-		imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imageCreateInfo.format = m_Specification.Format;
-		imageCreateInfo.extent.width = m_Specification.Width;
-		imageCreateInfo.extent.height = m_Specification.Height;
-		imageCreateInfo.extent.depth = 1;
-		imageCreateInfo.mipLevels = 1;
-		imageCreateInfo.arrayLayers = m_Specification.LayerCount;
-		imageCreateInfo.samples = m_Specification.SampleCount;
-		imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageCreateInfo.usage = m_Specification.Usage | VK_IMAGE_USAGE_SAMPLED_BIT;
-		if ((imageCreateInfo.usage & VK_IMAGE_USAGE_STORAGE_BIT) == 0)
-			imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		VkImageCreateInfo imageCreateInfo = Utils::CreateImageCreateInfo(m_Specification);
 
 		// Create staging buffer with image data	
 		VulkanBuffer stagingBuffer(m_Specification.Data, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
@@ -155,23 +177,6 @@ namespace Charon {
 			device->FlushCommandBuffer(commandBuffer, true);
 		}
 
-		// Create image view
-		VkImageViewCreateInfo imageViewCreateInfo = {};
-		imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-		imageViewCreateInfo.format = m_Specification.Format;
-		imageViewCreateInfo.flags = 0;
-		imageViewCreateInfo.subresourceRange = {};
-		imageViewCreateInfo.subresourceRange.aspectMask = aspectFlag;
-		imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
-		imageViewCreateInfo.subresourceRange.levelCount = 1;
-		imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
-		imageViewCreateInfo.subresourceRange.layerCount = m_Specification.LayerCount;
-		imageViewCreateInfo.image = m_ImageInfo.Image;
-
-		VK_CHECK_RESULT(vkCreateImageView(device->GetLogicalDevice(), &imageViewCreateInfo, nullptr, &m_ImageInfo.ImageView));
-		Utils::SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, m_ImageInfo.ImageView, m_Specification.DebugName);
-
 		// Create sampler
 		VkSamplerCreateInfo samplerCreateInfo = {};
 		samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -195,11 +200,11 @@ namespace Charon {
 
 			m_DescriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 
-			// Range of image to copy (only the first mip)
+			// Transition every mip
 			VkImageSubresourceRange range;
 			range.aspectMask = aspectFlag;
 			range.baseMipLevel = 0;
-			range.levelCount = 1;
+			range.levelCount = m_Specification.MipLevels;
 			range.baseArrayLayer = 0;
 			range.layerCount = m_Specification.LayerCount;
 
@@ -222,8 +227,212 @@ namespace Charon {
 		{
 			m_DescriptorImageInfo.imageLayout = isDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 		}
-		m_DescriptorImageInfo.imageView = m_ImageInfo.ImageView;
 		m_DescriptorImageInfo.sampler = m_ImageInfo.Sampler;
+
+		CreateImageViews();
+	}
+
+	void Image::CreateImageViews()
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+		VkImageAspectFlags aspectFlag = IsDepthFormat(m_Specification.Format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+
+		// Create image view
+		VkImageViewCreateInfo imageViewCreateInfo = {};
+		imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		imageViewCreateInfo.format = m_Specification.Format;
+		imageViewCreateInfo.flags = 0;
+		imageViewCreateInfo.subresourceRange = {};
+		imageViewCreateInfo.subresourceRange.aspectMask = aspectFlag;
+		imageViewCreateInfo.subresourceRange.baseMipLevel = 0;
+		imageViewCreateInfo.subresourceRange.levelCount = m_Specification.MipLevels;
+		imageViewCreateInfo.subresourceRange.baseArrayLayer = 0;
+		imageViewCreateInfo.subresourceRange.layerCount = m_Specification.LayerCount;
+		imageViewCreateInfo.image = m_ImageInfo.Image;
+
+		VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &m_ImageInfo.ImageView));
+		Utils::SetObjectName(VK_OBJECT_TYPE_IMAGE_VIEW, m_ImageInfo.ImageView, m_Specification.DebugName);
+
+		m_DescriptorImageInfo.imageView = m_ImageInfo.ImageView;
+
+		// Create single mip views, used to write mips individually from compute
+		if (m_Specification.MipLevels > 1)
+		{
+			m_ImageInfo.MipImageViews.resize(m_Specification.MipLevels);
+			m_MipDescriptorImageInfos.resize(m_Specification.MipLevels);
+
+			for (uint32_t mip = 0; mip < m_Specification.MipLevels; mip++)
+			{
+				imageViewCreateInfo.subresourceRange.baseMipLevel = mip;
+				imageViewCreateInfo.subresourceRange.levelCount = 1;
+				VK_CHECK_RESULT(vkCreateImageView(device, &imageViewCreateInfo, nullptr, &m_ImageInfo.MipImageViews[mip]));
+
+				m_MipDescriptorImageInfos[mip] = m_DescriptorImageInfo;
+				m_MipDescriptorImageInfos[mip].imageView = m_ImageInfo.MipImageViews[mip];
+			}
+		}
+	}
+
+	Ref<Image> Image::CreateReducedCopy(uint32_t droppedMips) const
+	{
+		CR_ASSERT(m_Specification.Usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT, "Image has to be created with transfer source usage to be copied");
+		CR_ASSERT(!IsDepthFormat(m_Specification.Format), "Depth images can't be blitted with linear filtering");
+
+		ImageSpecification specification = m_Specification;
+		specification.Data = nullptr;
+		specification.Width = glm::max(m_Specification.Width >> droppedMips, 1u);
+		specification.Height = glm::max(m_Specification.Height >> droppedMips, 1u);
+		specification.MipLevels = m_Specification.MipLevels > droppedMips ? m_Specification.MipLevels - droppedMips : 1;
+
+		Ref<Image> reduced = CreateRef<Image>(specification);
+
+		Ref<VulkanDevice> device = Application::GetApp().GetVulkanDevice();
+		VkCommandBuffer commandBuffer = device->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		VkImageSubresourceRange sourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_Specification.MipLevels, 0, m_Specification.LayerCount };
+		VkImageSubresourceRange destinationRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, specification.MipLevels, 0, specification.LayerCount };
+
+		InsertImageMemoryBarrier(commandBuffer, m_ImageInfo.Image,
+			VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			m_DescriptorImageInfo.imageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			sourceRange);
+
+		InsertImageMemoryBarrier(commandBuffer, reduced->m_ImageInfo.Image,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			destinationRange);
+
+		// Each mip of the copy comes from the matching mip of the original, or is filtered down from its smallest one
+		for (uint32_t mip = 0; mip < specification.MipLevels; mip++)
+		{
+			uint32_t sourceMip = glm::min(mip + droppedMips, m_Specification.MipLevels - 1);
+
+			VkImageBlit blit = {};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, sourceMip, 0, m_Specification.LayerCount };
+			blit.srcOffsets[1] = { (int32_t)glm::max(m_Specification.Width >> sourceMip, 1u), (int32_t)glm::max(m_Specification.Height >> sourceMip, 1u), 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, specification.LayerCount };
+			blit.dstOffsets[1] = { (int32_t)glm::max(specification.Width >> mip, 1u), (int32_t)glm::max(specification.Height >> mip, 1u), 1 };
+
+			vkCmdBlitImage(commandBuffer,
+				m_ImageInfo.Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				reduced->m_ImageInfo.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				1, &blit, VK_FILTER_LINEAR);
+		}
+
+		InsertImageMemoryBarrier(commandBuffer, m_ImageInfo.Image,
+			VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_DescriptorImageInfo.imageLayout,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			sourceRange);
+
+		InsertImageMemoryBarrier(commandBuffer, reduced->m_ImageInfo.Image,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, reduced->m_DescriptorImageInfo.imageLayout,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			destinationRange);
+
+		device->FlushCommandBuffer(commandBuffer, true);
+
+		return reduced;
+	}
+
+	void Image::Rebind(VkDeviceMemory memory, VkDeviceSize offset)
+	{
+		CR_ASSERT(m_Specification.Usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT, "Image has to be created with transfer source usage to be moved");
+
+		Ref<VulkanDevice> device = Application::GetApp().GetVulkanDevice();
+		VkImageCreateInfo imageCreateInfo = Utils::CreateImageCreateInfo(m_Specification);
+
+		VkImage image;
+		VK_CHECK_RESULT(vkCreateImage(device->GetLogicalDevice(), &imageCreateInfo, nullptr, &image));
+		VK_CHECK_RESULT(vkBindImageMemory(device->GetLogicalDevice(), image, memory, offset));
+		Utils::SetObjectName(VK_OBJECT_TYPE_IMAGE, image, m_Specification.DebugName);
+
+		VkImageAspectFlags aspectFlag = IsDepthFormat(m_Specification.Format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		VkImageSubresourceRange range = { aspectFlag, 0, m_Specification.MipLevels, 0, m_Specification.LayerCount };
+
+		VkCommandBuffer commandBuffer = device->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+
+		InsertImageMemoryBarrier(commandBuffer, m_ImageInfo.Image,
+			VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+			m_DescriptorImageInfo.imageLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			range);
+
+		InsertImageMemoryBarrier(commandBuffer, image,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			range);
+
+		std::vector<VkImageCopy> regions(m_Specification.MipLevels);
+		for (uint32_t mip = 0; mip < m_Specification.MipLevels; mip++)
+		{
+			VkImageCopy& region = regions[mip];
+			region.srcSubresource = { aspectFlag, mip, 0, m_Specification.LayerCount };
+			region.dstSubresource = region.srcSubresource;
+			region.extent = { glm::max(m_Specification.Width >> mip, 1u), glm::max(m_Specification.Height >> mip, 1u), 1 };
+		}
+
+		vkCmdCopyImage(commandBuffer,
+			m_ImageInfo.Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			(uint32_t)regions.size(), regions.data());
+
+		InsertImageMemoryBarrier(commandBuffer, image,
+			VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_DescriptorImageInfo.imageLayout,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			range);
+
+		device->FlushCommandBuffer(commandBuffer, true);
+
+		// Nothing is in flight, so the old handles can go right away. The memory belongs to the allocation, VMA moves it once
+		// the pass ends.
+		ImGui_ImplVulkan_RemoveTexture(m_ImageInfo.ImageView);
+		Renderer::InvalidateCachedDescriptorSets((uint64_t)m_ImageInfo.ImageView);
+		vkDestroyImageView(device->GetLogicalDevice(), m_ImageInfo.ImageView, nullptr);
+		for (VkImageView mipImageView : m_ImageInfo.MipImageViews)
+		{
+			Renderer::InvalidateCachedDescriptorSets((uint64_t)mipImageView);
+			vkDestroyImageView(device->GetLogicalDevice(), mipImageView, nullptr);
+		}
+		Renderer::ForgetRenderGraphResource((uint64_t)m_ImageInfo.Image);
+		vkDestroyImage(device->GetLogicalDevice(), m_ImageInfo.Image, nullptr);
+
+		m_ImageInfo.Image = image;
+		m_ImageInfo.MipImageViews.clear();
+		m_MipDescriptorImageInfos.clear();
+
+		CreateImageViews();
+	}
+
+	uint32_t Image::CalculateMipCount(uint32_t width, uint32_t height)
+	{
+		return (uint32_t)std::floor(std::log2(glm::max(width, height))) + 1;
+	}
+
+	VkMemoryRequirements Image::GetMemoryRequirements(const ImageSpecification& specification)
+	{
+		return GetMemoryRequirements(Utils::CreateImageCreateInfo(specification));
+	}
+
+	VkMemoryRequirements Image::GetMemoryRequirements(const VkImageCreateInfo& imageCreateInfo)
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+		// Vulkan 1.2 can only query requirements of an existing image
+		VkImage image;
+		VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &image));
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(device, image, &requirements);
+		vkDestroyImage(device, image, nullptr);
+
+		return requirements;
 	}
 
 	bool Image::IsDepthFormat(VkFormat format)
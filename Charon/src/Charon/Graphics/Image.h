@@ -10,6 +10,9 @@ namespace Charon {
 		VkImageView ImageView = nullptr;
 		VkSampler Sampler = nullptr;
 		VmaAllocation MemoryAlloc = nullptr;
+
+		// Single mip views, only created when the image has more than one mip
+		std::vector<VkImageView> MipImageViews;
 	};
 
 	struct ImageSpecification
@@ -19,6 +22,7 @@ namespace Charon {
 		uint32_t Height;
 		VkFormat Format;
 		uint32_t LayerCount = 1;
+		uint32_t MipLevels = 1;
 		VkImageUsageFlags Usage;
 		VkSampleCountFlagBits SampleCount = VK_SAMPLE_COUNT_1_BIT;
 		bool UseStagingBuffer = true;
@@ -34,19 +38,34 @@ namespace Charon {
 
 		void Release();
 		void Resize(uint32_t width, uint32_t height);
+
+		// Copy with the top droppedMips levels removed, blitted down from this image on the GPU
+		Ref<Image> CreateReducedCopy(uint32_t droppedMips) const;
+
+		// Moves the contents to a new image bound at memory + offset, used when defragmentation moves the allocation.
+		// The GPU must be idle, the views are recreated so descriptors have to be updated afterwards.
+		void Rebind(VkDeviceMemory memory, VkDeviceSize offset);
 	public:
 
 		inline const ImageSpecification& GetSpecification() const { return m_Specification; }
 		inline const VkDescriptorImageInfo& GetDescriptorImageInfo() const { return m_DescriptorImageInfo; }
+		inline const VkDescriptorImageInfo& GetMipDescriptorImageInfo(uint32_t mip) const { return m_MipDescriptorImageInfos[mip]; }
+		inline VkImage GetImage() const { return m_ImageInfo.Image; }
+		inline VmaAllocation GetAllocation() const { return m_ImageInfo.MemoryAlloc; }
 	public:
+		static uint32_t CalculateMipCount(uint32_t width, uint32_t height);
+		static VkMemoryRequirements GetMemoryRequirements(const ImageSpecification& specification);
+		static VkMemoryRequirements GetMemoryRequirements(const VkImageCreateInfo& imageCreateInfo);
 		static bool IsDepthFormat(VkFormat format);
 		static bool IsStencilFormat(VkFormat format);
 	private:
 		void Init();
+		void CreateImageViews();
 
 	private:
 		ImageInfo m_ImageInfo;
 		VkDescriptorImageInfo m_DescriptorImageInfo;
+		std::vector<VkDescriptorImageInfo> m_MipDescriptorImageInfos;
 		uint32_t m_Size = 0;
 
 		ImageSpecification m_Specification;
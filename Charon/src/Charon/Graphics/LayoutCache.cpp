@@ -0,0 +1,148 @@
+#include "pch.h"
+#include "LayoutCache.h"
+#include "Charon/Core/Application.h"
+#include "Charon/Graphics/VulkanTools.h"
+#include <mutex>
+
+namespace Charon {
+
+	struct LayoutKeyHash
+	{
+		size_t operator()(const std::vector<uint64_t>& key) const
+		{
+			// FNV-1a over the key words
+			uint64_t hash = 14695981039346656037ull;
+			for (uint64_t value : key)
+			{
+				hash ^= value;
+				hash *= 1099511628211ull;
+			}
+
+			return (size_t)hash;
+		}
+	};
+
+	struct LayoutCacheData
+	{
+		std::unordered_map<std::vector<uint64_t>, VkDescriptorSetLayout, LayoutKeyHash> DescriptorSetLayouts;
+		std::unordered_map<std::vector<uint64_t>, VkPipelineLayout, LayoutKeyHash> PipelineLayouts;
+		std::mutex Mutex;
+	};
+
+	static LayoutCacheData* s_Data = nullptr;
+
+	void LayoutCache::Init()
+	{
+		s_Data = new LayoutCacheData();
+		CR_LOG_INFO("Initialized LayoutCache");
+	}
+
+	void LayoutCache::Shutdown()
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+		for (auto& [key, pipelineLayout] : s_Data->PipelineLayouts)
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+
+		for (auto& [key, descriptorSetLayout] : s_Data->DescriptorSetLayouts)
+			vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+		delete s_Data;
+		s_Data = nullptr;
+	}
+
+	VkDescriptorSetLayout LayoutCache::GetDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags)
+	{
+		std::vector<VkDescriptorSetLayoutBinding> sortedBindings;
+		sortedBindings.reserve(bindings.size());
+
+		for (const VkDescriptorSetLayoutBinding& binding : bindings)
+		{
+			CR_ASSERT(!binding.pImmutableSamplers, "Immutable samplers are not supported by the layout cache");
+
+			auto it = std::find_if(sortedBindings.begin(), sortedBindings.end(), [&](const VkDescriptorSetLayoutBinding& other) { return other.binding == binding.binding; });
+			if (it != sortedBindings.end())
+			{
+				CR_ASSERT(it->descriptorType == binding.descriptorType && it->descriptorCount == binding.descriptorCount, "Conflicting definitions of the same binding");
+				it->stageFlags |= binding.stageFlags;
+				continue;
+			}
+
+			sortedBindings.push_back(binding);
+		}
+
+		std::sort(sortedBindings.begin(), sortedBindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) { return a.binding < b.binding; });
+
+		std::vector<uint64_t> key;
+		key.reserve(sortedBindings.size() * 2 + 1);
+		key.push_back(flags);
+		for (const VkDescriptorSetLayoutBinding& binding : sortedBindings)
+		{
+			key.push_back(((uint64_t)binding.binding << 32) | binding.descriptorType);
+			key.push_back(((uint64_t)binding.descriptorCount << 32) | binding.stageFlags);
+		}
+
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+
+		auto [it, inserted] = s_Data->DescriptorSetLayouts.try_emplace(std::move(key), nullptr);
+		if (inserted)
+		{
+			VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+			VkDescriptorSetLayoutCreateInfo layoutInfo{};
+			layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+			layoutInfo.flags = flags;
+			layoutInfo.bindingCount = (uint32_t)sortedBindings.size();
+			layoutInfo.pBindings = sortedBindings.data();
+			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &it->second));
+		}
+
+		return it->second;
+	}
+
+	VkPipelineLayout LayoutCache::GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges)
+	{
+		std::vector<uint64_t> key;
+		key.reserve(setLayouts.size() + pushConstantRanges.size() * 2 + 1);
+		key.push_back(setLayouts.size());
+		for (VkDescriptorSetLayout setLayout : setLayouts)
+			key.push_back((uint64_t)setLayout);
+
+		for (const VkPushConstantRange& range : pushConstantRanges)
+		{
+			key.push_back(range.stageFlags);
+			key.push_back(((uint64_t)range.offset << 32) | range.size);
+		}
+
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+
+		auto [it, inserted] = s_Data->PipelineLayouts.try_emplace(std::move(key), nullptr);
+		if (inserted)
+		{
+			VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+			VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+			pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+			pipelineLayoutInfo.setLayoutCount = (uint32_t)setLayouts.size();
+			pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+			pipelineLayoutInfo.pushConstantRangeCount = (uint32_t)pushConstantRanges.size();
+			pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
+			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &it->second));
+		}
+
+		return it->second;
+	}
+
+	uint32_t LayoutCache::GetDescriptorSetLayoutCount()
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+		return (uint32_t)s_Data->DescriptorSetLayouts.size();
+	}
+
+	uint32_t LayoutCache::GetPipelineLayoutCount()
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+		return (uint32_t)s_Data->PipelineLayouts.size();
+	}
+
+}
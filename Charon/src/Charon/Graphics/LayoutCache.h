@@ -0,0 +1,24 @@
+#pragma once
+#include "Charon/Core/Core.h"
+#include <vulkan/vulkan.h>
+
+namespace Charon {
+
+	// Interns descriptor set layouts and pipeline layouts so identical definitions share one handle.
+	// Pipelines built from the same layouts are compatible, so sets bound for one stay valid after switching to another.
+	// Returned handles are owned by the cache and live until Shutdown, callers must not destroy them.
+	class LayoutCache
+	{
+	public:
+		static void Init();
+		static void Shutdown();
+
+		// Bindings are sorted and bindings reflected by several stages are merged before lookup
+		static VkDescriptorSetLayout GetDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings, VkDescriptorSetLayoutCreateFlags flags = 0);
+		static VkPipelineLayout GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts, const std::vector<VkPushConstantRange>& pushConstantRanges = {});
+
+		static uint32_t GetDescriptorSetLayoutCount();
+		static uint32_t GetPipelineLayoutCount();
+	};
+
+}
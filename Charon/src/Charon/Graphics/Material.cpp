@@ -0,0 +1,13 @@
+#include "pch.h"
+#include "Material.h"
+
+namespace Charon {
+
+	static uint32_t s_NextMaterialID = 0;
+
+	Material::Material()
+		: m_ID(s_NextMaterialID++)
+	{
+	}
+
+}
@@ -19,12 +19,16 @@ namespace Charon {
 	class Material
 	{
 	public:
-		Material() = default; // TODO: shader
+		Material(); // TODO: shader
 		virtual ~Material() = default;
 
 		MaterialBuffer& GetMaterialBuffer() { return m_MaterialBuffer; }
+
+		// Unique across all meshes and never reused, used to sort draws by material
+		inline uint32_t GetID() const { return m_ID; }
 	private:
 		MaterialBuffer m_MaterialBuffer;
+		uint32_t m_ID = 0;
 	};
 
 
@@ -1,17 +1,36 @@
 #include "pch.h"
 #include "Mesh.h"
+#include "Charon/Core/Application.h"
 #include "glm/gtc/type_ptr.hpp"
 
 namespace Charon {
 
-	Mesh::Mesh(const std::filesystem::path& path)
-		: m_Path(path)
+	Mesh::Mesh(const std::filesystem::path& path, bool retainCPUData)
+		: m_Path(path), m_RetainCPUData(retainCPUData)
 	{
 		Init();
 	}
 
 	Mesh::~Mesh()
 	{
+		GeometryPoolAllocation vertexAllocation = m_VertexAllocation;
+		GeometryPoolAllocation indexAllocation = m_IndexAllocation;
+
+		// Ranges may still be in use by frames in flight
+		Ref<Renderer> renderer = Application::GetApp().GetRenderer();
+		if (renderer)
+		{
+			renderer->SubmitResourceFree([vertexAllocation, indexAllocation]()
+			{
+				GeometryPool::FreeVertices(vertexAllocation);
+				GeometryPool::FreeIndices(indexAllocation);
+			});
+		}
+		else
+		{
+			GeometryPool::FreeVertices(vertexAllocation);
+			GeometryPool::FreeIndices(indexAllocation);
+		}
 	}
 
 	void Mesh::Init()
@@ -33,8 +52,49 @@ namespace Charon {
 			CalculateNodeTransforms(node, m_Model, glm::mat4(1.0f));
 		}
 
-		m_VertexBuffer = CreateRef<VertexBuffer>(m_Vertices.data(), sizeof(Vertex) * m_Vertices.size());
-		m_IndexBuffer = CreateRef<IndexBuffer>(m_Indices.data(), sizeof(uint32_t) * m_Indices.size(), m_Indices.size());
+		m_VertexAllocation = GeometryPool::AllocateVertices(m_Vertices.data(), (uint32_t)m_Vertices.size());
+		m_IndexAllocation = GeometryPool::AllocateIndices(m_Indices.data(), (uint32_t)m_Indices.size());
+
+		// Rebase submesh offsets into the pool
+		for (SubMesh& subMesh : m_SubMeshes)
+		{
+			subMesh.VertexOffset += m_VertexAllocation.Offset;
+			subMesh.IndexOffset += m_IndexAllocation.Offset;
+		}
+
+		// Drawing and BLAS builds read the geometry from the pool, so the CPU copy is only kept on request
+		ReleaseCPUData();
+	}
+
+	const std::vector<Vertex>& Mesh::GetVertices() const
+	{
+		CR_ASSERT(!m_CPUDataReleased, "Mesh CPU data has been released");
+		return m_Vertices;
+	}
+
+	const std::vector<uint32_t>& Mesh::GetIndices() const
+	{
+		CR_ASSERT(!m_CPUDataReleased, "Mesh CPU data has been released");
+		return m_Indices;
+	}
+
+	void Mesh::ReleaseCPUData()
+	{
+		if (m_RetainCPUData || m_CPUDataReleased)
+			return;
+
+		// Swap with empty containers so the memory is actually returned
+		std::vector<Vertex>().swap(m_Vertices);
+		std::vector<uint32_t>().swap(m_Indices);
+		m_Model = tinygltf::Model();
+
+		m_CPUDataReleased = true;
+	}
+
+	void Mesh::MarkTexturesUsed() const
+	{
+		for (const Ref<Texture2D>& texture : m_Textures)
+			texture->MarkUsed();
 	}
 
 	void Mesh::LoadData()
@@ -52,6 +112,7 @@ namespace Charon {
 			{
 				int subMeshVertexCount = 0;
 				int subMeshIndexCount = 0;
+				AABB subMeshBoundingBox;
 
 				const tinygltf::Primitive& primitive = mesh.primitives[i];
 
@@ -73,6 +134,21 @@ namespace Charon {
 						m_Vertices[subMeshVertexOffset + j].Position.z = positions[j * 3 + 2];
 					}
 
+					// glTF requires min/max on position accessors
+					if (accessor.minValues.size() == 3 && accessor.maxValues.size() == 3)
+					{
+						subMeshBoundingBox.Min = glm::vec3(glm::make_vec3(accessor.minValues.data()));
+						subMeshBoundingBox.Max = glm::vec3(glm::make_vec3(accessor.maxValues.data()));
+					}
+					else
+					{
+						for (int j = 0; j < accessor.count; j++)
+						{
+							subMeshBoundingBox.Min = glm::min(subMeshBoundingBox.Min, m_Vertices[subMeshVertexOffset + j].Position);
+							subMeshBoundingBox.Max = glm::max(subMeshBoundingBox.Max, m_Vertices[subMeshVertexOffset + j].Position);
+						}
+					}
+
 					subMeshVertexCount = accessor.count;
 				}
 
@@ -158,6 +234,7 @@ namespace Charon {
 				subMesh.VertexCount = subMeshVertexCount;
 				subMesh.VertexOffset = subMeshVertexOffset;
 				subMesh.MaterialIndex = primitive.material;
+				subMesh.BoundingBox = subMeshBoundingBox;
 
 				subMeshIndexOffset += subMeshIndexCount;
 				subMeshVertexOffset += subMeshVertexCount;
@@ -202,8 +279,8 @@ namespace Charon {
 				CR_LOG_WARN("Texture [{}]: {}", mat.pbrMetallicRoughness.baseColorTexture.index, image.uri);
 				auto imagePath = m_Path.parent_path() / image.uri;
 
-				materialBuffer.AlbedoMap = (uint32_t)m_Textures.size();
-				m_Textures.emplace_back(CreateRef<Texture2D>(imagePath));
+				Ref<Texture2D> albedoTexture = m_Textures.emplace_back(CreateRef<Texture2D>(imagePath));
+				materialBuffer.AlbedoMap = albedoTexture->GetBindlessIndex();
 
 				materialBuffer.AlbedoValue = glm::vec3(1);
 			}
@@ -1,6 +1,7 @@
 #pragma once
 #include "Charon/Asset/Asset.h"
 #include "Charon/Graphics/Buffers.h"
+#include "Charon/Graphics/GeometryPool.h"
 #include "Charon/Graphics/Material.h"
 #include <tinygltf/tiny_gltf.h>
 #include <glm/glm.hpp>
@@ -10,13 +11,21 @@
 
 namespace Charon {
 
+	struct AABB
+	{
+		glm::vec3 Min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 Max = glm::vec3(std::numeric_limits<float>::lowest());
+	};
+
 	struct SubMesh
 	{
+		// Offsets are into the GeometryPool buffers
 		uint32_t VertexOffset = 0;
 		uint32_t VertexCount = 0;
 		uint32_t IndexOffset = 0;
 		uint32_t IndexCount = 0;
 		uint32_t MaterialIndex = 0;
+		AABB BoundingBox; // Local space, before Transform
 		glm::mat4 Transform = glm::mat4(1.0f);
 	};
 
@@ -31,23 +40,34 @@ namespace Charon {
 	class Mesh : public Asset
 	{
 	public:
-		Mesh(const std::filesystem::path& path);
+		// CPU-side vertex/index data and the glTF model are released once the geometry is uploaded to the GeometryPool,
+		// unless retainCPUData is set for code that reads them later.
+		Mesh(const std::filesystem::path& path, bool retainCPUData = false);
 		~Mesh();
 
 		inline const std::vector<SubMesh>& GetSubMeshes() const { return m_SubMeshes; }
 
-		inline Ref<VertexBuffer> GetVertexBuffer() const { return m_VertexBuffer; }
-		inline Ref<IndexBuffer> GetIndexBuffer() const { return m_IndexBuffer; }
+		const std::vector<Vertex>& GetVertices() const;
+		const std::vector<uint32_t>& GetIndices() const;
+		void ReleaseCPUData();
+
+		inline const GeometryPoolAllocation& GetVertexAllocation() const { return m_VertexAllocation; }
+		inline const GeometryPoolAllocation& GetIndexAllocation() const { return m_IndexAllocation; }
 
 		const std::vector<Ref<Material>>& GetMaterials() const { return m_Materials; }
 		const std::vector<Ref<Texture2D>>& GetTextures() const { return m_Textures; }
 
+		// Materials sample through bindless indices, so texture use is tracked per mesh rather than per draw
+		void MarkTexturesUsed() const;
+
 	private:
 		void Init();
 		void LoadData();
 		void CalculateNodeTransforms(const tinygltf::Node& inputNode, const tinygltf::Model& input, const glm::mat4& parentTransform);
 	private:
 		std::filesystem::path m_Path;
+		bool m_RetainCPUData = false;
+		bool m_CPUDataReleased = false;
 
 		std::vector<SubMesh> m_SubMeshes;
 		std::vector<Vertex> m_Vertices;
@@ -55,8 +75,8 @@ namespace Charon {
 		std::vector<Ref<Material>> m_Materials;
 		std::vector<Ref<Texture2D>> m_Textures;
 
-		Ref<VertexBuffer> m_VertexBuffer;
-		Ref<IndexBuffer> m_IndexBuffer;
+		GeometryPoolAllocation m_VertexAllocation;
+		GeometryPoolAllocation m_IndexAllocation;
 
 		tinygltf::Model m_Model;
 	};
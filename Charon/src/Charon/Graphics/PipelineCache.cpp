@@ -0,0 +1,152 @@
+#include "pch.h"
+#include "PipelineCache.h"
+#include "Charon/Core/Application.h"
+#include "Charon/Graphics/VulkanTools.h"
+#include <fstream>
+
+namespace Charon {
+
+	// Written in front of the driver's data, the driver header has no driver version
+	struct PipelineCacheFileHeader
+	{
+		uint32_t Magic;
+		uint32_t DataSize;
+		uint32_t VendorID;
+		uint32_t DeviceID;
+		uint32_t DriverVersion;
+		uint8_t PipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	struct PipelineCacheData
+	{
+		VkPipelineCache PipelineCache = nullptr;
+		std::filesystem::path Path;
+	};
+
+	static PipelineCacheData* s_Data = nullptr;
+
+	namespace Utils {
+
+		static const uint32_t s_PipelineCacheMagic = 0x43504352; // "RCPC"
+
+		static PipelineCacheFileHeader GetPipelineCacheFileHeader()
+		{
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(Application::GetApp().GetVulkanDevice()->GetPhysicalDevice(), &properties);
+
+			PipelineCacheFileHeader header = {};
+			header.Magic = s_PipelineCacheMagic;
+			header.VendorID = properties.vendorID;
+			header.DeviceID = properties.deviceID;
+			header.DriverVersion = properties.driverVersion;
+			memcpy(header.PipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+			return header;
+		}
+
+		static std::vector<uint8_t> ReadPipelineCacheFile(const std::filesystem::path& path)
+		{
+			std::ifstream stream(path, std::ios::binary);
+			if (!stream.good())
+				return {};
+
+			PipelineCacheFileHeader header = {};
+			stream.read((char*)&header, sizeof(PipelineCacheFileHeader));
+
+			PipelineCacheFileHeader expected = GetPipelineCacheFileHeader();
+			bool valid = stream.good() && header.Magic == expected.Magic &&
+				header.VendorID == expected.VendorID &&
+				header.DeviceID == expected.DeviceID &&
+				header.DriverVersion == expected.DriverVersion &&
+				memcmp(header.PipelineCacheUUID, expected.PipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+			if (!valid)
+			{
+				CR_LOG_WARN("Discarding pipeline cache {0}, it was written by a different device or driver", path.string());
+				return {};
+			}
+
+			std::vector<uint8_t> data(header.DataSize);
+			stream.read((char*)data.data(), data.size());
+			if (!stream.good())
+			{
+				CR_LOG_WARN("Discarding pipeline cache {0}, the file is truncated", path.string());
+				return {};
+			}
+
+			return data;
+		}
+
+	}
+
+	void PipelineCache::Init(const std::filesystem::path& path)
+	{
+		s_Data = new PipelineCacheData();
+		s_Data->Path = path;
+
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+		std::vector<uint8_t> data = Utils::ReadPipelineCacheFile(path);
+
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		pipelineCacheCreateInfo.initialDataSize = data.size();
+		pipelineCacheCreateInfo.pInitialData = data.data();
+		VK_CHECK_RESULT(vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &s_Data->PipelineCache));
+
+		CR_LOG_INFO("Initialized PipelineCache; loaded {0} bytes", data.size());
+	}
+
+	void PipelineCache::Shutdown()
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+		Save();
+		vkDestroyPipelineCache(device, s_Data->PipelineCache, nullptr);
+
+		delete s_Data;
+		s_Data = nullptr;
+	}
+
+	void PipelineCache::Save()
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+		size_t dataSize = 0;
+		VK_CHECK_RESULT(vkGetPipelineCacheData(device, s_Data->PipelineCache, &dataSize, nullptr));
+
+		std::vector<uint8_t> data(dataSize);
+		VK_CHECK_RESULT(vkGetPipelineCacheData(device, s_Data->PipelineCache, &dataSize, data.data()));
+
+		PipelineCacheFileHeader header = Utils::GetPipelineCacheFileHeader();
+		header.DataSize = (uint32_t)dataSize;
+
+		std::filesystem::path directory = s_Data->Path.parent_path();
+		if (!directory.empty())
+			std::filesystem::create_directories(directory);
+
+		// Write to a temporary file first so a crash never leaves a half written cache behind
+		std::filesystem::path tempPath = s_Data->Path;
+		tempPath += ".tmp";
+		{
+			std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+			stream.write((const char*)&header, sizeof(PipelineCacheFileHeader));
+			stream.write((const char*)data.data(), dataSize);
+
+			if (!stream.good())
+			{
+				CR_LOG_WARN("Failed to write pipeline cache {0}", tempPath.string());
+				return;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, s_Data->Path, error);
+		if (error)
+			CR_LOG_WARN("Failed to write pipeline cache {0}: {1}", s_Data->Path.string(), error.message());
+	}
+
+	VkPipelineCache PipelineCache::GetPipelineCache()
+	{
+		return s_Data->PipelineCache;
+	}
+
+}
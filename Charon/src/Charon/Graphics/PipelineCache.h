@@ -0,0 +1,22 @@
+#pragma once
+#include "Charon/Core/Core.h"
+#include <vulkan/vulkan.h>
+#include <filesystem>
+
+namespace Charon {
+
+	// Single VkPipelineCache shared by every pipeline, persisted between runs.
+	// The file is only used when it was written by the same GPU and driver, otherwise the cache starts empty.
+	class PipelineCache
+	{
+	public:
+		static void Init(const std::filesystem::path& path = "cache/PipelineCache.bin");
+		static void Shutdown();
+
+		// Writes the current cache contents to disk, also done on shutdown
+		static void Save();
+
+		static VkPipelineCache GetPipelineCache();
+	};
+
+}
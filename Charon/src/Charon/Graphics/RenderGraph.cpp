@@ -0,0 +1,230 @@
+#include "pch.h"
+#include "RenderGraph.h"
+#include "Charon/Core/Application.h"
+
+namespace Charon {
+
+	namespace Utils {
+
+		static const VkAccessFlags s_WriteAccessFlags =
+			VK_ACCESS_SHADER_WRITE_BIT |
+			VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_TRANSFER_WRITE_BIT |
+			VK_ACCESS_HOST_WRITE_BIT |
+			VK_ACCESS_MEMORY_WRITE_BIT |
+			VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+
+		static VkImageAspectFlags GetImageAspectFlags(VkFormat format)
+		{
+			if (!Image::IsDepthFormat(format))
+				return VK_IMAGE_ASPECT_COLOR_BIT;
+
+			return Image::IsStencilFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+		}
+
+	}
+
+	const RenderGraphAccess RenderGraphAccess::ColorAttachment = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+	const RenderGraphAccess RenderGraphAccess::DepthAttachment = { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+	const RenderGraphAccess RenderGraphAccess::VertexRead = { VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+	const RenderGraphAccess RenderGraphAccess::FragmentRead = { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+	const RenderGraphAccess RenderGraphAccess::ComputeRead = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+	const RenderGraphAccess RenderGraphAccess::ComputeWrite = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
+	const RenderGraphAccess RenderGraphAccess::RayTracingRead = { VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_SHADER_READ_BIT };
+	const RenderGraphAccess RenderGraphAccess::RayTracingWrite = { VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT };
+	const RenderGraphAccess RenderGraphAccess::IndirectRead = { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT };
+	const RenderGraphAccess RenderGraphAccess::TransferWrite = { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+
+	bool RenderGraphAccess::IsWrite() const
+	{
+		return (Access & Utils::s_WriteAccessFlags) != 0;
+	}
+
+	RenderGraph::RenderGraph()
+	{
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+	}
+
+	RenderGraphResource RenderGraph::ImportImage(Ref<Image> image)
+	{
+		return Import((uint64_t)image->GetImage(), image, nullptr);
+	}
+
+	RenderGraphResource RenderGraph::ImportBuffer(VkBuffer buffer)
+	{
+		return Import((uint64_t)buffer, nullptr, buffer);
+	}
+
+	void RenderGraph::AddPass(const std::string& name, const std::vector<ResourceAccess>& accesses, ExecuteFunction execute)
+	{
+		for (const auto& [handle, access] : accesses)
+			CR_ASSERT(handle < m_Resources.size(), "Unknown render graph resource");
+
+		m_Passes.push_back({ name, accesses, std::move(execute) });
+	}
+
+	Ref<Image> RenderGraph::GetImage(RenderGraphResource resource) const
+	{
+		CR_ASSERT(m_Resources[resource].Image, "Render graph resource is not an image");
+		return m_Resources[resource].Image;
+	}
+
+	void RenderGraph::Execute(VkCommandBuffer commandBuffer)
+	{
+		uint64_t frame = Application::GetApp().GetRenderer()->GetFrameCounter();
+
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+		for (const Pass& pass : m_Passes)
+		{
+			// Barriers of every access are merged into one call per pass
+			VkPipelineStageFlags srcStages = 0;
+			VkPipelineStageFlags dstStages = 0;
+			VkMemoryBarrier memoryBarrier = {};
+			memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			imageBarriers.clear();
+
+			for (const auto& [handle, access] : pass.Accesses)
+			{
+				Resource& resource = m_Resources[handle];
+				ResourceState& state = resource.State;
+
+				VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+				if (resource.Image)
+					layout = access.Layout != VK_IMAGE_LAYOUT_UNDEFINED ? access.Layout : resource.Image->GetDescriptorImageInfo().imageLayout;
+
+				bool transition = layout != state.Layout;
+				if (access.IsWrite() || transition)
+				{
+					// Wait for every earlier access, only earlier writes have to be made visible
+					VkPipelineStageFlags waitStages = state.WriteStages | state.ReadStages;
+					if (transition)
+					{
+						VkImageMemoryBarrier& barrier = imageBarriers.emplace_back();
+						barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+						barrier.srcAccessMask = state.WriteAccess;
+						barrier.dstAccessMask = access.Access;
+						barrier.oldLayout = state.Layout;
+						barrier.newLayout = layout;
+						barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+						barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+						barrier.image = resource.Image->GetImage();
+						barrier.subresourceRange = { Utils::GetImageAspectFlags(resource.Image->GetSpecification().Format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+						srcStages |= waitStages;
+						dstStages |= access.Stages;
+					}
+					else if (waitStages)
+					{
+						memoryBarrier.srcAccessMask |= state.WriteAccess;
+						memoryBarrier.dstAccessMask |= access.Access;
+
+						srcStages |= waitStages;
+						dstStages |= access.Stages;
+					}
+
+					// A transition counts as a write, later reads in other stages have to wait for it
+					state.Layout = layout;
+					state.WriteStages = access.Stages;
+					state.WriteAccess = access.Access & Utils::s_WriteAccessFlags;
+					state.ReadStages = access.IsWrite() ? 0 : access.Stages;
+					state.ReadAccess = access.IsWrite() ? 0 : access.Access;
+				}
+				else if ((access.Stages & ~state.ReadStages) || (access.Access & ~state.ReadAccess))
+				{
+					// Reads only wait the first time a stage reads the last write
+					if (state.WriteStages)
+					{
+						memoryBarrier.srcAccessMask |= state.WriteAccess;
+						memoryBarrier.dstAccessMask |= access.Access;
+
+						srcStages |= state.WriteStages;
+						dstStages |= access.Stages;
+					}
+
+					state.ReadStages |= access.Stages;
+					state.ReadAccess |= access.Access;
+				}
+			}
+
+			if (dstStages)
+			{
+				bool hasMemoryBarrier = memoryBarrier.srcAccessMask || memoryBarrier.dstAccessMask;
+				vkCmdPipelineBarrier(commandBuffer,
+					srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStages, 0,
+					hasMemoryBarrier ? 1 : 0, &memoryBarrier,
+					0, nullptr,
+					(uint32_t)imageBarriers.size(), imageBarriers.data());
+			}
+
+			if (pass.Execute)
+			{
+				VkDebugUtilsLabelEXT label = {};
+				label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+				label.pLabelName = pass.Name.c_str();
+
+				vkCmdBeginDebugUtilsLabelEXT(commandBuffer, &label);
+				pass.Execute(commandBuffer);
+				vkCmdEndDebugUtilsLabelEXT(commandBuffer);
+			}
+		}
+
+		// Carry imported states over to the next execution, forget resources that haven't been seen for a while
+		std::lock_guard<std::mutex> lock(m_StateMutex);
+		for (const auto& [handle, resource] : m_ImportedResources)
+		{
+			ResourceState& state = m_ImportedStates[handle];
+			state = m_Resources[resource].State;
+			state.LastUsedFrame = frame;
+		}
+
+		for (auto it = m_ImportedStates.begin(); it != m_ImportedStates.end();)
+		{
+			if (it->second.LastUsedFrame + s_MaxUnusedFrames < frame)
+				it = m_ImportedStates.erase(it);
+			else
+				it++;
+		}
+
+		m_Resources.clear();
+		m_Passes.clear();
+		m_ImportedResources.clear();
+	}
+
+	void RenderGraph::ForgetResource(uint64_t handle)
+	{
+		std::lock_guard<std::mutex> lock(m_StateMutex);
+		m_ImportedStates.erase(handle);
+	}
+
+	RenderGraphResource RenderGraph::Import(uint64_t handle, Ref<Image> image, VkBuffer buffer)
+	{
+		auto [it, inserted] = m_ImportedResources.try_emplace(handle, (RenderGraphResource)m_Resources.size());
+		if (!inserted)
+			return it->second;
+
+		Resource& resource = m_Resources.emplace_back();
+		resource.Image = image;
+		resource.Buffer = buffer;
+
+		std::lock_guard<std::mutex> lock(m_StateMutex);
+		auto stateIt = m_ImportedStates.find(handle);
+		if (stateIt != m_ImportedStates.end())
+		{
+			resource.State = stateIt->second;
+		}
+		else
+		{
+			// Unknown history, the first access waits for everything recorded before it
+			resource.State.Layout = image ? image->GetDescriptorImageInfo().imageLayout : VK_IMAGE_LAYOUT_UNDEFINED;
+			resource.State.WriteStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			resource.State.WriteAccess = VK_ACCESS_MEMORY_WRITE_BIT;
+		}
+
+		return it->second;
+	}
+
+}
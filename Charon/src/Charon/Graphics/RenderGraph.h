@@ -0,0 +1,99 @@
+#pragma once
+#include "Charon/Graphics/Image.h"
+#include <functional>
+#include <mutex>
+
+namespace Charon {
+
+	// How a pass uses a resource. Layout is ignored for buffers, VK_IMAGE_LAYOUT_UNDEFINED means the image's descriptor layout.
+	struct RenderGraphAccess
+	{
+		VkPipelineStageFlags Stages = 0;
+		VkAccessFlags Access = 0;
+		VkImageLayout Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		bool IsWrite() const;
+
+		// Framebuffer render passes leave their attachments in the descriptor layout, so attachment accesses keep it
+		static const RenderGraphAccess ColorAttachment;
+		static const RenderGraphAccess DepthAttachment;
+		static const RenderGraphAccess VertexRead;
+		static const RenderGraphAccess FragmentRead;
+		static const RenderGraphAccess ComputeRead;
+		static const RenderGraphAccess ComputeWrite;
+		static const RenderGraphAccess RayTracingRead;
+		static const RenderGraphAccess RayTracingWrite;
+		static const RenderGraphAccess IndirectRead;
+		static const RenderGraphAccess TransferWrite;
+	};
+
+	using RenderGraphResource = uint32_t;
+
+	// Passes are recorded in the order they are added, with the barriers and layout transitions between them derived from
+	// the accesses they declare. States of imported resources carry over between executions, so the first pass of a frame
+	// also waits on the previous frame. Barriers inside a pass are still up to the pass.
+	class RenderGraph
+	{
+	public:
+		using ExecuteFunction = std::function<void(VkCommandBuffer)>;
+		using ResourceAccess = std::pair<RenderGraphResource, RenderGraphAccess>;
+
+		RenderGraph();
+		~RenderGraph();
+
+		RenderGraphResource ImportImage(Ref<Image> image);
+		RenderGraphResource ImportBuffer(VkBuffer buffer);
+
+		// A pass without an execute function only inserts barriers, used to hand results to work recorded outside the graph
+		void AddPass(const std::string& name, const std::vector<ResourceAccess>& accesses, ExecuteFunction execute = nullptr);
+
+		Ref<Image> GetImage(RenderGraphResource resource) const;
+
+		// Records every pass and clears the graph for the next set of passes
+		void Execute(VkCommandBuffer commandBuffer);
+
+		// Drops the state carried over for a destroyed image or buffer, so a new one reusing the handle value starts fresh
+		void ForgetResource(uint64_t handle);
+	private:
+		struct ResourceState
+		{
+			VkImageLayout Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			// Last write, and the reads since then that already waited on it
+			VkPipelineStageFlags WriteStages = 0;
+			VkAccessFlags WriteAccess = 0;
+			VkPipelineStageFlags ReadStages = 0;
+			VkAccessFlags ReadAccess = 0;
+
+			uint64_t LastUsedFrame = 0;
+		};
+
+		struct Resource
+		{
+			Ref<Image> Image;
+			VkBuffer Buffer = nullptr;
+			ResourceState State;
+		};
+
+		struct Pass
+		{
+			std::string Name;
+			std::vector<ResourceAccess> Accesses;
+			ExecuteFunction Execute;
+		};
+
+	private:
+		RenderGraphResource Import(uint64_t handle, Ref<Image> image, VkBuffer buffer);
+
+	private:
+		std::vector<Resource> m_Resources;
+		std::vector<Pass> m_Passes;
+		std::unordered_map<uint64_t, RenderGraphResource> m_ImportedResources; // Vulkan handle -> resource this execution
+
+		std::unordered_map<uint64_t, ResourceState> m_ImportedStates; // Vulkan handle -> state after the last execution
+		std::mutex m_StateMutex; // Resources can be destroyed off the main thread
+
+		static const uint64_t s_MaxUnusedFrames = 16;
+	};
+
+}
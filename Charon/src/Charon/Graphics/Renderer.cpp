@@ -2,6 +2,10 @@
 #include "Renderer.h"
 #include "Charon/Core/Application.h"
 #include "Charon/Graphics/VertexBufferLayout.h"
+#include "Charon/Graphics/GeometryPool.h"
+#include "Charon/Graphics/BindlessDescriptorSet.h"
+#include "Charon/Graphics/UniformBufferRing.h"
+#include "Charon/Graphics/ResidencyManager.h"
 #include "Charon/ImGUI/imgui_impl_vulkan_with_textures.h"
 
 #include <glm/gtc/type_ptr.hpp>
@@ -10,6 +14,62 @@ namespace Charon {
 
 	static Renderer* s_Instance = nullptr;
 
+	namespace Utils {
+
+		// 8 bits pipeline, 24 bits material, 32 bits depth. All geometry lives in the GeometryPool, which is bound once per command buffer
+		static uint64_t CreateSortKey(uint32_t pipelineID, uint32_t materialID, float depth)
+		{
+			// Positive floats compare the same as their bit patterns
+			uint32_t depthBits;
+			depth = glm::max(depth, 0.0f);
+			memcpy(&depthBits, &depth, sizeof(float));
+
+			return ((uint64_t)(pipelineID & 0xFF) << 56) |
+				((uint64_t)(materialID & 0xFFFFFF) << 32) |
+				(uint64_t)depthBits;
+		}
+
+		// Largest power of two less than or equal to value, at least 2 so the depth pyramid has more than one mip
+		static uint32_t PreviousPowerOfTwo(uint32_t value)
+		{
+			uint32_t result = 2;
+			while (result * 2 <= value)
+				result *= 2;
+
+			return result;
+		}
+
+		// LSD radix sort on 8-bit digits, passes where every key shares the digit are skipped
+		static void RadixSort(std::vector<std::pair<uint64_t, uint32_t>>& entries, std::vector<std::pair<uint64_t, uint32_t>>& scratch)
+		{
+			scratch.resize(entries.size());
+
+			for (uint32_t shift = 0; shift < 64; shift += 8)
+			{
+				uint32_t counts[256] = {};
+				for (const auto& entry : entries)
+					counts[(entry.first >> shift) & 0xFF]++;
+
+				if (counts[(entries[0].first >> shift) & 0xFF] == entries.size())
+					continue;
+
+				uint32_t offsets[256];
+				uint32_t offset = 0;
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					offsets[i] = offset;
+					offset += counts[i];
+				}
+
+				for (const auto& entry : entries)
+					scratch[offsets[(entry.first >> shift) & 0xFF]++] = entry;
+
+				entries.swap(scratch);
+			}
+		}
+
+	}
+
 	Renderer::Renderer()
 	{
 		s_Instance = this;
@@ -18,11 +78,15 @@ namespace Charon {
 
 	Renderer::~Renderer()
 	{
+		// Members destroyed below free buffers, the cache goes with them
+		s_Instance = nullptr;
+
 		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
 
-		for (int i = 0; i < m_DescriptorPools.size(); i++)
+		for (auto& framePools : m_SecondaryCommandPools)
 		{
-			vkDestroyDescriptorPool(device, m_DescriptorPools[i], nullptr);
+			for (SecondaryCommandPool& commandPool : framePools)
+				vkDestroyCommandPool(device, commandPool.Pool, nullptr);
 		}
 	}
 
@@ -31,6 +95,37 @@ namespace Charon {
 		Ref<SwapChain> swapChain = Application::GetApp().GetVulkanSwapChain();
 
 		m_CameraUniformBuffer = CreateRef<UniformBuffer>(nullptr, sizeof(CameraBuffer));
+
+		// Per-instance transforms, one buffer per frame in flight. GPU culling compacts the visible ones of each phase
+		// into two more regions of the same size after the submitted transforms.
+		m_InstanceBuffers.resize(swapChain->GetFramesInFlight());
+		for (auto& instanceBuffer : m_InstanceBuffers)
+			instanceBuffer = CreateRef<StorageBuffer>(sizeof(glm::mat4) * s_MaxInstancesPerFrame * 3);
+		m_InstanceTransforms.reserve(s_MaxInstancesPerFrame);
+
+		// GPU culling, one instanced indirect draw per batch with visible instances
+		m_CullShader = CreateRef<Shader>("assets/shaders/Culling/FrustumCull.shader");
+		m_CullPipeline = CreateRef<VulkanComputePipeline>(m_CullShader, nullptr, 0);
+
+		m_GPUDrawBuffers.resize(swapChain->GetFramesInFlight());
+		m_IndirectBuffers.resize(swapChain->GetFramesInFlight());
+		m_DrawCountBuffers.resize(swapChain->GetFramesInFlight());
+		m_DrawVisibilityBuffers.resize(swapChain->GetFramesInFlight());
+		m_GPUDrawBufferVersions.resize(swapChain->GetFramesInFlight(), 0);
+		for (uint32_t i = 0; i < swapChain->GetFramesInFlight(); i++)
+		{
+			// Indirect commands and counts for the early and late culling phase
+			m_GPUDrawBuffers[i] = CreateRef<StorageBuffer>(sizeof(GPUDrawCommand) * s_MaxInstancesPerFrame);
+			m_IndirectBuffers[i] = CreateRef<StorageBuffer>(sizeof(VkDrawIndexedIndirectCommand) * s_MaxInstancesPerFrame * 2, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+			m_DrawCountBuffers[i] = CreateRef<StorageBuffer>(sizeof(uint32_t) * 2, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+			m_DrawVisibilityBuffers[i] = CreateRef<StorageBuffer>(sizeof(uint32_t) * s_MaxInstancesPerFrame);
+		}
+		m_GPUDrawList.reserve(s_MaxInstancesPerFrame);
+		m_GPUDrawScratch.reserve(s_MaxInstancesPerFrame);
+
+		// Depth pyramid is created on first use, sized to the geometry framebuffer
+		m_DepthPyramidShader = CreateRef<Shader>("assets/shaders/Culling/DepthPyramid.shader");
+		m_DepthPyramidPipeline = CreateRef<VulkanComputePipeline>(m_DepthPyramidShader, nullptr, 0);
 		m_Shader = CreateRef<Shader>("assets/shaders/test.shader");
 
 		FramebufferSpecification framebufferSpec;
@@ -40,13 +135,23 @@ namespace Charon {
 		framebufferSpec.ClearOnLoad = false;
 		framebufferSpec.DebugName = "Geometry";
 		m_Framebuffer = CreateRef<Framebuffer>(framebufferSpec);
+		CreateDepthPyramid(m_Framebuffer->GetWidth(), m_Framebuffer->GetHeight());
+
+		m_RenderGraph = CreateRef<RenderGraph>();
 
 		PipelineSpecification pipelineSpec;
 		pipelineSpec.Shader = m_Shader;
 		pipelineSpec.TargetRenderPass = m_Framebuffer->GetRenderPass();
 		m_Pipeline = CreateRef<VulkanPipeline>(pipelineSpec);
 		
-		CreateDescriptorPools();
+		// Transient sets come from per-frame allocators, sets with unchanging contents are cached across frames
+		m_DescriptorAllocators.resize(swapChain->GetFramesInFlight());
+		for (Ref<DescriptorAllocator>& allocator : m_DescriptorAllocators)
+			allocator = CreateRef<DescriptorAllocator>();
+
+		m_DescriptorSetCache = CreateRef<DescriptorSetCache>();
+
+		CreateSecondaryCommandPools();
 
 		m_ResourceFreeQueue.resize(swapChain->GetFramesInFlight());
 	}
@@ -66,10 +171,59 @@ namespace Charon {
 
 		m_ActiveCommandBuffer = swapChain->GetCurrentCommandBuffer();
 
-		VK_CHECK_RESULT(vkResetDescriptorPool(device, m_DescriptorPools[frameIndex], 0));
+		m_FrameCounter++;
+		VulkanAllocator::BeginFrame(m_FrameCounter);
+		ResidencyManager::BeginFrame(m_FrameCounter);
 
+		// Per-frame sets are returned wholesale, cached sets are kept until unused for a while
+		m_DescriptorAllocators[frameIndex]->Reset();
+		m_DescriptorSetCache->BeginFrame(m_FrameCounter);
+		BindlessDescriptorSet::BeginFrame(frameIndex);
+		UniformBufferRing::BeginFrame(frameIndex);
+
+		for (SecondaryCommandPool& commandPool : m_SecondaryCommandPools[frameIndex])
+		{
+			VK_CHECK_RESULT(vkResetCommandPool(device, commandPool.Pool, 0));
+			commandPool.UsedCount = 0;
+		}
+
+		// Instance transforms are appended to this frame's buffer by every Render call
+		m_InstanceTransforms.clear();
+		m_UploadedInstanceCount = 0;
+		m_CulledDrawCount = 0;
+		m_IndirectPhase = 0;
+
+		// Camera and instance buffers are the same every time this frame slot comes around, so the sets are cached.
+		// The camera is a dynamic uniform buffer, its offset into the ring is given when the sets are bound.
 		const std::vector<VkDescriptorSetLayout>& layouts = m_Shader->GetDescriptorSetLayouts();
-		m_DescriptorSets = AllocateDescriptorSets(m_Shader->GetDescriptorSetLayouts());
+		std::vector<std::vector<VkWriteDescriptorSet>> writeDescriptors(layouts.size());
+
+		UniformBufferDescription cameraBufferDescription = m_Shader->GetUniformBufferDescriptions()[0];
+
+		VkWriteDescriptorSet& cameraBufferWriteDescriptor = writeDescriptors[cameraBufferDescription.DescriptorSetIndex].emplace_back();
+		cameraBufferWriteDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		cameraBufferWriteDescriptor.descriptorCount = 1;
+		cameraBufferWriteDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		cameraBufferWriteDescriptor.dstBinding = cameraBufferDescription.BindingPoint;
+		cameraBufferWriteDescriptor.pBufferInfo = &m_CameraUniformBuffer->GetDynamicDescriptorBufferInfo();
+
+		StorageBufferDescription instanceBufferDescription = m_Shader->GetStorageBufferDescriptions()[0];
+
+		VkWriteDescriptorSet& instanceBufferWriteDescriptor = writeDescriptors[instanceBufferDescription.DescriptorSetIndex].emplace_back();
+		instanceBufferWriteDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		instanceBufferWriteDescriptor.descriptorCount = 1;
+		instanceBufferWriteDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		instanceBufferWriteDescriptor.dstBinding = instanceBufferDescription.BindingPoint;
+		instanceBufferWriteDescriptor.pBufferInfo = &m_InstanceBuffers[frameIndex]->getDescriptorBufferInfo();
+
+		m_DescriptorSets.resize(layouts.size());
+		for (uint32_t i = 0; i < layouts.size(); i++)
+		{
+			if (i == BindlessDescriptorSet::SetIndex && m_Shader->UsesBindlessDescriptorSet())
+				m_DescriptorSets[i] = BindlessDescriptorSet::GetDescriptorSet();
+			else
+				m_DescriptorSets[i] = GetCachedDescriptorSet(layouts[i], writeDescriptors[i]);
+		}
 
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -79,6 +233,22 @@ namespace Charon {
 		VK_CHECK_RESULT(vkBeginCommandBuffer(m_ActiveCommandBuffer, &beginInfo));
 	}
 
+	void Renderer::FlushResourceFrees(size_t currentFrameMark)
+	{
+		uint32_t currentIndex = GetCurrentBufferIndex();
+		for (uint32_t i = 0; i < m_ResourceFreeQueue.size(); i++)
+		{
+			// Frees queued by this frame before the mark may be for resources its command buffer still uses
+			auto& resourceFreeQueue = m_ResourceFreeQueue[i];
+			size_t begin = i == currentIndex ? currentFrameMark : 0;
+
+			for (size_t j = begin; j < resourceFreeQueue.size(); j++)
+				resourceFreeQueue[j]();
+
+			resourceFreeQueue.erase(resourceFreeQueue.begin() + begin, resourceFreeQueue.end());
+		}
+	}
+
 	void Renderer::EndFrame()
 	{
 		VK_CHECK_RESULT(vkEndCommandBuffer(m_ActiveCommandBuffer));
@@ -86,8 +256,6 @@ namespace Charon {
 
 	void Renderer::BeginScene(Ref<Camera> camera)
 	{
-		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
-
 		m_ActiveCamera = camera;
 
 		m_CameraBuffer.ViewProjection = m_ActiveCamera->GetViewProjection();
@@ -96,6 +264,7 @@ namespace Charon {
 		m_CameraBuffer.InverseView = m_ActiveCamera->GetInverseViewMatrix();
 		m_CameraBuffer.InverseProjection = glm::inverse(m_ActiveCamera->GetProjectionMatrix());
 		m_CameraUniformBuffer->UpdateBuffer(&m_CameraBuffer);
+		m_CameraUniformBuffer->Upload();
 
 		if (false)
 		{
@@ -136,21 +305,6 @@ namespace Charon {
 		std::cout << "W: " << pos2D.w << std::endl;
 		std::cout << "X: " << pos2D2.x << ", Y: " << pos2D2.y << std::endl;
 #endif
-
-		UniformBufferDescription cameraBufferDescription = m_Shader->GetUniformBufferDescriptions()[0];
-
-		VkWriteDescriptorSet cameraBufferWriteDescriptor = {};
-		cameraBufferWriteDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		cameraBufferWriteDescriptor.descriptorCount = 1;
-		cameraBufferWriteDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		cameraBufferWriteDescriptor.dstSet = m_DescriptorSets[cameraBufferDescription.Index];
-		cameraBufferWriteDescriptor.dstBinding = cameraBufferDescription.BindingPoint;
-		cameraBufferWriteDescriptor.pBufferInfo = &m_CameraUniformBuffer->getDescriptorBufferInfo();
-		cameraBufferWriteDescriptor.pImageInfo = nullptr;
-
-		VkWriteDescriptorSet writeDescriptors[1] = { cameraBufferWriteDescriptor };
-
-		vkUpdateDescriptorSets(device, 1, writeDescriptors, 0, nullptr);
 	}
 
 	void Renderer::EndScene()
@@ -159,7 +313,7 @@ namespace Charon {
 		m_DrawList.clear();
 	}
 
-	void Renderer::BeginRenderPass(Ref<Framebuffer> framebuffer, bool explicitClear)
+	void Renderer::BeginRenderPass(Ref<Framebuffer> framebuffer, bool explicitClear, bool loadContents, VkSubpassContents contents)
 	{
 		VkRenderPass renderPass;
 		VkFramebuffer vulkanFramebuffer;
@@ -168,7 +322,7 @@ namespace Charon {
 		if (framebuffer)
 		{
 			vulkanFramebuffer = framebuffer->GetFramebuffer();
-			renderPass = framebuffer->GetRenderPass();
+			renderPass = loadContents ? framebuffer->GetLoadRenderPass() : framebuffer->GetRenderPass();
 			extent = { framebuffer->GetWidth(), framebuffer->GetHeight() };
 		}
 		else
@@ -193,7 +347,7 @@ namespace Charon {
 		renderPassInfo.clearValueCount = framebuffer ? 2 : 1;
 		renderPassInfo.pClearValues = clearColor;
 
-		VkViewport viewport{};
+		VkViewport& viewport = m_ActiveRenderPass.Viewport;
 		viewport.x = 0.0f;
 		viewport.y = 0.0f;
 		viewport.width = (float)extent.width;
@@ -208,84 +362,470 @@ namespace Charon {
 
 		vkCmdSetViewport(m_ActiveCommandBuffer, 0, 1, &viewport);
 
-		VkRect2D scissor;
+		VkRect2D& scissor = m_ActiveRenderPass.Scissor;
 		scissor.offset = renderPassInfo.renderArea.offset;
 		scissor.extent = renderPassInfo.renderArea.extent;
 
 		vkCmdSetScissor(m_ActiveCommandBuffer, 0, 1, &scissor);
-		vkCmdBeginRenderPass(m_ActiveCommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(m_ActiveCommandBuffer, &renderPassInfo, contents);
+
+		m_ActiveRenderPass.RenderPass = renderPass;
+		m_ActiveRenderPass.Framebuffer = vulkanFramebuffer;
+		m_ActiveRenderPass.Contents = contents;
 
 		if (explicitClear)
 		{
-			const uint32_t colorAttachmentCount = (uint32_t)framebuffer->GetColorAttachmentCount();
-			const uint32_t totalAttachmentCount = colorAttachmentCount + (framebuffer->HasDepthAttachment() ? 1 : 0);
-
-			VkClearValue clearValues;
-			glm::vec4 clearColor = framebuffer->GetSpecification().ClearColor;
-			clearValues.color = { clearColor.r, clearColor.g, clearColor.b, clearColor.a };
-
-			std::vector<VkClearAttachment> attachments(totalAttachmentCount);
-			std::vector<VkClearRect> clearRects(totalAttachmentCount);
-			for (uint32_t i = 0; i < colorAttachmentCount; i++)
+			// Secondary command buffer render passes can't record commands inline
+			if (contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
 			{
-				attachments[i].aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-				attachments[i].colorAttachment = i;
-				attachments[i].clearValue = clearValues;
-
-				clearRects[i].rect.offset = { (int32_t)0, (int32_t)0 };
-				clearRects[i].rect.extent = { extent.width, extent.height };
-				clearRects[i].baseArrayLayer = 0;
-				clearRects[i].layerCount = 1;
-			}
+				VkCommandBuffer commandBuffer = BeginSecondaryCommandBuffer(0);
+				ClearAttachments(commandBuffer, framebuffer, extent);
+				VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
-			if (framebuffer->HasDepthAttachment())
+				vkCmdExecuteCommands(m_ActiveCommandBuffer, 1, &commandBuffer);
+			}
+			else
 			{
-				clearValues.depthStencil = { 1.0f, 0 };
-
-				attachments[colorAttachmentCount].aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
-				attachments[colorAttachmentCount].clearValue = clearValues;
-				clearRects[colorAttachmentCount].rect.offset = { (int32_t)0, (int32_t)0 };
-				clearRects[colorAttachmentCount].rect.extent = { extent.width,  extent.height };
-				clearRects[colorAttachmentCount].baseArrayLayer = 0;
-				clearRects[colorAttachmentCount].layerCount = 1;
+				ClearAttachments(m_ActiveCommandBuffer, framebuffer, extent);
 			}
-
-			vkCmdClearAttachments(m_ActiveCommandBuffer, totalAttachmentCount, attachments.data(), totalAttachmentCount, clearRects.data());
 		}
 	}
 
 	void Renderer::EndRenderPass()
 	{
 		vkCmdEndRenderPass(m_ActiveCommandBuffer);
+		m_ActiveRenderPass = {};
+	}
+
+	void Renderer::ClearAttachments(VkCommandBuffer commandBuffer, Ref<Framebuffer> framebuffer, VkExtent2D extent)
+	{
+		const uint32_t colorAttachmentCount = (uint32_t)framebuffer->GetColorAttachmentCount();
+		const uint32_t totalAttachmentCount = colorAttachmentCount + (framebuffer->HasDepthAttachment() ? 1 : 0);
+
+		VkClearValue clearValues;
+		glm::vec4 clearColor = framebuffer->GetSpecification().ClearColor;
+		clearValues.color = { clearColor.r, clearColor.g, clearColor.b, clearColor.a };
+
+		std::vector<VkClearAttachment> attachments(totalAttachmentCount);
+		std::vector<VkClearRect> clearRects(totalAttachmentCount);
+		for (uint32_t i = 0; i < colorAttachmentCount; i++)
+		{
+			attachments[i].aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			attachments[i].colorAttachment = i;
+			attachments[i].clearValue = clearValues;
+
+			clearRects[i].rect.offset = { (int32_t)0, (int32_t)0 };
+			clearRects[i].rect.extent = { extent.width, extent.height };
+			clearRects[i].baseArrayLayer = 0;
+			clearRects[i].layerCount = 1;
+		}
+
+		if (framebuffer->HasDepthAttachment())
+		{
+			clearValues.depthStencil = { 1.0f, 0 };
+
+			attachments[colorAttachmentCount].aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+			attachments[colorAttachmentCount].clearValue = clearValues;
+			clearRects[colorAttachmentCount].rect.offset = { (int32_t)0, (int32_t)0 };
+			clearRects[colorAttachmentCount].rect.extent = { extent.width,  extent.height };
+			clearRects[colorAttachmentCount].baseArrayLayer = 0;
+			clearRects[colorAttachmentCount].layerCount = 1;
+		}
+
+		vkCmdClearAttachments(commandBuffer, totalAttachmentCount, attachments.data(), totalAttachmentCount, clearRects.data());
 	}
 
 	void Renderer::SubmitMesh(Ref<Mesh> mesh, const glm::mat4& transform)
 	{
+		SubmitMeshInstanced(mesh, &transform, 1);
+	}
+
+	void Renderer::SubmitMeshInstanced(Ref<Mesh> mesh, const glm::mat4* transforms, uint32_t instanceCount)
+	{
+		mesh->MarkTexturesUsed();
+
 		for (const SubMesh& subMesh : mesh->GetSubMeshes())
+			SubmitSubMeshInstanced(mesh, subMesh, transforms, instanceCount);
+	}
+
+	void Renderer::SubmitSubMeshInstanced(Ref<Mesh> mesh, const SubMesh& subMesh, const glm::mat4* transforms, uint32_t instanceCount)
+	{
+		glm::vec3 cameraPosition = m_ActiveCamera ? glm::vec3(m_CameraBuffer.InverseView[3]) : glm::vec3(0.0f);
+
+		uint32_t remaining = s_MaxInstancesPerFrame - (uint32_t)m_InstanceTransforms.size();
+		if (instanceCount > remaining)
 		{
-			m_DrawList.push_back({ subMesh, mesh->GetVertexBuffer(), mesh->GetIndexBuffer(), transform * subMesh.Transform });
+			CR_LOG_WARN("Instance buffer full; dropping {0} instances", instanceCount - remaining);
+			instanceCount = remaining;
 		}
+
+		if (instanceCount == 0)
+			return;
+
+		DrawCommand& command = m_DrawList.emplace_back();
+		command.SubMesh = subMesh;
+		command.Pipeline = m_Pipeline.get();
+		command.InstanceOffset = (uint32_t)m_InstanceTransforms.size();
+		command.InstanceCount = instanceCount;
+
+		// Sort batches by their closest instance
+		float depth = std::numeric_limits<float>::max();
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			const glm::mat4& transform = m_InstanceTransforms.emplace_back(transforms[i] * subMesh.Transform);
+			depth = glm::min(depth, glm::distance(cameraPosition, glm::vec3(transform[3])));
+		}
+
+		// SubMesh::MaterialIndex is local to its mesh, the material ID is not. Primitives without a material sort first
+		const auto& materials = mesh->GetMaterials();
+		uint32_t materialID = subMesh.MaterialIndex < materials.size() ? materials[subMesh.MaterialIndex]->GetID() + 1 : 0;
+		command.SortKey = Utils::CreateSortKey(command.Pipeline->GetID(), materialID, depth);
 	}
 
 	void Renderer::Render()
+	{
+		if (m_DrawList.empty())
+			return;
+
+		// Sort by state then front to back
+		m_SortedDrawList.resize(m_DrawList.size());
+		for (uint32_t i = 0; i < m_DrawList.size(); i++)
+			m_SortedDrawList[i] = { m_DrawList[i].SortKey, i };
+
+		Utils::RadixSort(m_SortedDrawList, m_SortScratch);
+
+		UploadInstances();
+
+		// Resolved once before recording on worker threads
+		m_CameraBufferOffset = m_CameraUniformBuffer->GetDynamicOffset();
+
+		if (m_ActiveRenderPass.Contents == VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS)
+		{
+			Ref<ThreadPool> threadPool = Application::GetApp().GetThreadPool();
+
+			// Record contiguous ranges of the sorted list on worker threads, chunks map to slots in order
+			m_RecordedCommandBuffers.assign(threadPool->GetSlotCount(), nullptr);
+			threadPool->ParallelFor((uint32_t)m_SortedDrawList.size(), s_MinDrawsPerCommandBuffer, [this](uint32_t begin, uint32_t end, uint32_t slot)
+			{
+				VkCommandBuffer commandBuffer = BeginSecondaryCommandBuffer(slot);
+				RecordDraws(commandBuffer, begin, end);
+				VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+				m_RecordedCommandBuffers[slot] = commandBuffer;
+			});
+
+			uint32_t recordedCount = (uint32_t)(std::find(m_RecordedCommandBuffers.begin(), m_RecordedCommandBuffers.end(), nullptr) - m_RecordedCommandBuffers.begin());
+			vkCmdExecuteCommands(m_ActiveCommandBuffer, recordedCount, m_RecordedCommandBuffers.data());
+		}
+		else
+		{
+			RecordDraws(m_ActiveCommandBuffer, 0, (uint32_t)m_SortedDrawList.size());
+		}
+
+		m_DrawList.clear();
+	}
+
+	void Renderer::RecordDraws(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)
+	{
+		// All meshes live in the shared geometry pool
+		GeometryPool::Bind(commandBuffer);
+
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		VkPipelineLayout boundLayout = VK_NULL_HANDLE;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const DrawCommand& command = m_DrawList[m_SortedDrawList[i].second];
+
+			// Only rebind state when it changes, pipeline layouts are interned so sets stay bound across pipelines sharing one
+			if (boundPipeline != command.Pipeline->GetPipeline())
+			{
+				boundPipeline = command.Pipeline->GetPipeline();
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipeline);
+			}
+
+			if (boundLayout != command.Pipeline->GetPipelineLayout())
+			{
+				boundLayout = command.Pipeline->GetPipelineLayout();
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundLayout, 0, m_DescriptorSets.size(), m_DescriptorSets.data(), 1, &m_CameraBufferOffset);
+			}
+
+			vkCmdDrawIndexed(commandBuffer, command.SubMesh.IndexCount, command.InstanceCount, command.SubMesh.IndexOffset, command.SubMesh.VertexOffset, command.InstanceOffset);
+		}
+	}
+
+	VkCommandBuffer Renderer::BeginSecondaryCommandBuffer(uint32_t slot)
+	{
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+		SecondaryCommandPool& commandPool = m_SecondaryCommandPools[GetCurrentBufferIndex()][slot];
+
+		// Command buffers are reused once the pool is reset in BeginFrame
+		if (commandPool.UsedCount == commandPool.CommandBuffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = commandPool.Pool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &commandPool.CommandBuffers.emplace_back()));
+		}
+
+		VkCommandBuffer commandBuffer = commandPool.CommandBuffers[commandPool.UsedCount++];
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = m_ActiveRenderPass.RenderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = m_ActiveRenderPass.Framebuffer;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+		// Dynamic state isn't inherited from the primary command buffer
+		vkCmdSetViewport(commandBuffer, 0, 1, &m_ActiveRenderPass.Viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &m_ActiveRenderPass.Scissor);
+
+		return commandBuffer;
+	}
+
+	void Renderer::CullDrawList(bool occlusionCulling)
 	{
 		Ref<SwapChain> swapChain = Application::GetApp().GetVulkanSwapChain();
+		uint32_t frameIndex = swapChain->GetCurrentBufferIndex();
 
-		vkCmdBindPipeline(m_ActiveCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->GetPipeline());
+		CR_ASSERT(m_ActiveCamera, "CullDrawList requires an active scene");
+		CR_ASSERT(m_CulledDrawCount == 0, "Only one GPU-driven pass is supported per frame");
+
+		UploadInstances();
+
+		// One record per batch, the culling shader tests its instances and emits a single instanced draw for it
+		m_GPUDrawScratch.clear();
 		for (const DrawCommand& command : m_DrawList)
 		{
-			VkDeviceSize offset = 0;
-			VkBuffer vertexBuffer = command.VertexBuffer->GetBuffer();
-			vkCmdBindVertexBuffers(m_ActiveCommandBuffer, 0, 1, &vertexBuffer, &offset);
-			vkCmdBindIndexBuffer(m_ActiveCommandBuffer, command.IndexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
+			GPUDrawCommand& drawCommand = m_GPUDrawScratch.emplace_back();
+			drawCommand = {};
+			drawCommand.BoundsMin = glm::vec4(command.SubMesh.BoundingBox.Min, 0.0f);
+			drawCommand.BoundsMax = glm::vec4(command.SubMesh.BoundingBox.Max, 0.0f);
+			drawCommand.IndexCount = command.SubMesh.IndexCount;
+			drawCommand.FirstIndex = command.SubMesh.IndexOffset;
+			drawCommand.VertexOffset = (int32_t)command.SubMesh.VertexOffset;
+			drawCommand.InstanceOffset = command.InstanceOffset;
+			drawCommand.InstanceCount = command.InstanceCount;
+		}
 
-			vkCmdPushConstants(m_ActiveCommandBuffer, m_Pipeline->GetPipelineLayout(), VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &command.Transform);
-			vkCmdBindDescriptorSets(m_ActiveCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->GetPipelineLayout(), 0, m_DescriptorSets.size(), m_DescriptorSets.data(), 0, nullptr);
+		// Records stay on the GPU while the batches don't change, only the transforms are uploaded every frame
+		if (m_GPUDrawScratch.size() != m_GPUDrawList.size() || memcmp(m_GPUDrawScratch.data(), m_GPUDrawList.data(), sizeof(GPUDrawCommand) * m_GPUDrawList.size()) != 0)
+		{
+			m_GPUDrawList.swap(m_GPUDrawScratch);
+			m_GPUDrawListVersion++;
+		}
 
-			vkCmdDrawIndexed(m_ActiveCommandBuffer, command.SubMesh.IndexCount, 1, command.SubMesh.IndexOffset, command.SubMesh.VertexOffset, 0);
+		m_CulledDrawCount = (uint32_t)m_GPUDrawList.size();
+		if (m_CulledDrawCount == 0)
+			return;
+
+		if (m_GPUDrawBufferVersions[frameIndex] != m_GPUDrawListVersion)
+		{
+			GPUDrawCommand* drawData = m_GPUDrawBuffers[frameIndex]->Map<GPUDrawCommand>();
+			memcpy(drawData, m_GPUDrawList.data(), sizeof(GPUDrawCommand) * m_GPUDrawList.size());
+			m_GPUDrawBuffers[frameIndex]->Unmap();
+
+			m_GPUDrawBufferVersions[frameIndex] = m_GPUDrawListVersion;
 		}
 
-		m_DrawList.clear();
+		// Culling descriptors, pushed by both phases
+		m_CullDescriptors[0] = m_GPUDrawBuffers[frameIndex]->getDescriptorBufferInfo();
+		m_CullDescriptors[1] = m_InstanceBuffers[frameIndex]->getDescriptorBufferInfo();
+		m_CullDescriptors[2] = m_IndirectBuffers[frameIndex]->getDescriptorBufferInfo();
+		m_CullDescriptors[3] = m_DrawCountBuffers[frameIndex]->getDescriptorBufferInfo();
+		m_CullDescriptors[4] = m_DrawVisibilityBuffers[frameIndex]->getDescriptorBufferInfo();
+		m_CullDescriptors[5] = m_DepthPyramid->GetDescriptorImageInfo();
+
+		// Reset draw counts of both phases, recorded in the same pass as the dispatch so it is synchronized here
+		vkCmdFillBuffer(m_ActiveCommandBuffer, m_DrawCountBuffers[frameIndex]->GetBuffer(), 0, sizeof(uint32_t) * 2, 0);
+
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(m_ActiveCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		// The pyramid is only usable if it was built from last frame's depth
+		bool pyramidValid = m_DepthPyramidFrame != 0 && m_DepthPyramidFrame + 1 == m_FrameCounter;
+		DispatchCulling(0, occlusionCulling && pyramidValid);
+	}
+
+	void Renderer::BuildDepthPyramid()
+	{
+		Ref<Image> depthImage = m_Framebuffer->GetDepthImage();
+		CR_ASSERT(depthImage, "Depth pyramid requires a depth attachment");
+
+		vkCmdBindPipeline(m_ActiveCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_DepthPyramidPipeline->GetPipeline());
+
+		const ImageSpecification& pyramidSpecification = m_DepthPyramid->GetSpecification();
+		uint32_t sourceWidth = m_Framebuffer->GetWidth();
+		uint32_t sourceHeight = m_Framebuffer->GetHeight();
+
+		for (uint32_t mip = 0; mip < pyramidSpecification.MipLevels; mip++)
+		{
+			uint32_t width = glm::max(pyramidSpecification.Width >> mip, 1u);
+			uint32_t height = glm::max(pyramidSpecification.Height >> mip, 1u);
+
+			std::array<DescriptorInfo, 2> descriptors;
+			descriptors[0] = mip == 0 ? depthImage->GetDescriptorImageInfo() : m_DepthPyramid->GetMipDescriptorImageInfo(mip - 1);
+			descriptors[1] = m_DepthPyramid->GetMipDescriptorImageInfo(mip);
+
+			glm::uvec4 pyramidData = { sourceWidth, sourceHeight, width, height };
+
+			m_DepthPyramidPipeline->PushDescriptorSet(m_ActiveCommandBuffer, descriptors.data());
+			vkCmdPushConstants(m_ActiveCommandBuffer, m_DepthPyramidPipeline->GetPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(glm::uvec4), &pyramidData);
+			vkCmdDispatch(m_ActiveCommandBuffer, (width + 7) / 8, (height + 7) / 8, 1);
+
+			// Next mip reads this one, readers of the last mip are ordered by the render graph
+			if (mip + 1 < pyramidSpecification.MipLevels)
+			{
+				VkMemoryBarrier barrier = {};
+				barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+				barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				vkCmdPipelineBarrier(m_ActiveCommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			}
+
+			sourceWidth = width;
+			sourceHeight = height;
+		}
+
+		m_DepthPyramidViewProjection = m_CameraBuffer.ViewProjection;
+		m_DepthPyramidFrame = m_FrameCounter;
+	}
+
+	void Renderer::CullOccludedDrawList()
+	{
+		CR_ASSERT(m_DepthPyramidFrame == m_FrameCounter, "CullOccludedDrawList requires a depth pyramid built this frame");
+
+		if (m_CulledDrawCount == 0)
+			return;
+
+		DispatchCulling(1, true);
+	}
+
+	void Renderer::DispatchCulling(uint32_t phase, bool occlusionCulling)
+	{
+		// Must match FrustumCull.shader
+		struct CullData
+		{
+			glm::mat4 ViewProjection;
+			glm::vec4 FrustumPlanes[6];
+			glm::vec2 DepthPyramidSize;
+			uint32_t DepthPyramidMipCount;
+			uint32_t DrawCount;
+			uint32_t MaxInstanceCount;
+			uint32_t Phase;
+			uint32_t OcclusionCulling;
+		} cullData;
+
+		Frustum frustum = m_ActiveCamera->GetFrustum();
+		memcpy(cullData.FrustumPlanes, frustum.Planes, sizeof(cullData.FrustumPlanes));
+		cullData.ViewProjection = m_DepthPyramidViewProjection;
+		cullData.DepthPyramidSize = glm::vec2((float)m_DepthPyramid->GetSpecification().Width, (float)m_DepthPyramid->GetSpecification().Height);
+		cullData.DepthPyramidMipCount = m_DepthPyramid->GetSpecification().MipLevels;
+		cullData.DrawCount = m_CulledDrawCount;
+		cullData.MaxInstanceCount = s_MaxInstancesPerFrame;
+		cullData.Phase = phase;
+		cullData.OcclusionCulling = occlusionCulling ? 1 : 0;
+
+		// Cull and compact
+		vkCmdBindPipeline(m_ActiveCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_CullPipeline->GetPipeline());
+		m_CullPipeline->PushDescriptorSet(m_ActiveCommandBuffer, m_CullDescriptors.data());
+		vkCmdPushConstants(m_ActiveCommandBuffer, m_CullPipeline->GetPipelineLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullData), &cullData);
+
+		// One workgroup per batch, 65535 is the smallest maxComputeWorkGroupCount allowed
+		uint32_t groupCountX = glm::min(m_CulledDrawCount, 65535u);
+		uint32_t groupCountY = (m_CulledDrawCount + groupCountX - 1) / groupCountX;
+		vkCmdDispatch(m_ActiveCommandBuffer, groupCountX, groupCountY, 1);
+
+		m_IndirectPhase = phase;
+	}
+
+	void Renderer::RenderIndirect()
+	{
+		Ref<SwapChain> swapChain = Application::GetApp().GetVulkanSwapChain();
+		uint32_t frameIndex = swapChain->GetCurrentBufferIndex();
+
+		if (m_CulledDrawCount == 0)
+			return;
+
+		uint32_t cameraBufferOffset = m_CameraUniformBuffer->GetDynamicOffset();
+
+		vkCmdBindPipeline(m_ActiveCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->GetPipeline());
+		vkCmdBindDescriptorSets(m_ActiveCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipeline->GetPipelineLayout(), 0, m_DescriptorSets.size(), m_DescriptorSets.data(), 1, &cameraBufferOffset);
+		GeometryPool::Bind(m_ActiveCommandBuffer);
+
+		// Draw the commands written by the last culling phase
+		VkDeviceSize commandOffset = (VkDeviceSize)m_IndirectPhase * s_MaxInstancesPerFrame * sizeof(VkDrawIndexedIndirectCommand);
+		VkDeviceSize countOffset = (VkDeviceSize)m_IndirectPhase * sizeof(uint32_t);
+
+		vkCmdDrawIndexedIndirectCount(m_ActiveCommandBuffer,
+			m_IndirectBuffers[frameIndex]->GetBuffer(), commandOffset,
+			m_DrawCountBuffers[frameIndex]->GetBuffer(), countOffset,
+			m_CulledDrawCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+
+	Ref<StorageBuffer> Renderer::GetIndirectBuffer() const
+	{
+		return m_IndirectBuffers[GetCurrentBufferIndex()];
+	}
+
+	Ref<StorageBuffer> Renderer::GetDrawCountBuffer() const
+	{
+		return m_DrawCountBuffers[GetCurrentBufferIndex()];
+	}
+
+	Ref<StorageBuffer> Renderer::GetDrawVisibilityBuffer() const
+	{
+		return m_DrawVisibilityBuffers[GetCurrentBufferIndex()];
+	}
+
+	Ref<StorageBuffer> Renderer::GetInstanceBuffer() const
+	{
+		return m_InstanceBuffers[GetCurrentBufferIndex()];
+	}
+
+	void Renderer::CreateDepthPyramid(uint32_t width, uint32_t height)
+	{
+		// Power of two sizes so every mip halves exactly
+		ImageSpecification specification;
+		specification.Width = Utils::PreviousPowerOfTwo(width);
+		specification.Height = Utils::PreviousPowerOfTwo(height);
+		specification.MipLevels = Image::CalculateMipCount(specification.Width, specification.Height);
+		specification.Format = VK_FORMAT_R32_SFLOAT;
+		specification.Usage = VK_IMAGE_USAGE_STORAGE_BIT;
+		specification.UseStagingBuffer = false;
+		specification.DebugName = "DepthPyramid";
+		m_DepthPyramid = CreateRef<Image>(specification);
+
+		m_DepthPyramidFrame = 0;
+	}
+
+	void Renderer::UploadInstances()
+	{
+		Ref<SwapChain> swapChain = Application::GetApp().GetVulkanSwapChain();
+
+		// Upload instances submitted since the last upload this frame
+		uint32_t instanceCount = (uint32_t)m_InstanceTransforms.size() - m_UploadedInstanceCount;
+		if (instanceCount == 0)
+			return;
+
+		Ref<StorageBuffer> instanceBuffer = m_InstanceBuffers[swapChain->GetCurrentBufferIndex()];
+		glm::mat4* instanceData = instanceBuffer->Map<glm::mat4>();
+		memcpy(instanceData + m_UploadedInstanceCount, m_InstanceTransforms.data() + m_UploadedInstanceCount, sizeof(glm::mat4) * instanceCount);
+		instanceBuffer->Unmap();
+
+		m_UploadedInstanceCount += instanceCount;
 	}
 
 	void Renderer::RenderUI()
@@ -305,6 +845,9 @@ namespace Charon {
 		spec.Width = width;
 		spec.Height = height;
 		m_Framebuffer = CreateRef<Framebuffer>(spec);
+
+		// The pyramid is invalid until rebuilt from the resized depth
+		CreateDepthPyramid(width, height);
 		return true;
 	}
 
@@ -312,56 +855,27 @@ namespace Charon {
 	{
 	}
 
-	void Renderer::CreateDescriptorPools()
+	void Renderer::CreateSecondaryCommandPools()
 	{
 		Ref<SwapChain> swapChain = Application::GetApp().GetVulkanSwapChain();
-		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+		Ref<VulkanDevice> device = Application::GetApp().GetVulkanDevice();
+		uint32_t slotCount = Application::GetApp().GetThreadPool()->GetSlotCount();
 
-		// Create descriptor pool for each frame in flight
-		m_DescriptorPools.resize(swapChain->GetFramesInFlight());
+		// Command pools can only be used from one thread at a time, so each thread pool slot gets its own per frame in flight
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.queueFamilyIndex = device->GetQueueIndices().GraphicsQueue.value();
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
-		// Define max number of each descriptor for each descriptor set
-		VkDescriptorPoolSize poolSizes[] =
-		{
-			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 10 },
-			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10 },
-			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10 }
-		};
-
-		// Create descriptor pool
-		VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {};
-		descriptorPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		descriptorPoolCreateInfo.flags = 0;
-		descriptorPoolCreateInfo.maxSets = 1000;
-		descriptorPoolCreateInfo.poolSizeCount = 3;
-		descriptorPoolCreateInfo.pPoolSizes = poolSizes;
-
-		for (auto& descriptorPool : m_DescriptorPools)
+		m_SecondaryCommandPools.resize(swapChain->GetFramesInFlight());
+		for (auto& framePools : m_SecondaryCommandPools)
 		{
-			VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool));
+			framePools.resize(slotCount);
+			for (SecondaryCommandPool& commandPool : framePools)
+				VK_CHECK_RESULT(vkCreateCommandPool(device->GetLogicalDevice(), &poolInfo, nullptr, &commandPool.Pool));
 		}
 	}
 
-	std::vector<VkDescriptorSet> Renderer::AllocateDescriptorSets(const std::vector<VkDescriptorSetLayout>& layouts)
-	{
-		Ref<SwapChain> swapChain = Application::GetApp().GetVulkanSwapChain();
-		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
-		uint32_t frameIndex = swapChain->GetCurrentBufferIndex();
-
-		// Allocate descriptor sets from descriptor pool for current frame given the layout info
-		VkDescriptorSetAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorSetCount = layouts.size();
-		allocInfo.pSetLayouts = layouts.data();
-		allocInfo.descriptorPool = m_DescriptorPools[frameIndex];
-
-		std::vector<VkDescriptorSet> result;
-		result.resize(layouts.size());
-
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, result.data()));
-		return result;
-	}
-
 	uint32_t Renderer::GetCurrentBufferIndex() const
 	{
 		return Application::GetApp().GetVulkanSwapChain()->GetCurrentBufferIndex();
@@ -369,33 +883,33 @@ namespace Charon {
 
 	VkDescriptorSet Renderer::AllocateDescriptorSet(VkDescriptorSetAllocateInfo allocInfo)
 	{
-		Ref<SwapChain> swapChain = Application::GetApp().GetVulkanSwapChain();
-		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
-		uint32_t frameIndex = swapChain->GetCurrentBufferIndex();
-
-		allocInfo.descriptorPool = s_Instance->m_DescriptorPools[frameIndex];
+		CR_ASSERT(allocInfo.descriptorSetCount == 1, "AllocateDescriptorSet only allocates a single set");
 
-		VkDescriptorSet result;
-		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &result));
-		return result;
+		uint32_t frameIndex = s_Instance->GetCurrentBufferIndex();
+		return s_Instance->m_DescriptorAllocators[frameIndex]->Allocate(allocInfo.pSetLayouts[0], allocInfo.pNext);
 	}
 
 	VkDescriptorSet Renderer::AllocateDescriptorSet(VkDescriptorSetLayout descLayout)
 	{
-		Ref<SwapChain> swapChain = Application::GetApp().GetVulkanSwapChain();
-		uint32_t frameIndex = swapChain->GetCurrentBufferIndex();
-		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+		uint32_t frameIndex = s_Instance->GetCurrentBufferIndex();
+		return s_Instance->m_DescriptorAllocators[frameIndex]->Allocate(descLayout);
+	}
 
-		VkDescriptorSetAllocateInfo allocInfo;
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.pNext = NULL;
-		allocInfo.descriptorPool = s_Instance->m_DescriptorPools[frameIndex];
-		allocInfo.descriptorSetCount = 1;
-		allocInfo.pSetLayouts = &descLayout;
+	VkDescriptorSet Renderer::GetCachedDescriptorSet(VkDescriptorSetLayout descLayout, std::vector<VkWriteDescriptorSet>& writes)
+	{
+		return s_Instance->m_DescriptorSetCache->GetDescriptorSet(descLayout, writes);
+	}
 
-		VkDescriptorSet descriptorSet;
-		VkResult res = vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet);
-		return descriptorSet;
+	void Renderer::InvalidateCachedDescriptorSets(uint64_t handle)
+	{
+		if (s_Instance && s_Instance->m_DescriptorSetCache)
+			s_Instance->m_DescriptorSetCache->Invalidate(handle);
+	}
+
+	void Renderer::ForgetRenderGraphResource(uint64_t handle)
+	{
+		if (s_Instance && s_Instance->m_RenderGraph)
+			s_Instance->m_RenderGraph->ForgetResource(handle);
 	}
 
-}
\ No newline at end of file
+}
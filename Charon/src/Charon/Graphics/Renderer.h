@@ -2,9 +2,12 @@
 #include "Charon/Graphics/Camera.h"
 #include "Charon/Graphics/Framebuffer.h"
 #include "Charon/Graphics/VulkanPipeline.h"
+#include "Charon/Graphics/VulkanComputePipeline.h"
 #include "Charon/Graphics/Buffers.h"
 #include "Charon/Graphics/Shader.h"
 #include "Charon/Graphics/Mesh.h"
+#include "Charon/Graphics/DescriptorAllocator.h"
+#include "Charon/Graphics/RenderGraph.h"
 
 namespace Charon {
 
@@ -20,10 +23,27 @@ namespace Charon {
 	struct DrawCommand
 	{
 		SubMesh SubMesh;
-		Ref<VertexBuffer> VertexBuffer;
-		Ref<IndexBuffer> IndexBuffer;
+		VulkanPipeline* Pipeline = nullptr;
 
-		glm::mat4 Transform;
+		// Range of transforms in the per-frame instance buffer
+		uint32_t InstanceOffset = 0;
+		uint32_t InstanceCount = 0;
+
+		// Pipeline | Material | Depth, see Utils::CreateSortKey
+		uint64_t SortKey = 0;
+	};
+
+	// Per-batch draw read by the culling shader (FrustumCull.shader), padded to its std430 stride
+	struct GPUDrawCommand
+	{
+		glm::vec4 BoundsMin;
+		glm::vec4 BoundsMax;
+		uint32_t IndexCount;
+		uint32_t FirstIndex;
+		int32_t VertexOffset;
+		uint32_t InstanceOffset;
+		uint32_t InstanceCount;
+		uint32_t Padding[3];
 	};
 
 	class Renderer
@@ -39,11 +59,24 @@ namespace Charon {
 		void BeginScene(Ref<Camera> camera);
 		void EndScene();
 
-		void BeginRenderPass(Ref<Framebuffer> framebuffer = nullptr, bool explicitClear = false);
+		// With VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, Render records in parallel on the application thread pool
+		void BeginRenderPass(Ref<Framebuffer> framebuffer = nullptr, bool explicitClear = false, bool loadContents = false, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 		void EndRenderPass();
 
 		void SubmitMesh(Ref<Mesh> mesh, const glm::mat4& transform);
+		void SubmitMeshInstanced(Ref<Mesh> mesh, const glm::mat4* transforms, uint32_t instanceCount);
+		// Transforms are object transforms, SubMesh::Transform is applied on top
+		void SubmitSubMeshInstanced(Ref<Mesh> mesh, const SubMesh& subMesh, const glm::mat4* transforms, uint32_t instanceCount);
 		void Render();
+
+		// GPU-driven path: culling and BuildDepthPyramid must be recorded outside of a render pass, RenderIndirect inside it.
+		// CullDrawList tests against the previous frame's depth pyramid, CullOccludedDrawList re-tests what it rejected
+		// against the pyramid built from this frame's depth. RenderIndirect draws the result of the last cull.
+		// Barriers between these are left to the caller, see the resource getters below.
+		void CullDrawList(bool occlusionCulling = true);
+		void BuildDepthPyramid();
+		void CullOccludedDrawList();
+		void RenderIndirect();
 		void RenderUI();
 
 		bool SetViewportSize(uint32_t width, uint32_t height);
@@ -57,11 +90,28 @@ namespace Charon {
 		uint32_t GetCurrentBufferIndex() const;
 
 		Ref<Framebuffer> GetFramebuffer() { return m_Framebuffer; }
+		Ref<RenderGraph> GetRenderGraph() { return m_RenderGraph; }
+
+		// Resources written by culling this frame, for declaring render graph accesses
+		Ref<Image> GetDepthPyramid() { return m_DepthPyramid; }
+		Ref<StorageBuffer> GetIndirectBuffer() const;
+		Ref<StorageBuffer> GetDrawCountBuffer() const;
+		Ref<StorageBuffer> GetDrawVisibilityBuffer() const;
+		Ref<StorageBuffer> GetInstanceBuffer() const;
 
 		static VkDescriptorSet AllocateDescriptorSet(VkDescriptorSetAllocateInfo allocInfo);
 		static VkDescriptorSet AllocateDescriptorSet(VkDescriptorSetLayout descLayout);
 
+		// Returns a set that stays valid across frames, only use for writes that don't change every frame
+		static VkDescriptorSet GetCachedDescriptorSet(VkDescriptorSetLayout descLayout, std::vector<VkWriteDescriptorSet>& writes);
+		// Call before destroying a buffer, image view, sampler or acceleration structure
+		static void InvalidateCachedDescriptorSets(uint64_t handle);
+		// Call before destroying an image or buffer the render graph may have seen
+		static void ForgetRenderGraphResource(uint64_t handle);
+		Ref<DescriptorSetCache> GetDescriptorSetCache() { return m_DescriptorSetCache; }
+
 		Ref<UniformBuffer> GetCameraUB() { return m_CameraUniformBuffer; }
+		uint64_t GetFrameCounter() const { return m_FrameCounter; }
 
 		template<typename Fn>
 		void SubmitResourceFree(Fn&& function)
@@ -69,10 +119,22 @@ namespace Charon {
 			uint32_t index = GetCurrentBufferIndex();
 			m_ResourceFreeQueue[index].emplace_back(function);
 		}
+
+		// Position in the frees queued by the frame being recorded, see FlushResourceFrees
+		size_t GetResourceFreeMark() const { return m_ResourceFreeQueue[GetCurrentBufferIndex()].size(); }
+
+		// Runs the frees queued by completed frames, and the ones queued by this frame since currentFrameMark. The GPU must be
+		// idle and nothing recorded this frame may use the resources freed since the mark.
+		void FlushResourceFrees(size_t currentFrameMark);
 	private:
 		void Init();
-		void CreateDescriptorPools();
-		std::vector<VkDescriptorSet> AllocateDescriptorSets(const std::vector<VkDescriptorSetLayout>& layouts);
+		void UploadInstances();
+		void RecordDraws(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end);
+		void ClearAttachments(VkCommandBuffer commandBuffer, Ref<Framebuffer> framebuffer, VkExtent2D extent);
+		VkCommandBuffer BeginSecondaryCommandBuffer(uint32_t slot);
+		void CreateSecondaryCommandPools();
+		void CreateDepthPyramid(uint32_t width, uint32_t height);
+		void DispatchCulling(uint32_t phase, bool occlusionCulling);
 
 	private:
 		Ref<Camera> m_ActiveCamera;
@@ -81,14 +143,68 @@ namespace Charon {
 
 		CameraBuffer m_CameraBuffer;
 		std::vector<DrawCommand> m_DrawList;
+		std::vector<std::pair<uint64_t, uint32_t>> m_SortedDrawList;
+		std::vector<std::pair<uint64_t, uint32_t>> m_SortScratch;
 		Ref<UniformBuffer> m_CameraUniformBuffer;
+		uint32_t m_CameraBufferOffset = 0;
+
+		static const uint32_t s_MaxInstancesPerFrame = 64 * 1024;
+		std::vector<Ref<StorageBuffer>> m_InstanceBuffers;
+		std::vector<glm::mat4> m_InstanceTransforms;
+		uint32_t m_UploadedInstanceCount = 0;
+
+		// GPU-driven rendering
+		Ref<Shader> m_CullShader;
+		Ref<VulkanComputePipeline> m_CullPipeline;
+		std::vector<Ref<StorageBuffer>> m_GPUDrawBuffers;
+		std::vector<Ref<StorageBuffer>> m_IndirectBuffers;
+		std::vector<Ref<StorageBuffer>> m_DrawCountBuffers;
+		std::vector<Ref<StorageBuffer>> m_DrawVisibilityBuffers;
+		std::vector<GPUDrawCommand> m_GPUDrawList, m_GPUDrawScratch;
+		uint64_t m_GPUDrawListVersion = 1;
+		std::vector<uint64_t> m_GPUDrawBufferVersions; // Version of m_GPUDrawList each frame's buffer holds
+		std::array<DescriptorInfo, 6> m_CullDescriptors;
+		uint32_t m_CulledDrawCount = 0; // Batches, each becomes at most one instanced indirect draw
+		uint32_t m_IndirectPhase = 0;
+
+		// Hierarchical-Z occlusion culling
+		Ref<Shader> m_DepthPyramidShader;
+		Ref<VulkanComputePipeline> m_DepthPyramidPipeline;
+		Ref<Image> m_DepthPyramid;
+		glm::mat4 m_DepthPyramidViewProjection = glm::mat4(1.0f);
+		uint64_t m_DepthPyramidFrame = 0; // Frame the pyramid was last built in, 0 if never
+		uint64_t m_FrameCounter = 0;
 		Ref<Framebuffer> m_Framebuffer;
+		Ref<RenderGraph> m_RenderGraph;
 		Ref<Shader> m_Shader;
 
 		Ref<VulkanPipeline> m_Pipeline;
 		VkCommandBuffer m_ActiveCommandBuffer = nullptr;
 		std::vector<VkDescriptorSet> m_DescriptorSets;
-		std::vector<VkDescriptorPool> m_DescriptorPools;
+		std::vector<Ref<DescriptorAllocator>> m_DescriptorAllocators;
+		Ref<DescriptorSetCache> m_DescriptorSetCache;
+
+		// Parallel recording
+		struct ActiveRenderPass
+		{
+			VkRenderPass RenderPass = nullptr;
+			VkFramebuffer Framebuffer = nullptr;
+			VkSubpassContents Contents = VK_SUBPASS_CONTENTS_INLINE;
+			VkViewport Viewport = {};
+			VkRect2D Scissor = {};
+		};
+
+		struct SecondaryCommandPool
+		{
+			VkCommandPool Pool = nullptr;
+			std::vector<VkCommandBuffer> CommandBuffers;
+			uint32_t UsedCount = 0;
+		};
+
+		static const uint32_t s_MinDrawsPerCommandBuffer = 128;
+		ActiveRenderPass m_ActiveRenderPass;
+		std::vector<std::vector<SecondaryCommandPool>> m_SecondaryCommandPools; // [frame in flight][thread pool slot]
+		std::vector<VkCommandBuffer> m_RecordedCommandBuffers;
 
 		std::vector<std::vector<std::function<void()>>> m_ResourceFreeQueue;
 	};
@@ -0,0 +1,280 @@
+#include "pch.h"
+#include "ResidencyManager.h"
+#include "Charon/Core/Application.h"
+#include "Charon/Graphics/VulkanAllocator.h"
+#include <mutex>
+#include <atomic>
+#include <thread>
+
+namespace Charon {
+
+	struct ResidentResource
+	{
+		uint64_t Size = 0;
+		uint64_t FullSize = 0;
+		uint64_t LastUsedFrame = 0;
+		bool Evicted = false;
+		bool Registered = false;
+
+		ResidencyManager::EvictFunction Evict;
+		ResidencyManager::RestoreFunction Restore;
+	};
+
+	struct ResidencyManagerData
+	{
+		std::vector<ResidentResource> Resources;
+		std::vector<ResidencyHandle> FreeHandles;
+
+		uint64_t Frame = 0;
+		uint64_t NextEvictionFrame = 0;
+
+		// Evicting and freeing is only safe where frames are recorded
+		std::thread::id MainThread;
+		std::atomic<bool> MakingRoom{ false };
+		std::atomic<uint64_t> DeferredRoom{ 0 }; // Asked for by other threads, made at the start of the next frame
+
+		std::mutex Mutex;
+	};
+
+	static ResidencyManagerData* s_Data = nullptr;
+
+	// Resources have to go unused this long before they are evicted to stay under budget, well past the frames in flight
+	static const uint64_t s_MinUnusedFrames = 64;
+
+	// Evicting stops once usage is back under this fraction of the budget, so usage doesn't hover right at the limit
+	static const double s_TargetBudgetUsage = 0.9;
+
+	namespace Utils {
+
+		// Registered and not evicted resources last used before frame, least recently used first
+		static std::vector<ResidencyHandle> GetEvictionCandidates(uint64_t frame)
+		{
+			std::lock_guard<std::mutex> lock(s_Data->Mutex);
+
+			std::vector<ResidencyHandle> candidates;
+			for (ResidencyHandle handle = 0; handle < s_Data->Resources.size(); handle++)
+			{
+				const ResidentResource& resource = s_Data->Resources[handle];
+				if (resource.Registered && !resource.Evicted && resource.LastUsedFrame < frame)
+					candidates.push_back(handle);
+			}
+
+			std::sort(candidates.begin(), candidates.end(), [](ResidencyHandle a, ResidencyHandle b)
+			{
+				return s_Data->Resources[a].LastUsedFrame < s_Data->Resources[b].LastUsedFrame;
+			});
+
+			return candidates;
+		}
+
+		// Returns the bytes saved
+		static uint64_t EvictResource(ResidencyHandle handle)
+		{
+			ResidencyManager::EvictFunction evict;
+			{
+				std::lock_guard<std::mutex> lock(s_Data->Mutex);
+				evict = s_Data->Resources[handle].Evict;
+			}
+
+			// Outside the lock, evicting creates and releases resources
+			uint64_t size = evict();
+
+			std::lock_guard<std::mutex> lock(s_Data->Mutex);
+			ResidentResource& resource = s_Data->Resources[handle];
+			uint64_t saved = resource.Size > size ? resource.Size - size : 0;
+			resource.Size = size;
+			resource.Evicted = true;
+			return saved;
+		}
+
+	}
+
+	void ResidencyManager::Init()
+	{
+		s_Data = new ResidencyManagerData();
+		s_Data->MainThread = std::this_thread::get_id();
+	}
+
+	void ResidencyManager::Shutdown()
+	{
+		delete s_Data;
+		s_Data = nullptr;
+	}
+
+	void ResidencyManager::BeginFrame(uint64_t frame)
+	{
+		s_Data->Frame = frame;
+
+		// Memory of evicted resources is only freed once the frames in flight are done with it, until then usage still
+		// looks over budget
+		if (frame < s_Data->NextEvictionFrame)
+			return;
+
+		uint64_t excess = s_Data->DeferredRoom.exchange(0);
+		for (const HeapBudget& heap : VulkanAllocator::GetHeapBudgets())
+		{
+			if (heap.DeviceLocal && heap.Usage > heap.Budget)
+				excess = std::max(excess, heap.Usage - (uint64_t)(heap.Budget * s_TargetBudgetUsage));
+		}
+
+		if (excess == 0 || frame < s_MinUnusedFrames)
+			return;
+
+		uint64_t saved = 0;
+		uint32_t evictedCount = 0;
+		for (ResidencyHandle handle : Utils::GetEvictionCandidates(frame - s_MinUnusedFrames))
+		{
+			if (saved >= excess)
+				break;
+
+			saved += Utils::EvictResource(handle);
+			evictedCount++;
+		}
+
+		if (evictedCount > 0)
+		{
+			uint32_t framesInFlight = Application::GetApp().GetVulkanSwapChain()->GetFramesInFlight();
+			s_Data->NextEvictionFrame = frame + framesInFlight + 1;
+
+			CR_LOG_WARN("Over memory budget; evicted {0} resources, saving {1} MB", evictedCount, saved / (1024 * 1024));
+		}
+	}
+
+	ResidencyHandle ResidencyManager::Register(uint64_t size, EvictFunction evict, RestoreFunction restore)
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+
+		ResidencyHandle handle;
+		if (!s_Data->FreeHandles.empty())
+		{
+			handle = s_Data->FreeHandles.back();
+			s_Data->FreeHandles.pop_back();
+		}
+		else
+		{
+			handle = (ResidencyHandle)s_Data->Resources.size();
+			s_Data->Resources.emplace_back();
+		}
+
+		ResidentResource& resource = s_Data->Resources[handle];
+		resource.Size = size;
+		resource.FullSize = size;
+		resource.LastUsedFrame = s_Data->Frame;
+		resource.Evicted = false;
+		resource.Registered = true;
+		resource.Evict = evict;
+		resource.Restore = restore;
+
+		return handle;
+	}
+
+	void ResidencyManager::Unregister(ResidencyHandle handle)
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+
+		s_Data->Resources[handle] = {};
+		s_Data->FreeHandles.push_back(handle);
+	}
+
+	void ResidencyManager::MarkUsed(ResidencyHandle handle)
+	{
+		RestoreFunction restore;
+		{
+			std::lock_guard<std::mutex> lock(s_Data->Mutex);
+			ResidentResource& resource = s_Data->Resources[handle];
+			resource.LastUsedFrame = s_Data->Frame;
+
+			if (!resource.Evicted)
+				return;
+
+			restore = resource.Restore;
+		}
+
+		// Outside the lock, restoring creates and releases resources
+		uint64_t size = restore();
+		if (size == 0)
+			return;
+
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+		ResidentResource& resource = s_Data->Resources[handle];
+		resource.Size = size;
+		resource.FullSize = size;
+		resource.Evicted = false;
+	}
+
+	bool ResidencyManager::MakeRoom(uint64_t size)
+	{
+		if (!s_Data)
+			return false;
+
+		Ref<Renderer> renderer = Application::GetApp().GetRenderer();
+		if (!renderer)
+			return false;
+
+		if (std::this_thread::get_id() != s_Data->MainThread)
+		{
+			s_Data->DeferredRoom += size;
+			return false;
+		}
+
+		// Evicting allocates the smaller versions, which may run out of memory as well
+		if (s_Data->MakingRoom.exchange(true))
+			return false;
+
+		// Candidates may still be read by frames in flight, their descriptors can only be rewritten once those are done
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+		VK_CHECK_RESULT(vkDeviceWaitIdle(device));
+
+		// Frees queued by this frame before now may be for resources it still records with
+		size_t freeMark = renderer->GetResourceFreeMark();
+
+		uint64_t saved = 0;
+		uint32_t evictedCount = 0;
+		for (ResidencyHandle handle : Utils::GetEvictionCandidates(s_Data->Frame))
+		{
+			if (saved >= size)
+				break;
+
+			saved += Utils::EvictResource(handle);
+			evictedCount++;
+		}
+
+		s_Data->MakingRoom = false;
+
+		// The GPU is idle, so completed frames' frees can run. Nothing evicted was used this frame, so the old versions can go too.
+		renderer->FlushResourceFrees(freeMark);
+
+		if (evictedCount == 0)
+			return false;
+
+		CR_LOG_WARN("Out of device memory; evicted {0} resources, saving {1} MB", evictedCount, saved / (1024 * 1024));
+		return true;
+	}
+
+	uint32_t ResidencyManager::GetResourceCount()
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+		return (uint32_t)(s_Data->Resources.size() - s_Data->FreeHandles.size());
+	}
+
+	uint32_t ResidencyManager::GetEvictedCount()
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+		return (uint32_t)std::count_if(s_Data->Resources.begin(), s_Data->Resources.end(), [](const ResidentResource& resource) { return resource.Evicted; });
+	}
+
+	uint64_t ResidencyManager::GetEvictedBytes()
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+
+		uint64_t bytes = 0;
+		for (const ResidentResource& resource : s_Data->Resources)
+		{
+			if (resource.Evicted)
+				bytes += resource.FullSize - resource.Size;
+		}
+
+		return bytes;
+	}
+
+}
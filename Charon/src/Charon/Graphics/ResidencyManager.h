@@ -0,0 +1,45 @@
+#pragma once
+#include "Charon/Core/Core.h"
+#include <functional>
+
+namespace Charon {
+
+	using ResidencyHandle = uint32_t;
+
+	// Keeps device local memory under the heap budget by evicting resources that haven't been used for a while.
+	// Evicting swaps a resource for a smaller version of itself (e.g. a texture without its top mips), restoring brings the
+	// full version back once it is used again. Resources report use with MarkUsed, anything not marked is considered cold.
+	class ResidencyManager
+	{
+	public:
+		// Returns the resource's new size in device local memory
+		using EvictFunction = std::function<uint64_t()>;
+		// Returns the full size once the full version is in place, 0 while it is still on its way
+		using RestoreFunction = std::function<uint64_t()>;
+
+		static const ResidencyHandle InvalidHandle = UINT32_MAX;
+	public:
+		static void Init();
+		static void Shutdown();
+
+		// Evicts the least recently used resources while a device local heap is over budget
+		static void BeginFrame(uint64_t frame);
+
+		static ResidencyHandle Register(uint64_t size, EvictFunction evict, RestoreFunction restore);
+		static void Unregister(ResidencyHandle handle);
+
+		// Starts restoring the resource if it was evicted, or checks on a restore already under way. Until it is done the
+		// smaller version stays in use. Main thread only.
+		static void MarkUsed(ResidencyHandle handle);
+
+		// Called by VulkanAllocator when device memory runs out. On the main thread this evicts resources not used this frame
+		// until size bytes are saved, then waits for the GPU so the old versions are freed immediately. Other threads can't
+		// evict, the room is made at the start of the next frame instead. Returns false if nothing was evicted right away.
+		static bool MakeRoom(uint64_t size);
+
+		static uint32_t GetResourceCount();
+		static uint32_t GetEvictedCount();
+		static uint64_t GetEvictedBytes(); // Saved by the resources currently evicted
+	};
+
+}
@@ -11,11 +11,53 @@ namespace Charon {
 		glm::mat4 Transform;
 	};
 
+	struct InstanceBatch
+	{
+		Ref<Mesh> Mesh;
+		const SubMesh* SubMesh = nullptr;
+		std::vector<glm::mat4> Transforms;
+	};
+
+	// One entry per submesh of every render command, bounds are stored SoA so the plane tests vectorize
+	struct CullingData
+	{
+		std::vector<uint32_t> CommandIndices;
+		std::vector<uint32_t> SubMeshIndices;
+
+		std::vector<float> CenterX, CenterY, CenterZ;
+		std::vector<float> ExtentX, ExtentY, ExtentZ;
+		std::vector<uint32_t> Visible;
+
+		void Resize(uint32_t count)
+		{
+			CommandIndices.resize(count);
+			SubMeshIndices.resize(count);
+			CenterX.resize(count);
+			CenterY.resize(count);
+			CenterZ.resize(count);
+			ExtentX.resize(count);
+			ExtentY.resize(count);
+			ExtentZ.resize(count);
+			Visible.resize(count);
+		}
+	};
+
 	struct SceneRendererData
 	{
 		Scene* ActiveScene = nullptr;
 		Ref<Camera> ActiveCamera;
 		std::vector<RenderCommand> RenderCommands;
+
+		// Reused every frame to group visible submeshes
+		std::vector<InstanceBatch> InstanceBatches;
+		std::unordered_map<const SubMesh*, uint32_t> InstanceBatchIndices;
+
+		CullingData Culling;
+		uint32_t VisibleSubMeshCount = 0;
+
+		bool FrustumCulling = true;
+		bool GPUDrivenRendering = true;
+		bool OcclusionCulling = true;
 	};
 
 	static struct SceneRendererData s_Data;
@@ -64,18 +106,253 @@ namespace Charon {
 		s_Data.RenderCommands.push_back(RenderCommand({ mesh, transform }));
 	}
 
+	void SceneRenderer::SetFrustumCulling(bool enabled)
+	{
+		s_Data.FrustumCulling = enabled;
+	}
+
+	bool SceneRenderer::IsFrustumCulling()
+	{
+		return s_Data.FrustumCulling;
+	}
+
+	uint32_t SceneRenderer::GetVisibleSubMeshCount()
+	{
+		return s_Data.VisibleSubMeshCount;
+	}
+
+	void SceneRenderer::SetOcclusionCulling(bool enabled)
+	{
+		s_Data.OcclusionCulling = enabled;
+	}
+
+	bool SceneRenderer::IsOcclusionCulling()
+	{
+		return s_Data.OcclusionCulling;
+	}
+
+	void SceneRenderer::SetGPUDrivenRendering(bool enabled)
+	{
+		s_Data.GPUDrivenRendering = enabled;
+	}
+
+	bool SceneRenderer::IsGPUDrivenRendering()
+	{
+		return s_Data.GPUDrivenRendering;
+	}
+
+	void SceneRenderer::CullRenderCommands()
+	{
+		CullingData& culling = s_Data.Culling;
+
+		uint32_t entryCount = 0;
+		for (const RenderCommand& command : s_Data.RenderCommands)
+			entryCount += (uint32_t)command.Mesh->GetSubMeshes().size();
+
+		culling.Resize(entryCount);
+
+		uint32_t entry = 0;
+		for (uint32_t commandIndex = 0; commandIndex < s_Data.RenderCommands.size(); commandIndex++)
+		{
+			uint32_t subMeshCount = (uint32_t)s_Data.RenderCommands[commandIndex].Mesh->GetSubMeshes().size();
+			for (uint32_t subMeshIndex = 0; subMeshIndex < subMeshCount; subMeshIndex++, entry++)
+			{
+				culling.CommandIndices[entry] = commandIndex;
+				culling.SubMeshIndices[entry] = subMeshIndex;
+			}
+		}
+
+		Frustum frustum = s_Data.ActiveCamera->GetFrustum();
+		// The GPU-driven path culls every instance on the GPU, so its batches don't change with the camera
+		bool cullingEnabled = s_Data.FrustumCulling && !s_Data.GPUDrivenRendering;
+
+		Ref<ThreadPool> threadPool = Application::GetApp().GetThreadPool();
+		threadPool->ParallelFor(entryCount, 256, [&](uint32_t begin, uint32_t end, uint32_t slot)
+		{
+			// World space center and extents (Arvo), the box is transformed by SubMesh::Transform and the object transform
+			for (uint32_t i = begin; i < end; i++)
+			{
+				const RenderCommand& command = s_Data.RenderCommands[culling.CommandIndices[i]];
+				const SubMesh& subMesh = command.Mesh->GetSubMeshes()[culling.SubMeshIndices[i]];
+				glm::mat4 transform = command.Transform * subMesh.Transform;
+
+				glm::vec3 center = (subMesh.BoundingBox.Min + subMesh.BoundingBox.Max) * 0.5f;
+				glm::vec3 extents = (subMesh.BoundingBox.Max - subMesh.BoundingBox.Min) * 0.5f;
+
+				glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1.0f));
+				glm::vec3 worldExtents = glm::mat3(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2]))) * extents;
+
+				culling.CenterX[i] = worldCenter.x;
+				culling.CenterY[i] = worldCenter.y;
+				culling.CenterZ[i] = worldCenter.z;
+				culling.ExtentX[i] = worldExtents.x;
+				culling.ExtentY[i] = worldExtents.y;
+				culling.ExtentZ[i] = worldExtents.z;
+				culling.Visible[i] = 1;
+			}
+
+			if (!cullingEnabled)
+				return;
+
+			const float* centerX = culling.CenterX.data();
+			const float* centerY = culling.CenterY.data();
+			const float* centerZ = culling.CenterZ.data();
+			const float* extentX = culling.ExtentX.data();
+			const float* extentY = culling.ExtentY.data();
+			const float* extentZ = culling.ExtentZ.data();
+			uint32_t* visible = culling.Visible.data();
+
+			// Planes in the outer loop so the inner loop is branch free over contiguous floats
+			for (const glm::vec4& plane : frustum.Planes)
+			{
+				float absX = glm::abs(plane.x), absY = glm::abs(plane.y), absZ = glm::abs(plane.z);
+
+				for (uint32_t i = begin; i < end; i++)
+				{
+					float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+					float radius = absX * extentX[i] + absY * extentY[i] + absZ * extentZ[i];
+					visible[i] &= (uint32_t)(distance + radius >= 0.0f);
+				}
+			}
+		});
+	}
+
 	void SceneRenderer::GeometryPass()
 	{
 		Ref<Renderer> renderer = Application::GetApp().GetRenderer();
-		renderer->BeginRenderPass(renderer->GetFramebuffer(), true);
 
-		for (RenderCommand command : s_Data.RenderCommands)
+		CullRenderCommands();
+
+		// Group visible submeshes into one instanced draw per submesh
+		const CullingData& culling = s_Data.Culling;
+
+		uint32_t batchCount = 0;
+		s_Data.InstanceBatchIndices.clear();
+		s_Data.VisibleSubMeshCount = 0;
+		for (uint32_t i = 0; i < culling.Visible.size(); i++)
+		{
+			if (!culling.Visible[i])
+				continue;
+
+			const RenderCommand& command = s_Data.RenderCommands[culling.CommandIndices[i]];
+			const SubMesh* subMesh = &command.Mesh->GetSubMeshes()[culling.SubMeshIndices[i]];
+
+			auto [it, inserted] = s_Data.InstanceBatchIndices.try_emplace(subMesh, batchCount);
+			if (inserted)
+			{
+				if (batchCount == s_Data.InstanceBatches.size())
+					s_Data.InstanceBatches.emplace_back();
+
+				InstanceBatch& batch = s_Data.InstanceBatches[batchCount++];
+				batch.Mesh = command.Mesh;
+				batch.SubMesh = subMesh;
+				batch.Transforms.clear();
+			}
+
+			s_Data.InstanceBatches[it->second].Transforms.push_back(command.Transform);
+			s_Data.VisibleSubMeshCount++;
+		}
+
+		for (uint32_t i = 0; i < batchCount; i++)
 		{
-			renderer->SubmitMesh(command.Mesh, command.Transform);
+			InstanceBatch& batch = s_Data.InstanceBatches[i];
+			batch.Mesh->MarkTexturesUsed();
+			renderer->SubmitSubMeshInstanced(batch.Mesh, *batch.SubMesh, batch.Transforms.data(), (uint32_t)batch.Transforms.size());
+			batch.Mesh = nullptr;
+			batch.SubMesh = nullptr;
 		}
 
-		renderer->Render();
-		renderer->EndRenderPass();
+		// Barriers between passes come from the accesses they declare
+		Ref<RenderGraph> graph = renderer->GetRenderGraph();
+		Ref<Framebuffer> framebuffer = renderer->GetFramebuffer();
+		RenderGraphResource color = graph->ImportImage(framebuffer->GetImage(0));
+		RenderGraphResource depth = graph->ImportImage(framebuffer->GetDepthImage());
+
+		if (s_Data.GPUDrivenRendering)
+		{
+			RenderGraphResource depthPyramid = graph->ImportImage(renderer->GetDepthPyramid());
+			RenderGraphResource indirectBuffer = graph->ImportBuffer(renderer->GetIndirectBuffer()->GetBuffer());
+			RenderGraphResource drawCountBuffer = graph->ImportBuffer(renderer->GetDrawCountBuffer()->GetBuffer());
+			RenderGraphResource visibilityBuffer = graph->ImportBuffer(renderer->GetDrawVisibilityBuffer()->GetBuffer());
+			RenderGraphResource instanceBuffer = graph->ImportBuffer(renderer->GetInstanceBuffer()->GetBuffer());
+
+			// Counts are cleared with a fill before the culling dispatch writes them
+			RenderGraphAccess drawCountReset = RenderGraphAccess::ComputeWrite;
+			drawCountReset.Stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+			drawCountReset.Access |= VK_ACCESS_TRANSFER_WRITE_BIT;
+
+			bool occlusionCulling = s_Data.OcclusionCulling;
+
+			// Draw what was visible against last frame's depth
+			graph->AddPass("Cull", {
+				{ depthPyramid, RenderGraphAccess::ComputeRead },
+				{ indirectBuffer, RenderGraphAccess::ComputeWrite },
+				{ drawCountBuffer, drawCountReset },
+				{ visibilityBuffer, RenderGraphAccess::ComputeWrite },
+				{ instanceBuffer, RenderGraphAccess::ComputeWrite } },
+				[renderer, occlusionCulling](VkCommandBuffer) { renderer->CullDrawList(occlusionCulling); });
+
+			graph->AddPass("Geometry", {
+				{ color, RenderGraphAccess::ColorAttachment },
+				{ depth, RenderGraphAccess::DepthAttachment },
+				{ indirectBuffer, RenderGraphAccess::IndirectRead },
+				{ drawCountBuffer, RenderGraphAccess::IndirectRead },
+				{ instanceBuffer, RenderGraphAccess::VertexRead } },
+				[renderer, framebuffer](VkCommandBuffer)
+				{
+					renderer->BeginRenderPass(framebuffer, true);
+					renderer->RenderIndirect();
+					renderer->EndRenderPass();
+				});
+
+			// Re-test the rest against this frame's depth so disoccluded objects don't pop in a frame late
+			if (occlusionCulling)
+			{
+				graph->AddPass("DepthPyramid", {
+					{ depth, RenderGraphAccess::ComputeRead },
+					{ depthPyramid, RenderGraphAccess::ComputeWrite } },
+					[renderer](VkCommandBuffer) { renderer->BuildDepthPyramid(); });
+
+				graph->AddPass("CullOccluded", {
+					{ depthPyramid, RenderGraphAccess::ComputeRead },
+					{ indirectBuffer, RenderGraphAccess::ComputeWrite },
+					{ drawCountBuffer, RenderGraphAccess::ComputeWrite },
+					{ visibilityBuffer, RenderGraphAccess::ComputeWrite },
+					{ instanceBuffer, RenderGraphAccess::ComputeWrite } },
+					[renderer](VkCommandBuffer) { renderer->CullOccludedDrawList(); });
+
+				graph->AddPass("GeometryLate", {
+					{ color, RenderGraphAccess::ColorAttachment },
+					{ depth, RenderGraphAccess::DepthAttachment },
+					{ indirectBuffer, RenderGraphAccess::IndirectRead },
+					{ drawCountBuffer, RenderGraphAccess::IndirectRead },
+					{ instanceBuffer, RenderGraphAccess::VertexRead } },
+					[renderer, framebuffer](VkCommandBuffer)
+					{
+						renderer->BeginRenderPass(framebuffer, false, true);
+						renderer->RenderIndirect();
+						renderer->EndRenderPass();
+					});
+			}
+		}
+		else
+		{
+			// Draws are recorded into secondary command buffers on the thread pool
+			graph->AddPass("Geometry", {
+				{ color, RenderGraphAccess::ColorAttachment },
+				{ depth, RenderGraphAccess::DepthAttachment } },
+				[renderer, framebuffer](VkCommandBuffer)
+				{
+					renderer->BeginRenderPass(framebuffer, true, false, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+					renderer->Render();
+					renderer->EndRenderPass();
+				});
+		}
+
+		// The final buffer is sampled by the UI after the graph
+		graph->AddPass("Present", { { color, RenderGraphAccess::FragmentRead } });
+
+		graph->Execute(renderer->GetActiveCommandBuffer());
 	}
 
 	Ref<Framebuffer> SceneRenderer::GetFinalBuffer()
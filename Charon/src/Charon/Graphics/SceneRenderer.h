@@ -19,9 +19,23 @@ namespace Charon {
 
         static void SubmitMesh(Ref<Mesh> mesh, glm::mat4 transform);
 
+        // Cull submeshes against the camera frustum on the CPU before batching
+        static void SetFrustumCulling(bool enabled);
+        static bool IsFrustumCulling();
+        static uint32_t GetVisibleSubMeshCount();
+
+        // Cull on the GPU and draw with vkCmdDrawIndexedIndirectCount instead of the CPU draw loop
+        static void SetGPUDrivenRendering(bool enabled);
+        static bool IsGPUDrivenRendering();
+
+        // Two phase Hi-Z occlusion culling on top of the GPU-driven path
+        static void SetOcclusionCulling(bool enabled);
+        static bool IsOcclusionCulling();
+
         static Ref<Framebuffer> GetFinalBuffer();
 
     private:
+        static void CullRenderCommands();
         static void GeometryPass();
 
     };
@@ -2,6 +2,9 @@
 #include "Shader.h"
 #include "Charon/Core/Application.h"
 #include "Charon/Graphics/VulkanTools.h"
+#include "Charon/Graphics/BindlessDescriptorSet.h"
+#include "Charon/Graphics/LayoutCache.h"
+#include "Charon/Graphics/ShaderCache.h"
 #include <shaderc/shaderc.hpp>
 #include <spirv_cross.hpp>
 #include <spirv_common.hpp>
@@ -9,8 +12,9 @@
 
 namespace Charon {
 
-	static IDxcCompiler3* s_HLSLCompiler;
-	static IDxcUtils* s_HLSLUtils;
+	// DXC instances are not thread safe, each thread that compiles shaders gets its own
+	static thread_local IDxcCompiler3* s_HLSLCompiler = nullptr;
+	static thread_local IDxcUtils* s_HLSLUtils = nullptr;
 	static IDxcIncludeHandler* s_DefaultIncludeHandler;
 
 	class CustomIncludeHandler : public IDxcIncludeHandler
@@ -97,6 +101,62 @@ namespace Charon {
 			return (VkShaderStageFlagBits)0;
 		}
 
+		// Ray tracing stages are compiled as libraries
+		static const wchar_t* ShaderStageToHLSLProfilePrefix(ShaderStage stage)
+		{
+			switch (stage)
+			{
+				case ShaderStage::VERTEX:	return L"vs";
+				case ShaderStage::FRAGMENT: return L"ps";
+				case ShaderStage::COMPUTE:  return L"cs";
+				case ShaderStage::RAYGEN:  return L"lib";
+				case ShaderStage::RAY_ANY_HIT:  return L"lib";
+				case ShaderStage::RAY_MISS:  return L"lib";
+				case ShaderStage::RAY_CLOSEST_HIT:  return L"lib";
+			}
+
+			CR_ASSERT(false, "Unknown Type");
+			return L"";
+		}
+
+		static shaderc_optimization_level ShaderOptimizationLevelToShaderc(ShaderOptimizationLevel level)
+		{
+			switch (level)
+			{
+				case ShaderOptimizationLevel::Debug:		return shaderc_optimization_level_zero;
+				case ShaderOptimizationLevel::Size:			return shaderc_optimization_level_size;
+				case ShaderOptimizationLevel::Performance:	return shaderc_optimization_level_performance;
+			}
+
+			CR_ASSERT(false, "Unknown Type");
+			return shaderc_optimization_level_zero;
+		}
+
+		// Creates this thread's DXC instances on first use
+		static void InitDXC()
+		{
+			if (s_HLSLCompiler)
+				return;
+
+			DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&s_HLSLCompiler));
+			DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&s_HLSLUtils));
+		}
+
+		// Major version in the high bits, minor in the low bits
+		static uint64_t GetDXCVersion()
+		{
+			uint32_t major = 0, minor = 0;
+
+			IDxcVersionInfo* versionInfo = nullptr;
+			if (SUCCEEDED(s_HLSLCompiler->QueryInterface(IID_PPV_ARGS(&versionInfo))))
+			{
+				versionInfo->GetVersion(&major, &minor);
+				versionInfo->Release();
+			}
+
+			return ((uint64_t)major << 32) | minor;
+		}
+
 		// TODO: Fix issue with structs
 		static ShaderUniformType GetType(spirv_cross::SPIRType type)
 		{
@@ -142,24 +202,37 @@ namespace Charon {
 			return (ShaderUniformType)0;
 		}
 
+		// Push descriptor sets can't contain dynamic descriptors, their uniform buffers point at the current data directly
+		static std::vector<VkDescriptorSetLayoutBinding> GetPushDescriptorBindings(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+		{
+			std::vector<VkDescriptorSetLayoutBinding> pushBindings = bindings;
+			for (VkDescriptorSetLayoutBinding& binding : pushBindings)
+			{
+				if (binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+					binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			}
+
+			return pushBindings;
+		}
+
 	}
 
-	Shader::Shader(const std::string& path)
-		: m_Path(path), m_EntryPoint("main"), m_Defines({})
+	Shader::Shader(const std::string& path, const ShaderCompileOptions& options)
+		: m_Path(path), m_EntryPoint("main"), m_CompileOptions(options)
 	{
 		Init();
 		CR_LOG_INFO("Initialized Vulkan shader: {0}", m_Path);
 	}
 
 	Shader::Shader(std::string_view path, std::string_view entryPoint)
-		: m_Path(path), m_EntryPoint(entryPoint), m_Defines({})
+		: m_Path(path), m_EntryPoint(entryPoint)
 	{
 		Init();
 		CR_LOG_INFO("Initialized Vulkan shader: {0}", m_Path);
 	}
 
-	Shader::Shader(std::string_view path, std::string_view entryPoint, const std::vector<std::wstring>& defines)
-		: m_Path(path), m_EntryPoint(entryPoint), m_Defines(defines)
+	Shader::Shader(std::string_view path, std::string_view entryPoint, const std::vector<std::wstring>& defines, const ShaderCompileOptions& options)
+		: m_Path(path), m_EntryPoint(entryPoint), m_Defines(defines), m_CompileOptions(options)
 	{
 		Init();
 		CR_LOG_INFO("Initialized Vulkan shader: {0}", m_Path);
@@ -174,32 +247,16 @@ namespace Charon {
 			vkDestroyShaderModule(logicalDevice, shaderStageInfo.module, nullptr);
 		}
 
-		for (int i = 0; i < m_DescriptorSetLayouts.size(); i++)
-		{
-			vkDestroyDescriptorSetLayout(logicalDevice, m_DescriptorSetLayouts[i], nullptr);
-		}
+		for (auto& [key, updateTemplate] : m_PushDescriptorUpdateTemplates)
+			vkDestroyDescriptorUpdateTemplate(logicalDevice, updateTemplate, nullptr);
 	}
 
 	void Shader::Init()
 	{
-		// TODO: Make this static
-		DxcCreateInstance(CLSID_DxcCompiler, IID_PPV_ARGS(&s_HLSLCompiler));
-		DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&s_HLSLUtils));
-
 		m_ShaderSrc = SplitShaders(m_Path);
 		CR_ASSERT(m_ShaderSrc.size() >= 1, "Shader is empty or path is invalid");
 
-		// TODO: Save path as std::filesystem::path
-		std::filesystem::path path(m_Path);
-		bool result = false;
-		if (path.extension() == ".hlsl")
-		{
-			result = CompileHLSLShaders(m_ShaderSrc);
-		}
-		else
-		{
-			result = CompileGLSLShaders(m_ShaderSrc);
-		}
+		bool result = CompileShaders();
 
 		CR_ASSERT(result, "Failed to initialize shader");
 		m_CompilationStatus = result;
@@ -207,163 +264,223 @@ namespace Charon {
 		CreateDescriptorSetLayouts();
 	}
 
-	bool Shader::CompileGLSLShaders(const std::unordered_map<ShaderStage, std::string>& shaderSrc)
+	bool Shader::CompileShaders()
 	{
-		// Setup compiler
-		shaderc::Compiler compiler;
-		shaderc::CompileOptions options;
-		options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+		// TODO: Save path as std::filesystem::path
+		bool isHLSL = std::filesystem::path(m_Path).extension() == ".hlsl";
+
+		// Ordered by stage so push constant offsets don't depend on hash map order
+		std::vector<ShaderStage> stages;
+		for (const auto& [stage, src] : m_ShaderSrc)
+			stages.push_back(stage);
+		std::sort(stages.begin(), stages.end());
 
-		for (auto&& [stage, src] : m_ShaderSrc)
+		struct CompiledStage
+		{
+			std::vector<uint32_t> Spirv;
+			ShaderReflectionData ReflectionData;
+			bool Success = false;
+		};
+		std::vector<CompiledStage> compiledStages(stages.size());
+
+		// Stages are independent, so each one compiles on its own thread
+		Application::GetApp().GetThreadPool()->ParallelFor((uint32_t)stages.size(), 1, [&](uint32_t begin, uint32_t end, uint32_t slot)
 		{
-			// Compile shader source and check for errors
-			auto compilationResult = compiler.CompileGlslToSpv(src, Utils::ShaderStageToShaderc(stage), m_Path.c_str(), options);
-			if (compilationResult.GetCompilationStatus() != shaderc_compilation_status_success)
+			for (uint32_t i = begin; i < end; i++)
 			{
-				CR_LOG_ERROR("Warnings ({0}), Errors ({1}) \n{2}", compilationResult.GetNumWarnings(), compilationResult.GetNumErrors(), compilationResult.GetErrorMessage());
-				return false;
+				const std::string& src = m_ShaderSrc.at(stages[i]);
+				CompiledStage& compiledStage = compiledStages[i];
+
+				if (isHLSL)
+					compiledStage.Success = CompileHLSLStage(stages[i], src, compiledStage.Spirv, compiledStage.ReflectionData);
+				else
+					compiledStage.Success = CompileGLSLStage(stages[i], src, compiledStage.Spirv, compiledStage.ReflectionData);
 			}
+		});
 
-			// Format data
-			const uint8_t* data = reinterpret_cast<const uint8_t*>(compilationResult.cbegin());
-			const uint8_t* dataEnd = reinterpret_cast<const uint8_t*>(compilationResult.cend());
-			uint32_t size = dataEnd - data;
+		for (const CompiledStage& compiledStage : compiledStages)
+		{
+			if (!compiledStage.Success)
+				return false;
+		}
 
-			std::vector<uint32_t> spirv(compilationResult.cbegin(), compilationResult.cend());
+		for (uint32_t i = 0; i < stages.size(); i++)
+		{
+			CreateShaderModule(stages[i], compiledStages[i].Spirv, isHLSL ? m_EntryPoint.c_str() : "main");
+			AddReflectionData(compiledStages[i].ReflectionData);
+		}
 
-			VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+		return true;
+	}
+
+	bool Shader::CompileGLSLStage(ShaderStage stage, const std::string& src, std::vector<uint32_t>& outSpirv, ShaderReflectionData& outReflectionData) const
+	{
+		uint32_t spirvVersion = 0, spirvRevision = 0;
+		shaderc_get_spv_version(&spirvVersion, &spirvRevision);
 
-			// Create shader module (TODO: Create function for this)
-			VkShaderModuleCreateInfo createInfo{};
-			createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-			createInfo.codeSize = size;
-			createInfo.pCode = spirv.data();
+		// Key covers the stage source, its includes, the compile options and the compiler version
+		const uint32_t compileOptions[] = { (uint32_t)stage, shaderc_env_version_vulkan_1_2, spirvVersion, spirvRevision, (uint32_t)m_CompileOptions.OptimizationLevel };
+		uint64_t key = ShaderCache::Hash(src);
+		key = ShaderCache::HashIncludes(src, std::filesystem::path(m_Path).parent_path(), key);
+		key = ShaderCache::Hash(compileOptions, sizeof(compileOptions), key);
 
-			VkShaderModule shaderModule;
-			VK_CHECK_RESULT(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
+		if (ShaderCache::Load(key, outSpirv, outReflectionData))
+			return true;
 
-			// Create shader stage
-			VkPipelineShaderStageCreateInfo shaderStageInfo{};
-			shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-			shaderStageInfo.stage = Utils::ShaderStageToVulkan(stage);;
-			shaderStageInfo.module = shaderModule;
-			shaderStageInfo.pName = "main";
+		// shaderc compilers are not shared between threads
+		shaderc::Compiler compiler;
+		shaderc::CompileOptions options;
+		options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+		options.SetOptimizationLevel(Utils::ShaderOptimizationLevelToShaderc(m_CompileOptions.OptimizationLevel));
+		if (m_CompileOptions.OptimizationLevel == ShaderOptimizationLevel::Debug)
+			options.SetGenerateDebugInfo();
 
-			m_ShaderCreateInfo.push_back(shaderStageInfo);
-			ReflectShader(spirv, stage);
+		// Compile shader source and check for errors
+		auto compilationResult = compiler.CompileGlslToSpv(src, Utils::ShaderStageToShaderc(stage), m_Path.c_str(), options);
+		if (compilationResult.GetCompilationStatus() != shaderc_compilation_status_success)
+		{
+			CR_LOG_ERROR("Warnings ({0}), Errors ({1}) \n{2}", compilationResult.GetNumWarnings(), compilationResult.GetNumErrors(), compilationResult.GetErrorMessage());
+			return false;
 		}
 
+		outSpirv.assign(compilationResult.cbegin(), compilationResult.cend());
+		outReflectionData = ReflectShader(outSpirv, stage);
+		ShaderCache::Store(key, outSpirv, outReflectionData);
 		return true;
 	}
 
-	bool Shader::CompileHLSLShaders(const std::unordered_map<ShaderStage, std::string>& shaderSrc)
+	bool Shader::CompileHLSLStage(ShaderStage stage, const std::string& src, std::vector<uint32_t>& outSpirv, ShaderReflectionData& outReflectionData) const
 	{
+		Utils::InitDXC();
+
 		std::vector<const wchar_t*> arguments;
 
 		arguments.push_back(L"-spirv");
 		arguments.push_back(L"-fspv-target-env=vulkan1.2");
 
-		//Strip reflection data and pdbs (see later)
-		arguments.push_back(L"-Qstrip_debug");
+		//Strip reflection data and pdbs (see later), debug builds keep their debug info
+		if (m_CompileOptions.OptimizationLevel != ShaderOptimizationLevel::Debug)
+			arguments.push_back(L"-Qstrip_debug");
 		arguments.push_back(L"-Qstrip_reflect");
 
 		arguments.push_back(L"-I /assets/shaders/Sorting");
 
 		arguments.push_back(DXC_ARG_WARNINGS_ARE_ERRORS);
-		arguments.push_back(DXC_ARG_DEBUG);
 		arguments.push_back(DXC_ARG_PACK_MATRIX_COLUMN_MAJOR);
 
+		switch (m_CompileOptions.OptimizationLevel)
+		{
+			case ShaderOptimizationLevel::Debug:
+				arguments.push_back(DXC_ARG_SKIP_OPTIMIZATIONS);
+				arguments.push_back(DXC_ARG_DEBUG);
+				break;
+			case ShaderOptimizationLevel::Size:
+				// Runs spirv-opt's size recipe instead of the -O3 one
+				arguments.push_back(L"-Oconfig=-Os");
+				break;
+			case ShaderOptimizationLevel::Performance:
+				arguments.push_back(DXC_ARG_OPTIMIZATION_LEVEL3);
+				break;
+		}
+
+		if (m_CompileOptions.Enable16BitTypes)
+		{
+			CR_ASSERT(m_CompileOptions.ShaderModelMajor > 6 || m_CompileOptions.ShaderModelMinor >= 2, "16-bit types need shader model 6.2 or newer");
+			arguments.push_back(L"-enable-16bit-types");
+		}
+
 		for (const std::wstring& define : m_Defines)
 		{
 			arguments.push_back(L"-D");
 			arguments.push_back(define.c_str());
 		}
 
-		for (const auto& [stage, shaderSrc] : shaderSrc)
-		{
-			std::wstring widestr = std::wstring(m_EntryPoint.begin(), m_EntryPoint.end());
-			const wchar_t* widecstr = widestr.c_str();
+		std::wstring widestr = std::wstring(m_EntryPoint.begin(), m_EntryPoint.end());
+		const wchar_t* widecstr = widestr.c_str();
 
-			// Set entry point
-			arguments.push_back(L"-E");
-			arguments.push_back(widecstr);
+		// Set entry point
+		arguments.push_back(L"-E");
+		arguments.push_back(widecstr);
 
-			// Set stage target (TODO: Add more stage options)
-			arguments.push_back(L"-T");
-			arguments.push_back(L"cs_6_2");
+		// Set stage target, library profiles only exist from 6.3
+		const wchar_t* profilePrefix = Utils::ShaderStageToHLSLProfilePrefix(stage);
+		uint32_t shaderModelMinor = m_CompileOptions.ShaderModelMinor;
+		if (wcscmp(profilePrefix, L"lib") == 0 && m_CompileOptions.ShaderModelMajor == 6)
+			shaderModelMinor = std::max(shaderModelMinor, 3u);
 
-			IDxcBlobEncoding* blobEncoding;
-			s_HLSLUtils->CreateBlob(shaderSrc.c_str(), shaderSrc.size(), CP_UTF8, &blobEncoding);
+		std::wstring profile = std::wstring(profilePrefix) + L"_" + std::to_wstring(m_CompileOptions.ShaderModelMajor) + L"_" + std::to_wstring(shaderModelMinor);
+		arguments.push_back(L"-T");
+		arguments.push_back(profile.c_str());
 
-			DxcBuffer sourceBuffer;
-			sourceBuffer.Ptr = blobEncoding->GetBufferPointer();
-			sourceBuffer.Size = blobEncoding->GetBufferSize();
-			sourceBuffer.Encoding = 0;
+		// Key covers the source, its includes, every compiler argument and the compiler version
+		uint64_t compilerVersion = Utils::GetDXCVersion();
+		uint64_t key = ShaderCache::Hash(src);
+		key = ShaderCache::HashIncludes(src, std::filesystem::path(m_Path).parent_path(), key);
+		for (const wchar_t* argument : arguments)
+			key = ShaderCache::Hash(argument, wcslen(argument) * sizeof(wchar_t), key);
+		key = ShaderCache::Hash(&compilerVersion, sizeof(compilerVersion), key);
 
-			CustomIncludeHandler includeHandler = CustomIncludeHandler();
+		if (ShaderCache::Load(key, outSpirv, outReflectionData))
+			return true;
 
-			IDxcResult* pCompileResult;
-			s_HLSLCompiler->Compile(&sourceBuffer, arguments.data(), (uint32_t)arguments.size(), &includeHandler, IID_PPV_ARGS(&pCompileResult));
+		IDxcBlobEncoding* blobEncoding;
+		s_HLSLUtils->CreateBlob(src.c_str(), src.size(), CP_UTF8, &blobEncoding);
 
-			IDxcBlobUtf8* pErrors;
-			pCompileResult->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&pErrors), nullptr);
-			if (pErrors && pErrors->GetStringLength() > 0)
-			{
-				CR_LOG_CRITICAL((char*)pErrors->GetBufferPointer());
-				return false;
-			}
+		DxcBuffer sourceBuffer;
+		sourceBuffer.Ptr = blobEncoding->GetBufferPointer();
+		sourceBuffer.Size = blobEncoding->GetBufferSize();
+		sourceBuffer.Encoding = 0;
 
-			IDxcBlob* pResult;
-			pCompileResult->GetResult(&pResult);
+		CustomIncludeHandler includeHandler = CustomIncludeHandler();
 
-			size_t size = pResult->GetBufferSize();
-			std::vector<uint32_t> spirv(size / sizeof(uint32_t));
-			std::memcpy(spirv.data(), pResult->GetBufferPointer(), size);
+		IDxcResult* pCompileResult;
+		s_HLSLCompiler->Compile(&sourceBuffer, arguments.data(), (uint32_t)arguments.size(), &includeHandler, IID_PPV_ARGS(&pCompileResult));
 
-			VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
-
-			// Create shader module (TODO: Create function for this)
-			VkShaderModuleCreateInfo createInfo{};
-			createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-			createInfo.codeSize = size;
-			createInfo.pCode = spirv.data();
+		IDxcBlobUtf8* pErrors;
+		pCompileResult->GetOutput(DXC_OUT_ERRORS, IID_PPV_ARGS(&pErrors), nullptr);
+		if (pErrors && pErrors->GetStringLength() > 0)
+		{
+			CR_LOG_CRITICAL((char*)pErrors->GetBufferPointer());
+			return false;
+		}
 
-			VkShaderModule shaderModule;
-			VK_CHECK_RESULT(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
+		IDxcBlob* pResult;
+		pCompileResult->GetResult(&pResult);
 
-			// Create shader stage
-			VkPipelineShaderStageCreateInfo shaderStageInfo{};
-			shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-			shaderStageInfo.stage = Utils::ShaderStageToVulkan(stage);;
-			shaderStageInfo.module = shaderModule;
-			shaderStageInfo.pName = m_EntryPoint.c_str();
-
-			m_ShaderCreateInfo.push_back(shaderStageInfo);
-			ReflectShader(spirv, stage);
-		}
+		size_t size = pResult->GetBufferSize();
+		outSpirv.resize(size / sizeof(uint32_t));
+		std::memcpy(outSpirv.data(), pResult->GetBufferPointer(), size);
 
+		outReflectionData = ReflectShader(outSpirv, stage);
+		ShaderCache::Store(key, outSpirv, outReflectionData);
 		return true;
 	}
 
-	void Shader::ReflectShader(const std::vector<uint32_t>& data, ShaderStage stage)
+	ShaderReflectionData Shader::ReflectShader(const std::vector<uint32_t>& data, ShaderStage stage)
 	{
+		ShaderReflectionData reflectionData;
+
 		spirv_cross::Compiler compiler(data);
 		spirv_cross::ShaderResources resources = compiler.get_shader_resources();
 
-		for (const spirv_cross::Resource& resource : resources.push_constant_buffers)
+		// Separate images or samplers in the bindless set mean the shader indexes the global arrays
+		for (const auto* resourceList : { &resources.separate_images, &resources.separate_samplers })
 		{
-			uint32_t bufferOffset = 0;
+			for (const spirv_cross::Resource& resource : *resourceList)
+			{
+				if (compiler.get_decoration(resource.id, spv::DecorationDescriptorSet) == BindlessDescriptorSet::SetIndex)
+					reflectionData.UsesBindlessDescriptorSet = true;
+			}
+		}
 
+		for (const spirv_cross::Resource& resource : resources.push_constant_buffers)
+		{
 			const auto& bufferType = compiler.get_type(resource.base_type_id);
-			auto bufferSize = compiler.get_declared_struct_size(bufferType);
 
-			if (m_PushConstantBufferRanges.size())
-				bufferOffset = m_PushConstantBufferRanges.back().Offset + m_PushConstantBufferRanges.back().Size;
-
-			auto& pushConstantRange = m_PushConstantBufferRanges.emplace_back();
+			auto& pushConstantRange = reflectionData.PushConstantRanges.emplace_back();
 			pushConstantRange.ShaderStage = Utils::ShaderStageToVulkan(stage);
-			pushConstantRange.Size = bufferSize - bufferOffset;
-			pushConstantRange.Offset = bufferOffset;
+			pushConstantRange.Size = compiler.get_declared_struct_size(bufferType);
+			pushConstantRange.Offset = 0;
 		}
 
 		// Get all uniform buffers
@@ -372,7 +489,7 @@ namespace Charon {
 			auto& bufferType = compiler.get_type(resource.base_type_id);
 			int memberCount = bufferType.member_types.size();
 
-			UniformBufferDescription& buffer = m_UniformBufferDescriptions.emplace_back();
+			UniformBufferDescription& buffer = reflectionData.UniformBuffers.emplace_back();
 			buffer.Name = resource.name;
 			buffer.Size = compiler.get_declared_struct_size(bufferType);
 			buffer.BindingPoint = compiler.get_decoration(resource.id, spv::DecorationBinding);
@@ -397,7 +514,7 @@ namespace Charon {
 			auto& bufferType = compiler.get_type(resource.base_type_id);
 			int memberCount = bufferType.member_types.size();
 
-			StorageBufferDescription& buffer = m_StorageBufferDescriptions.emplace_back();
+			StorageBufferDescription& buffer = reflectionData.StorageBuffers.emplace_back();
 
 			buffer.Name = resource.name;
 			buffer.BindingPoint = compiler.get_decoration(resource.id, spv::DecorationBinding);
@@ -412,7 +529,7 @@ namespace Charon {
 			{
 				auto& type = compiler.get_type(resource.base_type_id);
 
-				ShaderAttribute& attribute = m_ShaderAttributeDescriptions.emplace_back();
+				ShaderAttribute& attribute = reflectionData.Attributes.emplace_back();
 
 				attribute.Name = resource.name;
 				attribute.Location = compiler.get_decoration(resource.id, spv::DecorationLocation);
@@ -429,7 +546,7 @@ namespace Charon {
 		{
 			auto& type = compiler.get_type(resource.base_type_id);
 
-			ShaderResource& shaderResource = m_ShaderResourceDescriptions.emplace_back();
+			ShaderResource& shaderResource = reflectionData.Resources.emplace_back();
 
 			shaderResource.Name = resource.name;
 			shaderResource.BindingPoint = compiler.get_decoration(resource.id, spv::DecorationBinding);
@@ -438,32 +555,91 @@ namespace Charon {
 			shaderResource.Type = Utils::GetType(type);
 		}
 
+		// Get all storage images in the shader
+		for (auto& resource : resources.storage_images)
+		{
+			auto& type = compiler.get_type(resource.base_type_id);
+
+			ShaderResource& shaderResource = reflectionData.Resources.emplace_back();
+
+			shaderResource.Name = resource.name;
+			shaderResource.BindingPoint = compiler.get_decoration(resource.id, spv::DecorationBinding);
+			shaderResource.DescriptorSetIndex = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+			shaderResource.Dimension = type.image.dim;
+			shaderResource.Type = type.image.dim == spv::DimCube ? ShaderUniformType::IMAGE_CUBE : ShaderUniformType::IMAGE_2D;
+		}
+
 		// Get all acceleration structures
 		for (const spirv_cross::Resource& resource : resources.acceleration_structures)
 		{
 			auto& type = compiler.get_type(resource.base_type_id);
 
-			ShaderResource& shaderResource = m_ShaderResourceDescriptions.emplace_back();
+			ShaderResource& shaderResource = reflectionData.Resources.emplace_back();
 
 			shaderResource.Name = resource.name;
 			shaderResource.BindingPoint = compiler.get_decoration(resource.id, spv::DecorationBinding);
 			shaderResource.DescriptorSetIndex = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
 		}
+
+		return reflectionData;
 	}
 
-	void Shader::CreateDescriptorSetLayouts()
+	void Shader::AddReflectionData(const ShaderReflectionData& reflectionData)
+	{
+		m_UsesBindlessDescriptorSet |= reflectionData.UsesBindlessDescriptorSet;
+
+		// Each stage's push constant block starts where the previous stage's ended
+		for (const PushConstantRange& range : reflectionData.PushConstantRanges)
+		{
+			uint32_t bufferOffset = 0;
+			if (m_PushConstantBufferRanges.size())
+				bufferOffset = m_PushConstantBufferRanges.back().Offset + m_PushConstantBufferRanges.back().Size;
+
+			auto& pushConstantRange = m_PushConstantBufferRanges.emplace_back();
+			pushConstantRange.ShaderStage = range.ShaderStage;
+			pushConstantRange.Size = range.Size - bufferOffset;
+			pushConstantRange.Offset = bufferOffset;
+		}
+
+		m_UniformBufferDescriptions.insert(m_UniformBufferDescriptions.end(), reflectionData.UniformBuffers.begin(), reflectionData.UniformBuffers.end());
+		m_StorageBufferDescriptions.insert(m_StorageBufferDescriptions.end(), reflectionData.StorageBuffers.begin(), reflectionData.StorageBuffers.end());
+		m_ShaderAttributeDescriptions.insert(m_ShaderAttributeDescriptions.end(), reflectionData.Attributes.begin(), reflectionData.Attributes.end());
+		m_ShaderResourceDescriptions.insert(m_ShaderResourceDescriptions.end(), reflectionData.Resources.begin(), reflectionData.Resources.end());
+	}
+
+	void Shader::CreateShaderModule(ShaderStage stage, const std::vector<uint32_t>& spirv, const char* entryPoint)
 	{
 		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
 
+		VkShaderModuleCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+		createInfo.codeSize = spirv.size() * sizeof(uint32_t);
+		createInfo.pCode = spirv.data();
+
+		VkShaderModule shaderModule;
+		VK_CHECK_RESULT(vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule));
+
+		// Create shader stage
+		VkPipelineShaderStageCreateInfo shaderStageInfo{};
+		shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStageInfo.stage = Utils::ShaderStageToVulkan(stage);
+		shaderStageInfo.module = shaderModule;
+		shaderStageInfo.pName = entryPoint;
+
+		m_ShaderCreateInfo.push_back(shaderStageInfo);
+	}
+
+	void Shader::CreateDescriptorSetLayouts()
+	{
 		std::unordered_map<int, std::vector<VkDescriptorSetLayoutBinding>> descriptorSetLayoutBindings;
 
-		// Create uniform buffer layout bindings
+		// Create uniform buffer layout bindings, dynamic so sets stay valid as uniform data moves through the ring each frame
 		for (int i = 0; i < m_UniformBufferDescriptions.size(); i++)
 		{
 			VkDescriptorSetLayoutBinding layout{};
 
 			layout.binding = m_UniformBufferDescriptions[i].BindingPoint;
-			layout.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			layout.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 			layout.descriptorCount = 1;
 			layout.stageFlags = VK_SHADER_STAGE_ALL;
 			layout.pImmutableSamplers = nullptr;
@@ -504,8 +680,10 @@ namespace Charon {
 		{
 			VkDescriptorSetLayoutBinding layout{};
 
+			bool isStorageImage = m_ShaderResourceDescriptions[i].Type == ShaderUniformType::IMAGE_2D || m_ShaderResourceDescriptions[i].Type == ShaderUniformType::IMAGE_CUBE;
+
 			layout.binding = m_ShaderResourceDescriptions[i].BindingPoint;
-			layout.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			layout.descriptorType = isStorageImage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 			layout.descriptorCount = 1;
 			layout.stageFlags = VK_SHADER_STAGE_ALL;
 			layout.pImmutableSamplers = nullptr;
@@ -513,15 +691,14 @@ namespace Charon {
 			descriptorSetLayoutBindings[m_ShaderResourceDescriptions[i].DescriptorSetIndex].push_back(layout);
 		}
 
+		// The bindless set uses the global layout instead of one built from reflection
+		if (m_UsesBindlessDescriptorSet)
+			descriptorSetLayoutBindings.erase(BindlessDescriptorSet::SetIndex);
+
 		// Use layout bindings to create descriptor set layouts
 		int ID = 0;
 		for (auto const& [descriptorSetIndex, layouts] : descriptorSetLayoutBindings)
 		{
-			VkDescriptorSetLayoutCreateInfo layoutInfo{};
-			layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-			layoutInfo.bindingCount = layouts.size();
-			layoutInfo.pBindings = layouts.data();
-
 			for (int i = 0; i < m_UniformBufferDescriptions.size(); i++)
 			{
 				if (m_UniformBufferDescriptions[i].DescriptorSetIndex == descriptorSetIndex)
@@ -559,24 +736,98 @@ namespace Charon {
 			if (descriptorSetIndex >= m_DescriptorSetLayouts.size())
 				m_DescriptorSetLayouts.resize(descriptorSetIndex + 1);
 
-			VkDescriptorSetLayout& descriptorSetLayout = m_DescriptorSetLayouts[descriptorSetIndex];
-			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout));
+			// Shaders declaring the same set share one layout
+			VkDescriptorSetLayout descriptorSetLayout = LayoutCache::GetDescriptorSetLayout(layouts);
+			m_DescriptorSetLayouts[descriptorSetIndex] = descriptorSetLayout;
 			m_DescriptorSetLayoutMap[descriptorSetIndex] = descriptorSetLayout;
+			m_DescriptorSetLayoutBindings[descriptorSetIndex] = layouts;
+		}
+
+		if (m_UsesBindlessDescriptorSet)
+		{
+			if (BindlessDescriptorSet::SetIndex >= m_DescriptorSetLayouts.size())
+				m_DescriptorSetLayouts.resize(BindlessDescriptorSet::SetIndex + 1);
+
+			m_DescriptorSetLayouts[BindlessDescriptorSet::SetIndex] = BindlessDescriptorSet::GetDescriptorSetLayout();
+			m_DescriptorSetLayoutMap[BindlessDescriptorSet::SetIndex] = BindlessDescriptorSet::GetDescriptorSetLayout();
 		}
 
 		for (auto& dsl : m_DescriptorSetLayouts)
 		{
 			if (!dsl)
-			{
-				VkDescriptorSetLayoutCreateInfo layoutInfo{};
-				layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-				layoutInfo.bindingCount = 0;
-				layoutInfo.pBindings = nullptr;
-				VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &dsl));
-			}
+				dsl = LayoutCache::GetDescriptorSetLayout({});
 		}
 	}
 
+	VkDescriptorSetLayout Shader::GetPushDescriptorSetLayout(uint32_t set)
+	{
+		auto it = m_PushDescriptorSetLayouts.find(set);
+		if (it != m_PushDescriptorSetLayouts.end())
+			return it->second;
+
+		VkDescriptorSetLayout descriptorSetLayout = LayoutCache::GetDescriptorSetLayout(Utils::GetPushDescriptorBindings(m_DescriptorSetLayoutBindings.at(set)), VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
+		m_PushDescriptorSetLayouts[set] = descriptorSetLayout;
+		return descriptorSetLayout;
+	}
+
+	VkDescriptorUpdateTemplate Shader::GetPushDescriptorUpdateTemplate(uint32_t set, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout)
+	{
+		// Templates are only valid with the pipeline layout they were created for
+		auto key = std::make_tuple(set, bindPoint, pipelineLayout);
+		auto it = m_PushDescriptorUpdateTemplates.find(key);
+		if (it != m_PushDescriptorUpdateTemplates.end())
+			return it->second;
+
+		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+		std::vector<VkDescriptorUpdateTemplateEntry> templateEntries = GetDescriptorUpdateTemplateEntries(Utils::GetPushDescriptorBindings(m_DescriptorSetLayoutBindings.at(set)));
+
+		VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+		templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+		templateInfo.descriptorUpdateEntryCount = (uint32_t)templateEntries.size();
+		templateInfo.pDescriptorUpdateEntries = templateEntries.data();
+		templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR;
+		templateInfo.pipelineBindPoint = bindPoint;
+		templateInfo.pipelineLayout = pipelineLayout;
+		templateInfo.set = set;
+
+		VkDescriptorUpdateTemplate& updateTemplate = m_PushDescriptorUpdateTemplates[key];
+		VK_CHECK_RESULT(vkCreateDescriptorUpdateTemplate(device, &templateInfo, nullptr, &updateTemplate));
+		return updateTemplate;
+	}
+
+	std::vector<VkDescriptorUpdateTemplateEntry> Shader::GetDescriptorUpdateTemplateEntries(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+	{
+		std::vector<VkDescriptorUpdateTemplateEntry> entries;
+		entries.reserve(bindings.size());
+
+		for (const VkDescriptorSetLayoutBinding& binding : bindings)
+		{
+			// Resources used by several stages are reflected once per stage
+			bool duplicate = std::any_of(entries.begin(), entries.end(), [&](const VkDescriptorUpdateTemplateEntry& entry) { return entry.dstBinding == binding.binding; });
+			if (duplicate)
+				continue;
+
+			VkDescriptorUpdateTemplateEntry& entry = entries.emplace_back();
+			entry.dstBinding = binding.binding;
+			entry.dstArrayElement = 0;
+			entry.descriptorCount = binding.descriptorCount;
+			entry.descriptorType = binding.descriptorType;
+			entry.stride = sizeof(DescriptorInfo);
+		}
+
+		// Bindings follow each other in ascending order, arrays take one element per descriptor
+		std::sort(entries.begin(), entries.end(), [](const VkDescriptorUpdateTemplateEntry& a, const VkDescriptorUpdateTemplateEntry& b) { return a.dstBinding < b.dstBinding; });
+
+		size_t offset = 0;
+		for (VkDescriptorUpdateTemplateEntry& entry : entries)
+		{
+			entry.offset = offset;
+			offset += entry.descriptorCount * sizeof(DescriptorInfo);
+		}
+
+		return entries;
+	}
+
 	uint32_t Shader::GetTypeSize(ShaderUniformType type)
 	{
 		switch (type)
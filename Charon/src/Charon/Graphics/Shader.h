@@ -71,6 +71,20 @@ namespace Charon {
 		uint32_t Index;
 	};
 
+	// Data for one descriptor of an update template. Templates read a DescriptorInfo array holding the set's bindings in
+	// ascending order, a binding with descriptorCount > 1 takes that many consecutive elements.
+	union DescriptorInfo
+	{
+		VkDescriptorImageInfo Image;
+		VkDescriptorBufferInfo Buffer;
+		VkAccelerationStructureKHR AccelerationStructure;
+
+		DescriptorInfo() : Buffer() {}
+		DescriptorInfo(const VkDescriptorImageInfo& image) : Image(image) {}
+		DescriptorInfo(const VkDescriptorBufferInfo& buffer) : Buffer(buffer) {}
+		DescriptorInfo(VkAccelerationStructureKHR accelerationStructure) : AccelerationStructure(accelerationStructure) {}
+	};
+
 	struct PushConstantRange
 	{
 		VkShaderStageFlagBits ShaderStage = VK_SHADER_STAGE_FLAG_BITS_MAX_ENUM;
@@ -78,12 +92,44 @@ namespace Charon {
 		uint32_t Size = 0;
 	};
 
+	// Everything reflected from one stage, cached on disk next to its SPIR-V
+	struct ShaderReflectionData
+	{
+		bool UsesBindlessDescriptorSet = false;
+
+		// Offset is 0 and Size is the full block size, stages are laid out one after another when merged
+		std::vector<PushConstantRange> PushConstantRanges;
+		std::vector<UniformBufferDescription> UniformBuffers;
+		std::vector<StorageBufferDescription> StorageBuffers;
+		std::vector<ShaderAttribute> Attributes;
+		std::vector<ShaderResource> Resources;
+	};
+
+	enum class ShaderOptimizationLevel
+	{
+		Debug, Size, Performance
+	};
+
+	struct ShaderCompileOptions
+	{
+		// HLSL only, each stage is compiled with its own profile for this model (e.g. cs_6_6), ray tracing libraries with at least 6.3
+		uint32_t ShaderModelMajor = 6;
+		uint32_t ShaderModelMinor = 2;
+		bool Enable16BitTypes = false;
+
+#ifdef CR_DEBUG
+		ShaderOptimizationLevel OptimizationLevel = ShaderOptimizationLevel::Debug;
+#else
+		ShaderOptimizationLevel OptimizationLevel = ShaderOptimizationLevel::Performance;
+#endif
+	};
+
 	class Shader : public Asset
 	{
 	public:
-		Shader(const std::string& path);
+		Shader(const std::string& path, const ShaderCompileOptions& options = {});
 		Shader(std::string_view path, std::string_view entryPoint);
-		Shader(std::string_view path, std::string_view entryPoint, const std::vector<std::wstring>& defines);
+		Shader(std::string_view path, std::string_view entryPoint, const std::vector<std::wstring>& defines, const ShaderCompileOptions& options = {});
 		~Shader();
 	public:
 		inline const std::vector<UniformBufferDescription>& GetUniformBufferDescriptions() { return m_UniformBufferDescriptions; }
@@ -95,18 +141,27 @@ namespace Charon {
 		inline const VkDescriptorSetLayout GetDescriptorSetLayout(uint32_t set) { return m_DescriptorSetLayoutMap.at(set); }
 		inline const std::vector<VkPipelineShaderStageCreateInfo>& GetShaderCreateInfo() { return m_ShaderCreateInfo; };
 
+		// Variants of a set for vkCmdPushDescriptorSetWithTemplateKHR, created on first use per pipeline layout
+		VkDescriptorSetLayout GetPushDescriptorSetLayout(uint32_t set);
+		VkDescriptorUpdateTemplate GetPushDescriptorUpdateTemplate(uint32_t set, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout);
+
+		static std::vector<VkDescriptorUpdateTemplateEntry> GetDescriptorUpdateTemplateEntries(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
 		static uint32_t GetTypeSize(ShaderUniformType type);
 
 		const std::vector<PushConstantRange>& GetPushConstantRanges() const { return m_PushConstantBufferRanges; }
 
 		bool CompiledSuccessfully() const { return m_CompilationStatus; }
+		bool UsesBindlessDescriptorSet() const { return m_UsesBindlessDescriptorSet; }
 	private:
 		void Init();
-		bool CompileGLSLShaders(const std::unordered_map<ShaderStage, std::string>& shaderSrc);
-		bool CompileHLSLShaders(const std::unordered_map<ShaderStage, std::string>& shaderSrc);
-		void ReflectShader(const std::vector<uint32_t>& data, ShaderStage stage);
+		bool CompileShaders();
+		bool CompileGLSLStage(ShaderStage stage, const std::string& src, std::vector<uint32_t>& outSpirv, ShaderReflectionData& outReflectionData) const;
+		bool CompileHLSLStage(ShaderStage stage, const std::string& src, std::vector<uint32_t>& outSpirv, ShaderReflectionData& outReflectionData) const;
+		static ShaderReflectionData ReflectShader(const std::vector<uint32_t>& data, ShaderStage stage);
+		void AddReflectionData(const ShaderReflectionData& reflectionData);
 		void CreateDescriptorSetLayouts();
-		void CreateShaderModules(ShaderStage stage, const uint32_t* data, uint32_t size, const std::string& entryPoint);
+		void CreateShaderModule(ShaderStage stage, const std::vector<uint32_t>& spirv, const char* entryPoint);
 		std::unordered_map<ShaderStage, std::string> SplitShaders(const std::string& path);
 
 	private:
@@ -115,8 +170,10 @@ namespace Charon {
 		std::unordered_map<ShaderStage, std::string> m_ShaderSrc;
 
 		bool m_CompilationStatus = false;
+		bool m_UsesBindlessDescriptorSet = false;
 
-		const std::vector<std::wstring>& m_Defines;
+		const std::vector<std::wstring> m_Defines;
+		const ShaderCompileOptions m_CompileOptions;
 
 		std::vector<UniformBufferDescription> m_UniformBufferDescriptions;
 		std::vector<PushConstantRange> m_PushConstantBufferRanges;
@@ -127,6 +184,9 @@ namespace Charon {
 
 		std::vector<VkDescriptorSetLayout> m_DescriptorSetLayouts;
 		std::unordered_map<int, VkDescriptorSetLayout> m_DescriptorSetLayoutMap;
+		std::unordered_map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> m_DescriptorSetLayoutBindings;
+		std::unordered_map<uint32_t, VkDescriptorSetLayout> m_PushDescriptorSetLayouts;
+		std::map<std::tuple<uint32_t, VkPipelineBindPoint, VkPipelineLayout>, VkDescriptorUpdateTemplate> m_PushDescriptorUpdateTemplates;
 		std::vector<VkPipelineShaderStageCreateInfo> m_ShaderCreateInfo;
 	};
 
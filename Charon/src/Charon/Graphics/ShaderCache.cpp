@@ -0,0 +1,298 @@
+#include "pch.h"
+#include "ShaderCache.h"
+#include <fstream>
+#include <thread>
+
+namespace Charon {
+
+	struct ShaderCacheFileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint64_t Key;
+		uint32_t SpirvWordCount;
+	};
+
+	namespace Utils {
+
+		static const uint32_t s_ShaderCacheMagic = 0x43535243; // "CRSC"
+
+		// Bump when the file layout or ShaderReflectionData changes
+		static const uint32_t s_ShaderCacheVersion = 1;
+
+		static const std::filesystem::path s_ShaderCacheDirectory = "cache/shaders";
+
+		static std::filesystem::path GetShaderCachePath(uint64_t key)
+		{
+			char name[32];
+			snprintf(name, sizeof(name), "%016llx.spv", (unsigned long long)key);
+			return s_ShaderCacheDirectory / name;
+		}
+
+		template<typename T>
+		static void Write(std::ostream& stream, const T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			stream.write((const char*)&value, sizeof(T));
+		}
+
+		static void Write(std::ostream& stream, const std::string& string)
+		{
+			Write(stream, (uint32_t)string.size());
+			stream.write(string.data(), string.size());
+		}
+
+		template<typename T>
+		static void Read(std::istream& stream, T& value)
+		{
+			static_assert(std::is_trivially_copyable_v<T>);
+			stream.read((char*)&value, sizeof(T));
+		}
+
+		static void Read(std::istream& stream, std::string& string)
+		{
+			uint32_t size = 0;
+			Read(stream, size);
+			if (!stream.good())
+				return;
+
+			string.resize(size);
+			stream.read(string.data(), size);
+		}
+
+		// Index fields are assigned when descriptor set layouts are created, so they are not stored
+		static void WriteReflection(std::ostream& stream, const ShaderReflectionData& reflection)
+		{
+			Write(stream, reflection.UsesBindlessDescriptorSet);
+
+			Write(stream, (uint32_t)reflection.PushConstantRanges.size());
+			for (const PushConstantRange& range : reflection.PushConstantRanges)
+				Write(stream, range);
+
+			Write(stream, (uint32_t)reflection.UniformBuffers.size());
+			for (const UniformBufferDescription& buffer : reflection.UniformBuffers)
+			{
+				Write(stream, buffer.Name);
+				Write(stream, buffer.Size);
+				Write(stream, buffer.BindingPoint);
+				Write(stream, buffer.DescriptorSetIndex);
+
+				Write(stream, (uint32_t)buffer.Uniforms.size());
+				for (const ShaderUniform& uniform : buffer.Uniforms)
+				{
+					Write(stream, uniform.Name);
+					Write(stream, uniform.Type);
+					Write(stream, uniform.Size);
+					Write(stream, uniform.Offset);
+				}
+			}
+
+			Write(stream, (uint32_t)reflection.StorageBuffers.size());
+			for (const StorageBufferDescription& buffer : reflection.StorageBuffers)
+			{
+				Write(stream, buffer.Name);
+				Write(stream, buffer.BindingPoint);
+				Write(stream, buffer.DescriptorSetIndex);
+			}
+
+			Write(stream, (uint32_t)reflection.Attributes.size());
+			for (const ShaderAttribute& attribute : reflection.Attributes)
+			{
+				Write(stream, attribute.Name);
+				Write(stream, attribute.Type);
+				Write(stream, attribute.Location);
+				Write(stream, attribute.Size);
+				Write(stream, attribute.Offset);
+			}
+
+			Write(stream, (uint32_t)reflection.Resources.size());
+			for (const ShaderResource& resource : reflection.Resources)
+			{
+				Write(stream, resource.Name);
+				Write(stream, resource.Type);
+				Write(stream, resource.BindingPoint);
+				Write(stream, resource.DescriptorSetIndex);
+				Write(stream, resource.Dimension);
+			}
+		}
+
+		static void ReadReflection(std::istream& stream, ShaderReflectionData& reflection)
+		{
+			uint32_t count = 0;
+
+			Read(stream, reflection.UsesBindlessDescriptorSet);
+
+			Read(stream, count);
+			reflection.PushConstantRanges.resize(stream.good() ? count : 0);
+			for (PushConstantRange& range : reflection.PushConstantRanges)
+				Read(stream, range);
+
+			Read(stream, count);
+			reflection.UniformBuffers.resize(stream.good() ? count : 0);
+			for (UniformBufferDescription& buffer : reflection.UniformBuffers)
+			{
+				Read(stream, buffer.Name);
+				Read(stream, buffer.Size);
+				Read(stream, buffer.BindingPoint);
+				Read(stream, buffer.DescriptorSetIndex);
+				buffer.Index = 0;
+
+				Read(stream, count);
+				buffer.Uniforms.resize(stream.good() ? count : 0);
+				for (ShaderUniform& uniform : buffer.Uniforms)
+				{
+					Read(stream, uniform.Name);
+					Read(stream, uniform.Type);
+					Read(stream, uniform.Size);
+					Read(stream, uniform.Offset);
+				}
+			}
+
+			Read(stream, count);
+			reflection.StorageBuffers.resize(stream.good() ? count : 0);
+			for (StorageBufferDescription& buffer : reflection.StorageBuffers)
+			{
+				Read(stream, buffer.Name);
+				Read(stream, buffer.BindingPoint);
+				Read(stream, buffer.DescriptorSetIndex);
+				buffer.Index = 0;
+			}
+
+			Read(stream, count);
+			reflection.Attributes.resize(stream.good() ? count : 0);
+			for (ShaderAttribute& attribute : reflection.Attributes)
+			{
+				Read(stream, attribute.Name);
+				Read(stream, attribute.Type);
+				Read(stream, attribute.Location);
+				Read(stream, attribute.Size);
+				Read(stream, attribute.Offset);
+			}
+
+			Read(stream, count);
+			reflection.Resources.resize(stream.good() ? count : 0);
+			for (ShaderResource& resource : reflection.Resources)
+			{
+				Read(stream, resource.Name);
+				Read(stream, resource.Type);
+				Read(stream, resource.BindingPoint);
+				Read(stream, resource.DescriptorSetIndex);
+				Read(stream, resource.Dimension);
+				resource.Index = 0;
+			}
+		}
+
+		static void HashIncludesRecursive(const std::string& source, const std::filesystem::path& directory, uint64_t& hash, std::unordered_set<std::string>& visited)
+		{
+			std::istringstream stream(source);
+			std::string line;
+			while (std::getline(stream, line))
+			{
+				size_t directive = line.find("#include");
+				if (directive == std::string::npos)
+					continue;
+
+				size_t begin = line.find_first_of("\"<", directive + 8);
+				if (begin == std::string::npos)
+					continue;
+
+				size_t end = line.find_first_of("\">", begin + 1);
+				if (end == std::string::npos)
+					continue;
+
+				std::filesystem::path includePath = directory / line.substr(begin + 1, end - begin - 1);
+				std::string key = includePath.lexically_normal().generic_string();
+				if (!visited.insert(key).second)
+					continue;
+
+				// Missing files still change the hash so that adding one later invalidates the entry
+				hash = ShaderCache::Hash(key, hash);
+
+				std::ifstream file(includePath, std::ios::binary);
+				if (!file.good())
+					continue;
+
+				std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+				hash = ShaderCache::Hash(contents, hash);
+
+				HashIncludesRecursive(contents, includePath.parent_path(), hash, visited);
+			}
+		}
+
+	}
+
+	bool ShaderCache::Load(uint64_t key, std::vector<uint32_t>& outSpirv, ShaderReflectionData& outReflection)
+	{
+		std::ifstream stream(Utils::GetShaderCachePath(key), std::ios::binary);
+		if (!stream.good())
+			return false;
+
+		ShaderCacheFileHeader header = {};
+		Utils::Read(stream, header);
+		if (!stream.good() || header.Magic != Utils::s_ShaderCacheMagic || header.Version != Utils::s_ShaderCacheVersion || header.Key != key)
+			return false;
+
+		outSpirv.resize(header.SpirvWordCount);
+		stream.read((char*)outSpirv.data(), outSpirv.size() * sizeof(uint32_t));
+
+		Utils::ReadReflection(stream, outReflection);
+		return stream.good();
+	}
+
+	void ShaderCache::Store(uint64_t key, const std::vector<uint32_t>& spirv, const ShaderReflectionData& reflection)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(Utils::s_ShaderCacheDirectory, error);
+
+		std::filesystem::path path = Utils::GetShaderCachePath(key);
+
+		// Shaders compile on several threads, so each writer gets its own temporary file
+		std::filesystem::path tempPath = path;
+		tempPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+		{
+			std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+
+			ShaderCacheFileHeader header = {};
+			header.Magic = Utils::s_ShaderCacheMagic;
+			header.Version = Utils::s_ShaderCacheVersion;
+			header.Key = key;
+			header.SpirvWordCount = (uint32_t)spirv.size();
+			Utils::Write(stream, header);
+
+			stream.write((const char*)spirv.data(), spirv.size() * sizeof(uint32_t));
+			Utils::WriteReflection(stream, reflection);
+
+			if (!stream.good())
+			{
+				CR_LOG_WARN("Failed to write shader cache entry {0}", tempPath.string());
+				return;
+			}
+		}
+
+		std::filesystem::rename(tempPath, path, error);
+		if (error)
+			std::filesystem::remove(tempPath, error);
+	}
+
+	uint64_t ShaderCache::Hash(const void* data, size_t size, uint64_t seed)
+	{
+		uint64_t hash = seed;
+		const uint8_t* bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	uint64_t ShaderCache::HashIncludes(const std::string& source, const std::filesystem::path& directory, uint64_t seed)
+	{
+		uint64_t hash = seed;
+		std::unordered_set<std::string> visited;
+		Utils::HashIncludesRecursive(source, directory, hash, visited);
+		return hash;
+	}
+
+}
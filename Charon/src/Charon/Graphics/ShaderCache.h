@@ -0,0 +1,25 @@
+#pragma once
+#include "Charon/Graphics/Shader.h"
+#include <filesystem>
+
+namespace Charon {
+
+	// On-disk cache of compiled shader stages and their reflection, keyed by a hash of everything that affects compilation
+	class ShaderCache
+	{
+	public:
+		static const uint64_t HashSeed = 14695981039346656037ull;
+
+	public:
+		static bool Load(uint64_t key, std::vector<uint32_t>& outSpirv, ShaderReflectionData& outReflection);
+		static void Store(uint64_t key, const std::vector<uint32_t>& spirv, const ShaderReflectionData& reflection);
+
+		// FNV-1a, chain calls by passing the previous hash as seed
+		static uint64_t Hash(const void* data, size_t size, uint64_t seed = HashSeed);
+		static uint64_t Hash(std::string_view string, uint64_t seed = HashSeed) { return Hash(string.data(), string.size(), seed); }
+
+		// Hashes the path and contents of every file reached through #include, resolved relative to the including file
+		static uint64_t HashIncludes(const std::string& source, const std::filesystem::path& directory, uint64_t seed = HashSeed);
+	};
+
+}
@@ -0,0 +1,71 @@
+#include "pch.h"
+#include "ShaderPermutation.h"
+
+namespace Charon {
+
+	ShaderPermutation& ShaderPermutation::Set(uint32_t constantID, bool value)
+	{
+		return SetData(constantID, value ? VK_TRUE : VK_FALSE);
+	}
+
+	ShaderPermutation& ShaderPermutation::Set(uint32_t constantID, int32_t value)
+	{
+		return SetData(constantID, *(uint32_t*)&value);
+	}
+
+	ShaderPermutation& ShaderPermutation::Set(uint32_t constantID, uint32_t value)
+	{
+		return SetData(constantID, value);
+	}
+
+	ShaderPermutation& ShaderPermutation::Set(uint32_t constantID, float value)
+	{
+		return SetData(constantID, *(uint32_t*)&value);
+	}
+
+	const VkSpecializationInfo* ShaderPermutation::GetSpecializationInfo() const
+	{
+		if (m_Entries.empty())
+			return nullptr;
+
+		m_SpecializationInfo.mapEntryCount = (uint32_t)m_Entries.size();
+		m_SpecializationInfo.pMapEntries = m_Entries.data();
+		m_SpecializationInfo.dataSize = m_Data.size() * sizeof(uint32_t);
+		m_SpecializationInfo.pData = m_Data.data();
+		return &m_SpecializationInfo;
+	}
+
+	uint64_t ShaderPermutation::GetHash() const
+	{
+		// FNV-1a over every (id, value) pair
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < m_Entries.size(); i++)
+		{
+			hash ^= ((uint64_t)m_Entries[i].constantID << 32) | m_Data[i];
+			hash *= 1099511628211ull;
+		}
+
+		return hash;
+	}
+
+	ShaderPermutation& ShaderPermutation::SetData(uint32_t constantID, uint32_t data)
+	{
+		auto it = std::lower_bound(m_Entries.begin(), m_Entries.end(), constantID, [](const VkSpecializationMapEntry& entry, uint32_t id) { return entry.constantID < id; });
+		size_t index = it - m_Entries.begin();
+
+		if (it != m_Entries.end() && it->constantID == constantID)
+		{
+			m_Data[index] = data;
+			return *this;
+		}
+
+		// Every constant is 4 bytes (bool, int, uint or float), so entry i reads data word i
+		m_Entries.insert(it, { constantID, 0, sizeof(uint32_t) });
+		m_Data.insert(m_Data.begin() + index, data);
+		for (size_t i = index; i < m_Entries.size(); i++)
+			m_Entries[i].offset = (uint32_t)(i * sizeof(uint32_t));
+
+		return *this;
+	}
+
+}
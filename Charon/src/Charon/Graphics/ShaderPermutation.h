@@ -0,0 +1,79 @@
+#pragma once
+#include "Charon/Core/Core.h"
+#include <vulkan/vulkan.h>
+#include <mutex>
+
+namespace Charon {
+
+	// Values for a shader's specialization constants (layout(constant_id = N)), baked into a pipeline when it is created.
+	// Stages ignore constant ids they don't declare, so one permutation is shared by every stage of a pipeline.
+	class ShaderPermutation
+	{
+	public:
+		ShaderPermutation& Set(uint32_t constantID, bool value);
+		ShaderPermutation& Set(uint32_t constantID, int32_t value);
+		ShaderPermutation& Set(uint32_t constantID, uint32_t value);
+		ShaderPermutation& Set(uint32_t constantID, float value);
+
+		// Points into this permutation, nullptr when nothing is set
+		const VkSpecializationInfo* GetSpecializationInfo() const;
+
+		uint64_t GetHash() const;
+		bool IsEmpty() const { return m_Entries.empty(); }
+	private:
+		ShaderPermutation& SetData(uint32_t constantID, uint32_t data);
+
+	private:
+		// Sorted by constant id so equal permutations hash the same regardless of the order values were set in
+		std::vector<VkSpecializationMapEntry> m_Entries;
+		std::vector<uint32_t> m_Data;
+
+		mutable VkSpecializationInfo m_SpecializationInfo = {};
+	};
+
+	// Pipelines built from the same shaders, keyed by permutation so each permutation is only built once
+	template<typename T>
+	class PipelinePermutationCache
+	{
+	public:
+		using BuildFunction = std::function<Ref<T>(const ShaderPermutation&)>;
+
+		// Builds the permutation on first request, failed builds are not cached. Safe to call from worker threads.
+		Ref<T> Get(const ShaderPermutation& permutation, const BuildFunction& build)
+		{
+			uint64_t hash = permutation.GetHash();
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				auto it = m_Pipelines.find(hash);
+				if (it != m_Pipelines.end())
+					return it->second;
+			}
+
+			// Built outside the lock so different permutations build concurrently
+			Ref<T> pipeline = build(permutation);
+			if (!pipeline)
+				return nullptr;
+
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			return m_Pipelines.try_emplace(hash, pipeline).first->second;
+		}
+
+		// Pipelines still referenced elsewhere stay alive until those references are released
+		void Clear()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Pipelines.clear();
+		}
+
+		uint32_t GetSize()
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			return (uint32_t)m_Pipelines.size();
+		}
+
+	private:
+		std::mutex m_Mutex;
+		std::unordered_map<uint64_t, Ref<T>> m_Pipelines;
+	};
+
+}
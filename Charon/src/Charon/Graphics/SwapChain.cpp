@@ -154,6 +154,12 @@ namespace Charon {
 		VK_CHECK_RESULT(vkWaitForFences(device->GetLogicalDevice(), 1, &m_WaitFences[m_CurrentBufferIndex], VK_TRUE, UINT64_MAX));
 	}
 
+	void SwapChain::WaitForFramesInFlight()
+	{
+		Ref<VulkanDevice> device = Application::GetApp().GetVulkanDevice();
+		VK_CHECK_RESULT(vkWaitForFences(device->GetLogicalDevice(), (uint32_t)m_WaitFences.size(), m_WaitFences.data(), VK_TRUE, UINT64_MAX));
+	}
+
 	void SwapChain::PickDetails()
 	{
 		Ref<VulkanDevice> device = Application::GetApp().GetVulkanDevice();
@@ -21,6 +21,9 @@ namespace Charon {
 		void BeginFrame();
 		void Present();
 
+		// Blocks until every submitted frame has finished on the GPU, the frame being recorded isn't submitted yet
+		void WaitForFramesInFlight();
+
 		inline VkSwapchainKHR GetSwapChainHandle() { return m_SwapChain; }
 		inline VkRenderPass GetRenderPass() { return m_RenderPass; }
 
@@ -1,41 +1,159 @@
 #include "pch.h"
 #include "Texture2D.h"
 #include "Charon/Core/Application.h"
+#include "Charon/Graphics/BindlessDescriptorSet.h"
 #include <stb/stb_image.h>
+#include <atomic>
 
 namespace Charon {
 
+	// Shared with the decoding task, which may finish after the texture is gone
+	struct TextureLoad
+	{
+		uint8_t* Data = nullptr;
+		std::atomic<bool> Done{ false };
+
+		~TextureLoad()
+		{
+			if (Data)
+				stbi_image_free(Data);
+		}
+	};
+
+	// Evicted textures keep a sixteenth of their memory
+	static const uint32_t s_EvictedMipDrop = 2;
+
+	namespace Utils {
+
+		// TODO: Obtain BPP from image format
+		static uint64_t GetImageSize(const ImageSpecification& specification)
+		{
+			uint64_t size = 0;
+			for (uint32_t mip = 0; mip < specification.MipLevels; mip++)
+				size += (uint64_t)glm::max(specification.Width >> mip, 1u) * glm::max(specification.Height >> mip, 1u) * 4;
+
+			return size * specification.LayerCount;
+		}
+
+	}
+
 	Texture2D::Texture2D(const std::filesystem::path& path)
 		: m_Path(path)
+	{
+		m_Image = Load();
+		m_BindlessIndex = BindlessDescriptorSet::RegisterTexture(m_Image->GetDescriptorImageInfo());
+		RegisterMovable();
+
+		m_ResidencyHandle = ResidencyManager::Register(Utils::GetImageSize(m_Image->GetSpecification()),
+			[this]() { return Evict(); },
+			[this]() { return Restore(); });
+	}
+
+	Texture2D::~Texture2D()
+	{
+		ResidencyManager::Unregister(m_ResidencyHandle);
+		VulkanAllocator::UnregisterMovable(m_Image->GetAllocation());
+		BindlessDescriptorSet::ReleaseTexture(m_BindlessIndex);
+	}
+
+	void Texture2D::MarkUsed()
+	{
+		ResidencyManager::MarkUsed(m_ResidencyHandle);
+	}
+
+	Ref<Image> Texture2D::Load()
 	{
 		// Load image from disk
 		int width, height, bpp;
 		stbi_set_flip_vertically_on_load(true);
 
-		std::string pathStr = path.string();
+		std::string pathStr = m_Path.string();
 		uint8_t* data = stbi_load(pathStr.c_str(), &width, &height, &bpp, 4);
 		CR_ASSERT(data, "Failed to load image");
 
 		// Set width and height
 		m_Width = width;
 		m_Height = height;
-		 
-		// Create image
+
+		Ref<Image> image = CreateImage(data);
+
+		// Free CPU memory
+		stbi_image_free(data);
+
+		return image;
+	}
+
+	Ref<Image> Texture2D::CreateImage(uint8_t* data)
+	{
+		// Create image, copied from when evicted
 		ImageSpecification imageSpecification = {};
 		imageSpecification.Data = data;
 		imageSpecification.Width = m_Width;
-		imageSpecification.Height = m_Width;
+		imageSpecification.Height = m_Height;
 		imageSpecification.Format = VK_FORMAT_R8G8B8A8_UNORM;
+		imageSpecification.Usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 		imageSpecification.UseStagingBuffer = true;
+		imageSpecification.DebugName = m_Path.string();
 
-		m_Image = CreateRef<Image>(imageSpecification);
+		return CreateRef<Image>(imageSpecification);
+	}
 
-		// Free CPU memory
-		stbi_image_free(data);
+	void Texture2D::SetImage(Ref<Image> image)
+	{
+		// The old allocation is released with the old image and can't be moved anymore
+		VulkanAllocator::UnregisterMovable(m_Image->GetAllocation());
+
+		m_Image = image;
+		BindlessDescriptorSet::UpdateTexture(m_BindlessIndex, m_Image->GetDescriptorImageInfo());
+		RegisterMovable();
 	}
 
-	Texture2D::~Texture2D()
+	void Texture2D::RegisterMovable()
 	{
+		// Only the bindless slot refers to the image, so a moved image just has to be written to it again
+		VulkanAllocator::RegisterMovable(m_Image->GetAllocation(), [this](VkDeviceMemory memory, VkDeviceSize offset)
+		{
+			m_Image->Rebind(memory, offset);
+			BindlessDescriptorSet::UpdateTexture(m_BindlessIndex, m_Image->GetDescriptorImageInfo());
+		});
+	}
+
+	uint64_t Texture2D::Evict()
+	{
+		// The full image is released once the frames in flight are done with it
+		SetImage(m_Image->CreateReducedCopy(s_EvictedMipDrop));
+
+		return Utils::GetImageSize(m_Image->GetSpecification());
+	}
+
+	uint64_t Texture2D::Restore()
+	{
+		// Only the reduced copy is on the GPU, so the full image is decoded from disk again off the main thread
+		if (!m_PendingLoad)
+		{
+			m_PendingLoad = CreateRef<TextureLoad>();
+			Application::GetApp().GetThreadPool()->Submit([load = m_PendingLoad, path = m_Path.string()]()
+			{
+				int width, height, bpp;
+				stbi_set_flip_vertically_on_load(true);
+				load->Data = stbi_load(path.c_str(), &width, &height, &bpp, 4);
+				load->Done = true;
+			});
+		}
+
+		// The reduced copy stays bound until the full image is uploaded
+		if (!m_PendingLoad->Done)
+			return 0;
+
+		CR_ASSERT(m_PendingLoad->Data, "Failed to load image");
+		Ref<Image> image = CreateImage(m_PendingLoad->Data);
+
+		// Frames in flight sampled the reduced copy through the bindless slot, it can only be rewritten once they are done
+		Application::GetApp().GetVulkanSwapChain()->WaitForFramesInFlight();
+		SetImage(image);
+		m_PendingLoad = nullptr;
+
+		return Utils::GetImageSize(m_Image->GetSpecification());
 	}
 
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "Charon/Asset/Asset.h"
 #include "Charon/Graphics/Image.h"
+#include "Charon/Graphics/ResidencyManager.h"
 #include "Charon/Graphics/VulkanTools.h"
 #include "VulkanAllocator.h"
 #include <string>
@@ -8,20 +9,38 @@
 
 namespace Charon {
 
+	struct TextureLoad;
+
 	class Texture2D : public Asset
 	{
 	public:
 		Texture2D(const std::filesystem::path& path);
 		~Texture2D();
 
+		// Starts bringing the full resolution image back if it was evicted, call before recording anything that samples the texture
+		void MarkUsed();
+
 		inline const VkDescriptorImageInfo& GetDescriptorImageInfo() const { return m_Image->GetDescriptorImageInfo(); }
+		inline uint32_t GetBindlessIndex() const { return m_BindlessIndex; }
+
+	private:
+		Ref<Image> Load();
+		Ref<Image> CreateImage(uint8_t* data);
+		void SetImage(Ref<Image> image);
+		void RegisterMovable();
+
+		uint64_t Evict();
+		uint64_t Restore();
 
 	private:
 		std::filesystem::path m_Path;
 		Ref<Image> m_Image;
+		Ref<TextureLoad> m_PendingLoad; // Decoding on the thread pool while restoring
 
 		uint8_t* m_LocalData = nullptr;
 		uint32_t m_Width = 0, m_Height = 0;
+		uint32_t m_BindlessIndex = 0;
+		ResidencyHandle m_ResidencyHandle = ResidencyManager::InvalidHandle;
 	};
 
 }
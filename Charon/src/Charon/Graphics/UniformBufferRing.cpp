@@ -0,0 +1,110 @@
+#include "pch.h"
+#include "UniformBufferRing.h"
+#include "Charon/Core/Application.h"
+#include "Charon/Graphics/Buffers.h"
+
+namespace Charon {
+
+	struct UniformBufferRingData
+	{
+		BufferInfo Buffer;
+		uint8_t* MappedData = nullptr;
+
+		uint32_t Alignment = 256;
+		uint32_t FrameSize = 0;
+
+		uint32_t FrameIndex = 0;
+		uint32_t Head = 0; // Offset into the current frame's region
+		uint64_t FrameCounter = 0;
+	};
+
+	static UniformBufferRingData* s_Data = nullptr;
+
+	namespace Utils {
+
+		static uint32_t AlignUp(uint32_t value, uint32_t alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+
+	}
+
+	void UniformBufferRing::Init(uint32_t frameSize)
+	{
+		s_Data = new UniformBufferRingData();
+
+		uint32_t framesInFlight = Application::GetApp().GetVulkanSwapChain()->GetFramesInFlight();
+		const VkPhysicalDeviceLimits& limits = Application::GetApp().GetVulkanDevice()->GetProperties().limits;
+
+		// 256 satisfies every desktop GPU, the device limit is only ever smaller but respected in case it isn't
+		s_Data->Alignment = glm::max(256u, (uint32_t)limits.minUniformBufferOffsetAlignment);
+		s_Data->FrameSize = Utils::AlignUp(frameSize, s_Data->Alignment);
+
+		VkBufferCreateInfo bufferCreateInfo = {};
+		bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCreateInfo.size = (VkDeviceSize)s_Data->FrameSize * framesInFlight;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+
+		// Mapped for its whole lifetime, CPU_TO_GPU memory is host coherent so writes need no flush
+		VulkanAllocator allocator("UniformBufferRing");
+		s_Data->Buffer.Allocation = allocator.AllocateBuffer(bufferCreateInfo, VMA_MEMORY_USAGE_CPU_TO_GPU, s_Data->Buffer.Buffer);
+		s_Data->MappedData = allocator.MapMemory<uint8_t>(s_Data->Buffer.Allocation);
+
+		CR_LOG_INFO("Initialized UniformBufferRing; {0} KB per frame, alignment = {1}", s_Data->FrameSize / 1024, s_Data->Alignment);
+	}
+
+	void UniformBufferRing::Shutdown()
+	{
+		VulkanAllocator allocator("UniformBufferRing");
+		allocator.UnmapMemory(s_Data->Buffer.Allocation);
+		allocator.DestroyBuffer(s_Data->Buffer.Buffer, s_Data->Buffer.Allocation);
+
+		delete s_Data;
+		s_Data = nullptr;
+	}
+
+	void UniformBufferRing::BeginFrame(uint32_t frameIndex)
+	{
+		// The GPU is done with this frame slot, so its region can be written again
+		s_Data->FrameIndex = frameIndex;
+		s_Data->Head = 0;
+		s_Data->FrameCounter++;
+	}
+
+	void* UniformBufferRing::Allocate(uint32_t size, uint32_t& outOffset)
+	{
+		uint32_t alignedSize = Utils::AlignUp(size, s_Data->Alignment);
+		if (s_Data->Head + alignedSize > s_Data->FrameSize)
+		{
+			// Anything past the region belongs to a frame the GPU may still be reading, so this fails in every configuration
+			CR_LOG_CRITICAL("UniformBufferRing is full for this frame; requested = {0}, used = {1}/{2}", alignedSize, s_Data->Head, s_Data->FrameSize);
+			std::abort();
+		}
+
+		outOffset = s_Data->FrameIndex * s_Data->FrameSize + s_Data->Head;
+		s_Data->Head += alignedSize;
+
+		return s_Data->MappedData + outOffset;
+	}
+
+	VkBuffer UniformBufferRing::GetBuffer()
+	{
+		return s_Data->Buffer.Buffer;
+	}
+
+	uint32_t UniformBufferRing::GetAlignment()
+	{
+		return s_Data->Alignment;
+	}
+
+	uint64_t UniformBufferRing::GetFrameCounter()
+	{
+		return s_Data->FrameCounter;
+	}
+
+	uint32_t UniformBufferRing::GetFrameUsage()
+	{
+		return s_Data->Head;
+	}
+
+}
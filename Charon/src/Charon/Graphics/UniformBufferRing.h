@@ -0,0 +1,29 @@
+#pragma once
+#include "Charon/Core/Core.h"
+#include <vulkan/vulkan.h>
+
+namespace Charon {
+
+	// One persistently mapped buffer that every UniformBuffer is sub-allocated from, split into a region per frame in flight.
+	// A region is rewound when its frame slot comes around again, so writes never touch memory the GPU may still be reading.
+	// Allocations are only valid for the frame they were made in and must come from the thread recording the frame.
+	class UniformBufferRing
+	{
+	public:
+		static void Init(uint32_t frameSize = 1024 * 1024);
+		static void Shutdown();
+
+		static void BeginFrame(uint32_t frameIndex);
+
+		// Returns the mapped destination for size bytes, outOffset is the offset from the start of the ring buffer
+		static void* Allocate(uint32_t size, uint32_t& outOffset);
+
+		static VkBuffer GetBuffer();
+		static uint32_t GetAlignment();
+
+		// Increments every BeginFrame, lets buffers tell whether their data was written this frame
+		static uint64_t GetFrameCounter();
+		static uint32_t GetFrameUsage();
+	};
+
+}
@@ -2,6 +2,7 @@
 #include "VulkanAccelerationStructure.h"
 
 #include "Charon/Core/Application.h"
+#include "Charon/Graphics/GeometryPool.h"
 
 #include <glm/gtc/type_ptr.hpp>
 
@@ -38,12 +39,11 @@ namespace Charon {
 			// Materials
 			m_MaterialData.reserve(m_Specification.Mesh->GetMaterials().size()); // TODO: per mesh
 			m_Textures.reserve(m_Specification.Mesh->GetTextures().size()); // TODO: per mesh
+			// Texture maps are already global bindless indices
 			for (const auto& material : m_Specification.Mesh->GetMaterials())
-			{
-				MaterialBuffer& buffer = material->GetMaterialBuffer();
-				buffer.AlbedoMap += m_TextureIndexOffset;
-				m_MaterialData.emplace_back(buffer);
-			}
+				m_MaterialData.emplace_back(material->GetMaterialBuffer());
+
+			// Keep the textures alive for as long as the materials reference them
 			for (const auto& texture : m_Specification.Mesh->GetTextures())
 			{
 				m_Textures.emplace_back(texture);
@@ -55,7 +55,6 @@ namespace Charon {
 			m_MaterialDataStorageBuffer->Unmap();
 
 			m_MaterialIndexOffset += m_MaterialData.size();
-			m_TextureIndexOffset += m_Textures.size();
 		}
 
 	}
@@ -75,7 +74,6 @@ namespace Charon {
 
 			SubmeshData& submeshData = m_SubmeshData[i];
 
-			submeshData.BufferIndex = 0; // TODO: when we support multiple Meshes, this needs to be Mesh index (not submesh)
 			submeshData.VertexOffset = submesh.VertexOffset;
 			submeshData.IndexOffset = submesh.IndexOffset;
 			submeshData.MaterialIndex = m_MaterialIndexOffset + submesh.MaterialIndex; // TODO: this is a GLOBAL INDEX for all meshes
@@ -147,7 +145,7 @@ namespace Charon {
 
 		bufferCreateInfo.size = accelerationStructureBuildSizesInfo.buildScratchSize;
 		bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
-		m_TopLevelAccelerationStructure.ScratchMemory = allocator.AllocateBuffer(bufferCreateInfo, VMA_MEMORY_USAGE_GPU_ONLY, m_TopLevelAccelerationStructure.ScratchBuffer);
+		m_TopLevelAccelerationStructure.ScratchMemory = allocator.AllocateBuffer(bufferCreateInfo, VMA_MEMORY_USAGE_GPU_ONLY, m_TopLevelAccelerationStructure.ScratchBuffer, VulkanMemoryPool::Scratch);
 
 		VkAccelerationStructureBuildGeometryInfoKHR accelerationBuildGeometryInfo{};
 		accelerationBuildGeometryInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
@@ -178,6 +176,11 @@ namespace Charon {
 
 		Application::GetApp().GetVulkanDevice()->FlushCommandBuffer(commandBuffer, true);
 
+		// Builds are waited on, so scratch memory goes back to the pool right away
+		allocator.DestroyBuffer(m_TopLevelAccelerationStructure.ScratchBuffer, m_TopLevelAccelerationStructure.ScratchMemory);
+		m_TopLevelAccelerationStructure.ScratchBuffer = nullptr;
+		m_TopLevelAccelerationStructure.ScratchMemory = nullptr;
+
 		VkAccelerationStructureDeviceAddressInfoKHR acceleration_device_address_info{};
 		acceleration_device_address_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
 		acceleration_device_address_info.accelerationStructure = m_TopLevelAccelerationStructure.AccelerationStructure;
@@ -195,18 +198,15 @@ namespace Charon {
 		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
 		VulkanAllocator allocator("AccelerationStructure");
 
-		const auto& vertexBuffer = mesh->GetVertexBuffer();
-		const auto& indexBuffer = mesh->GetIndexBuffer();
-
 		uint32_t primitiveCount = submesh.IndexCount / 3;
 
 		VkAccelerationStructureGeometryTrianglesDataKHR trianglesData{};
 		trianglesData.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-		trianglesData.vertexData.deviceAddress = VulkanAllocator::GetVulkanDeviceAddress(mesh->GetVertexBuffer()->GetBuffer()) + submesh.VertexOffset * sizeof(Vertex); // Modified
+		trianglesData.vertexData.deviceAddress = VulkanAllocator::GetVulkanDeviceAddress(GeometryPool::GetVertexBuffer()) + submesh.VertexOffset * sizeof(Vertex);
 		trianglesData.vertexStride = sizeof(Vertex);
 		trianglesData.maxVertex = submesh.VertexCount;
 		trianglesData.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-		trianglesData.indexData.deviceAddress = VulkanAllocator::GetVulkanDeviceAddress(mesh->GetIndexBuffer()->GetBuffer()) + submesh.IndexOffset * sizeof(uint32_t); // Modified
+		trianglesData.indexData.deviceAddress = VulkanAllocator::GetVulkanDeviceAddress(GeometryPool::GetIndexBuffer()) + submesh.IndexOffset * sizeof(uint32_t);
 		trianglesData.indexType = VK_INDEX_TYPE_UINT32;
 
 		VkAccelerationStructureGeometryDataKHR geometryData{};
@@ -243,7 +243,7 @@ namespace Charon {
 		// ScratchBuffer
 		bufferCreateInfo.size = sizeInfo.buildScratchSize;
 		bufferCreateInfo.usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT; // TODO: do we really need VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
-		outInfo.ScratchMemory = allocator.AllocateBuffer(bufferCreateInfo, VMA_MEMORY_USAGE_GPU_ONLY, outInfo.ScratchBuffer);
+		outInfo.ScratchMemory = allocator.AllocateBuffer(bufferCreateInfo, VMA_MEMORY_USAGE_GPU_ONLY, outInfo.ScratchBuffer, VulkanMemoryPool::Scratch);
 		inputs.scratchData.deviceAddress = VulkanAllocator::GetVulkanDeviceAddress(outInfo.ScratchBuffer); // Modified
 
 		VkAccelerationStructureCreateInfoKHR createInfo{};
@@ -271,6 +271,10 @@ namespace Charon {
 			0, 1, &barrier, 0, nullptr, 0, nullptr);
 
 		Application::GetApp().GetVulkanDevice()->FlushCommandBuffer(commandBuffer, true);
+
+		allocator.DestroyBuffer(outInfo.ScratchBuffer, outInfo.ScratchMemory);
+		outInfo.ScratchBuffer = nullptr;
+		outInfo.ScratchMemory = nullptr;
 	}
 
 }
\ No newline at end of file
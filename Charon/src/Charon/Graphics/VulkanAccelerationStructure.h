@@ -52,7 +52,6 @@ namespace Charon {
 		Ref<StorageBuffer> m_SubmeshDataStorageBuffer;
 		struct SubmeshData
 		{
-			uint32_t BufferIndex;
 			uint32_t VertexOffset;
 			uint32_t IndexOffset;
 			uint32_t MaterialIndex;
@@ -63,7 +62,6 @@ namespace Charon {
 		std::vector<Ref<Texture2D>> m_Textures;
 
 		uint32_t m_MaterialIndexOffset = 0;
-		uint32_t m_TextureIndexOffset = 0;
 	};
 
 }
\ No newline at end of file
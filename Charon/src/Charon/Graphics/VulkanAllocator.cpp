@@ -3,16 +3,274 @@
 #include "VulkanAllocator.h"
 #include "Charon/Core/Application.h"
 #include "Charon/Core/Log.h"
+#include "Charon/Graphics/Image.h"
+#include "Charon/Graphics/ResidencyManager.h"
+#include <mutex>
+#include <array>
 
 namespace Charon {
 
 	struct VulkanAllocatorData
 	{
 		VmaAllocator Allocator;
+
+		// Allocations point at their tag's stats through their user data, map nodes never move
+		std::map<std::string, AllocationStats> TagStats;
+		std::vector<bool> HeapsOverBudget;
+		std::mutex Mutex;
+
+		std::array<VmaPool, (size_t)VulkanMemoryPool::Count> Pools = {};
+		std::array<uint32_t, (size_t)VulkanMemoryPool::Count> PoolMemoryTypes = {};
+		std::map<std::pair<VulkanMemoryPool, VkBufferUsageFlags>, bool> PoolCompatibility;
+
+		std::unordered_map<VmaAllocation, VulkanAllocator::MoveFunction> MovableAllocations;
+		std::unordered_set<VmaAllocation> DefragmentingAllocations;
+		VmaDefragmentationContext DefragmentationContext = nullptr;
+		VmaDefragmentationStats DefragmentationStats = {}; // Written by VMA until the defragmentation ends
+		uint64_t NextDefragmentationCheck = 0;
 	};
 
 	static VulkanAllocatorData* s_Data = nullptr;
 
+	struct MemoryPoolSpecification
+	{
+		const char* Name;
+		VmaMemoryUsage Usage;
+		VkBufferUsageFlags BufferUsage; // Only used to pick the pool's memory type
+		VmaPoolCreateFlags Flags;
+		VkDeviceSize BlockSize;
+		VkDeviceSize MaxAllocationSize;
+	};
+
+	// Indexed by VulkanMemoryPool. Buddy keeps same sized allocations packed, linear is a stack for allocations freed soon after.
+	static const MemoryPoolSpecification s_MemoryPoolSpecifications[] =
+	{
+		{ "Default" },
+		{ "SmallBuffers", VMA_MEMORY_USAGE_CPU_TO_GPU, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_POOL_CREATE_BUDDY_ALGORITHM_BIT, 8 * 1024 * 1024, 256 * 1024 },
+		{ "Scratch", VMA_MEMORY_USAGE_GPU_ONLY, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT, 64 * 1024 * 1024, 64 * 1024 * 1024 },
+		{ "Staging", VMA_MEMORY_USAGE_CPU_ONLY, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT, 64 * 1024 * 1024, 64 * 1024 * 1024 },
+	};
+
+	// Defragmentation starts once a device local heap has this much allocated but unused block memory
+	static const uint64_t s_MinFragmentedBytes = 64 * 1024 * 1024;
+	static const double s_MaxUnusedBlockFraction = 0.25;
+
+	// Every frame that moves something waits for the GPU, so moves are spread out over many frames
+	static const uint32_t s_MaxMovesPerFrame = 4;
+	static const uint64_t s_DefragmentationCheckInterval = 600;
+
+	namespace Utils {
+
+		static AllocationStats* GetTagStats(const std::string& tag)
+		{
+			std::lock_guard<std::mutex> lock(s_Data->Mutex);
+			return &s_Data->TagStats[tag];
+		}
+
+		static void TrackAllocation(VmaAllocation allocation, const std::string& tag)
+		{
+			VmaAllocationInfo allocInfo;
+			vmaGetAllocationInfo(s_Data->Allocator, allocation, &allocInfo);
+			CR_LOG_TRACE("[{0}] - allocating; size = {1}", tag, allocInfo.size);
+
+			std::lock_guard<std::mutex> lock(s_Data->Mutex);
+			AllocationStats& stats = *(AllocationStats*)allocInfo.pUserData;
+			stats.Bytes += allocInfo.size;
+			stats.PeakBytes = std::max(stats.PeakBytes, stats.Bytes);
+			stats.AllocationCount++;
+		}
+
+		static void TrackFree(VmaAllocation allocation)
+		{
+			if (!allocation)
+				return;
+
+			VmaAllocationInfo allocInfo;
+			vmaGetAllocationInfo(s_Data->Allocator, allocation, &allocInfo);
+
+			std::lock_guard<std::mutex> lock(s_Data->Mutex);
+			AllocationStats& stats = *(AllocationStats*)allocInfo.pUserData;
+			stats.Bytes -= allocInfo.size;
+			stats.AllocationCount--;
+		}
+
+		static void LogHeapBudgets()
+		{
+			for (const HeapBudget& heap : VulkanAllocator::GetHeapBudgets())
+				CR_LOG_ERROR("Heap {0}{1}: {2} / {3} MB used", heap.HeapIndex, heap.DeviceLocal ? " (device local)" : "", heap.Usage / (1024 * 1024), heap.Budget / (1024 * 1024));
+		}
+
+		static void CreateMemoryPools(Ref<VulkanDevice> device)
+		{
+			for (size_t i = 1; i < (size_t)VulkanMemoryPool::Count; i++)
+			{
+				const MemoryPoolSpecification& specification = s_MemoryPoolSpecifications[i];
+
+				VkBufferCreateInfo bufferCreateInfo = {};
+				bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+				bufferCreateInfo.size = 1024;
+				bufferCreateInfo.usage = specification.BufferUsage;
+
+				VmaAllocationCreateInfo allocCreateInfo = {};
+				allocCreateInfo.usage = specification.Usage;
+				VK_CHECK_RESULT(vmaFindMemoryTypeIndexForBufferInfo(s_Data->Allocator, &bufferCreateInfo, &allocCreateInfo, &s_Data->PoolMemoryTypes[i]));
+
+				VmaPoolCreateInfo poolCreateInfo = {};
+				poolCreateInfo.memoryTypeIndex = s_Data->PoolMemoryTypes[i];
+				poolCreateInfo.flags = specification.Flags;
+				poolCreateInfo.blockSize = specification.BlockSize;
+
+				// Scratch addresses need a stricter alignment than the buffer's memory requirements report
+				if ((VulkanMemoryPool)i == VulkanMemoryPool::Scratch)
+					poolCreateInfo.minAllocationAlignment = device->GetAccelerationStructureProperties().minAccelerationStructureScratchOffsetAlignment;
+
+				VK_CHECK_RESULT(vmaCreatePool(s_Data->Allocator, &poolCreateInfo, &s_Data->Pools[i]));
+				vmaSetPoolName(s_Data->Allocator, s_Data->Pools[i], specification.Name);
+			}
+		}
+
+		// Returns nullptr when the buffer has to go to the default pools
+		static VmaPool GetMemoryPool(VulkanMemoryPool pool, const VkBufferCreateInfo& bufferCreateInfo, VmaMemoryUsage usage)
+		{
+			const MemoryPoolSpecification& specification = s_MemoryPoolSpecifications[(size_t)pool];
+			if (pool == VulkanMemoryPool::Default || usage != specification.Usage || bufferCreateInfo.size > specification.MaxAllocationSize)
+				return nullptr;
+
+			std::lock_guard<std::mutex> lock(s_Data->Mutex);
+
+			// Buffers with the same usage share their memory type bits, so each usage only has to be checked once
+			auto [it, inserted] = s_Data->PoolCompatibility.try_emplace({ pool, bufferCreateInfo.usage }, false);
+			if (inserted)
+			{
+				VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+
+				VkBuffer buffer;
+				VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer));
+
+				VkMemoryRequirements requirements;
+				vkGetBufferMemoryRequirements(device, buffer, &requirements);
+				vkDestroyBuffer(device, buffer, nullptr);
+
+				it->second = requirements.memoryTypeBits & (1u << s_Data->PoolMemoryTypes[(size_t)pool]);
+			}
+
+			return it->second ? s_Data->Pools[(size_t)pool] : nullptr;
+		}
+
+		static bool IsFragmented()
+		{
+			for (const HeapBudget& heap : VulkanAllocator::GetHeapBudgets())
+			{
+				uint64_t unusedBytes = heap.BlockBytes - heap.AllocationBytes;
+				if (heap.DeviceLocal && unusedBytes >= s_MinFragmentedBytes && unusedBytes > heap.BlockBytes * s_MaxUnusedBlockFraction)
+					return true;
+			}
+
+			return false;
+		}
+
+		static void BeginDefragmentation()
+		{
+			std::vector<VmaAllocation> allocations;
+			{
+				std::lock_guard<std::mutex> lock(s_Data->Mutex);
+				allocations.reserve(s_Data->MovableAllocations.size());
+				for (const auto& [allocation, move] : s_Data->MovableAllocations)
+					allocations.push_back(allocation);
+			}
+
+			if (allocations.empty())
+				return;
+
+			// Moves are only planned here, they are copied by the owners in each pass. Only device memory is compacted, so the
+			// CPU limits stay at zero.
+			VmaDefragmentationInfo2 defragmentationInfo = {};
+			defragmentationInfo.flags = VMA_DEFRAGMENTATION_FLAG_INCREMENTAL;
+			defragmentationInfo.allocationCount = (uint32_t)allocations.size();
+			defragmentationInfo.pAllocations = allocations.data();
+			defragmentationInfo.maxGpuBytesToMove = VK_WHOLE_SIZE;
+			defragmentationInfo.maxGpuAllocationsToMove = UINT32_MAX;
+
+			s_Data->DefragmentationStats = {};
+			VkResult result = vmaDefragmentationBegin(s_Data->Allocator, &defragmentationInfo, &s_Data->DefragmentationStats, &s_Data->DefragmentationContext);
+			if (result != VK_NOT_READY)
+			{
+				vmaDefragmentationEnd(s_Data->Allocator, s_Data->DefragmentationContext);
+				s_Data->DefragmentationContext = nullptr;
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(s_Data->Mutex);
+			s_Data->DefragmentingAllocations.insert(allocations.begin(), allocations.end());
+		}
+
+		// Returns true once every planned move is done
+		static bool RunDefragmentationPass(uint32_t maxMoves)
+		{
+			// A pass never moves more than the allocations taking part
+			{
+				std::lock_guard<std::mutex> lock(s_Data->Mutex);
+				maxMoves = std::min(maxMoves, (uint32_t)s_Data->DefragmentingAllocations.size());
+			}
+
+			std::vector<VmaDefragmentationPassMoveInfo> moves(maxMoves);
+
+			VmaDefragmentationPassInfo passInfo = {};
+			passInfo.moveCount = maxMoves;
+			passInfo.pMoves = moves.data();
+			vmaBeginDefragmentationPass(s_Data->Allocator, s_Data->DefragmentationContext, &passInfo);
+
+			if (passInfo.moveCount > 0)
+			{
+				// Frames in flight may still read the old memory, which is freed when the pass ends
+				VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
+				VK_CHECK_RESULT(vkDeviceWaitIdle(device));
+
+				for (uint32_t i = 0; i < passInfo.moveCount; i++)
+				{
+					VulkanAllocator::MoveFunction move;
+					{
+						std::lock_guard<std::mutex> lock(s_Data->Mutex);
+						move = s_Data->MovableAllocations.at(moves[i].allocation);
+					}
+
+					move(moves[i].memory, moves[i].offset);
+				}
+			}
+
+			return vmaEndDefragmentationPass(s_Data->Allocator, s_Data->DefragmentationContext) == VK_SUCCESS;
+		}
+
+		static void EndDefragmentation()
+		{
+			vmaDefragmentationEnd(s_Data->Allocator, s_Data->DefragmentationContext);
+			s_Data->DefragmentationContext = nullptr;
+
+			{
+				std::lock_guard<std::mutex> lock(s_Data->Mutex);
+				s_Data->DefragmentingAllocations.clear();
+			}
+
+			const VmaDefragmentationStats& stats = s_Data->DefragmentationStats;
+			if (stats.allocationsMoved > 0)
+			{
+				CR_LOG_INFO("Defragmented device memory; moved {0} allocations ({1} MB), freed {2} blocks ({3} MB)",
+					stats.allocationsMoved, stats.bytesMoved / (1024 * 1024), stats.deviceMemoryBlocksFreed, stats.bytesFreed / (1024 * 1024));
+			}
+		}
+
+		static void CheckAllocationResult(VkResult result, const std::string& tag)
+		{
+			if (result == VK_SUCCESS)
+				return;
+
+			CR_LOG_ERROR("[{0}] - allocation failed", tag);
+			LogHeapBudgets();
+			VK_CHECK_RESULT(result);
+		}
+
+	}
+
 	VulkanAllocator::VulkanAllocator(const std::string& tag)
 		: m_Tag(tag)
 	{
@@ -22,19 +280,20 @@ namespace Charon {
 	{
 	}
 
-	VmaAllocation VulkanAllocator::AllocateBuffer(const VkBufferCreateInfo& bufferCreateInfo, VmaMemoryUsage usage, VkBuffer& outBuffer)
+	VmaAllocation VulkanAllocator::AllocateBuffer(const VkBufferCreateInfo& bufferCreateInfo, VmaMemoryUsage usage, VkBuffer& outBuffer, VulkanMemoryPool pool)
 	{
 		VmaAllocationCreateInfo allocCreateInfo = {};
 		allocCreateInfo.usage = usage;
+		allocCreateInfo.pool = Utils::GetMemoryPool(pool, bufferCreateInfo, usage);
+		allocCreateInfo.pUserData = Utils::GetTagStats(m_Tag);
 
 		VmaAllocation allocation;
 		VkResult result = vmaCreateBuffer(s_Data->Allocator, &bufferCreateInfo, &allocCreateInfo, &outBuffer, &allocation, nullptr);
+		if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY && ResidencyManager::MakeRoom(bufferCreateInfo.size))
+			result = vmaCreateBuffer(s_Data->Allocator, &bufferCreateInfo, &allocCreateInfo, &outBuffer, &allocation, nullptr);
+		Utils::CheckAllocationResult(result, m_Tag);
 
-		// Metrics
-		VmaAllocationInfo allocInfo;
-		vmaGetAllocationInfo(s_Data->Allocator, allocation, &allocInfo);
-		CR_LOG_INFO("[{0}] - allocating buffer; size = {1}", m_Tag, allocInfo.size);
-
+		Utils::TrackAllocation(allocation, m_Tag);
 		return allocation;
 	}
 
@@ -42,25 +301,31 @@ namespace Charon {
 	{
 		VmaAllocationCreateInfo allocCreateInfo = {};
 		allocCreateInfo.usage = usage;
+		allocCreateInfo.pUserData = Utils::GetTagStats(m_Tag);
 
 		VmaAllocation allocation;
-		vmaCreateImage(s_Data->Allocator, &imageCreateInfo, &allocCreateInfo, &outImage, &allocation, nullptr);
-
-		// Metrics
-		VmaAllocationInfo allocInfo;
-		vmaGetAllocationInfo(s_Data->Allocator, allocation, &allocInfo);
-		CR_LOG_INFO("[{0}] - allocating image; size = {1}", m_Tag, allocInfo.size);
+		VkResult result = vmaCreateImage(s_Data->Allocator, &imageCreateInfo, &allocCreateInfo, &outImage, &allocation, nullptr);
+		if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY && ResidencyManager::MakeRoom(Image::GetMemoryRequirements(imageCreateInfo).size))
+			result = vmaCreateImage(s_Data->Allocator, &imageCreateInfo, &allocCreateInfo, &outImage, &allocation, nullptr);
+		Utils::CheckAllocationResult(result, m_Tag);
 
+		Utils::TrackAllocation(allocation, m_Tag);
 		return allocation;
 	}
 
 	void VulkanAllocator::DestroyBuffer(VkBuffer buffer, VmaAllocation allocation)
 	{
+		// The handle value can be reused once the buffer is gone
+		Renderer::InvalidateCachedDescriptorSets((uint64_t)buffer);
+		Renderer::ForgetRenderGraphResource((uint64_t)buffer);
+
+		Utils::TrackFree(allocation);
 		vmaDestroyBuffer(s_Data->Allocator, buffer, allocation);
 	}
 
 	void VulkanAllocator::DestroyImage(VkImage image, VmaAllocation allocation)
 	{
+		Utils::TrackFree(allocation);
 		vmaDestroyImage(s_Data->Allocator, image, allocation);
 	}
 
@@ -80,20 +345,122 @@ namespace Charon {
 		allocatorInfo.device = device->GetLogicalDevice();
 		allocatorInfo.instance = Application::GetApp().GetVulkanInstance()->GetInstanceHandle();
 		allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+		if (device->IsMemoryBudgetSupported())
+			allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
 
 		vmaCreateAllocator(&allocatorInfo, &s_Data->Allocator);
+		Utils::CreateMemoryPools(device);
+
+		const VkPhysicalDeviceMemoryProperties* memoryProperties;
+		vmaGetMemoryProperties(s_Data->Allocator, &memoryProperties);
+		s_Data->HeapsOverBudget.resize(memoryProperties->memoryHeapCount, false);
 
-		CR_LOG_INFO("Initialized VMA");
+		CR_LOG_INFO("Initialized VMA; memory budget = {0}", device->IsMemoryBudgetSupported() ? "VK_EXT_memory_budget" : "estimated");
 	}
 
 	void VulkanAllocator::Shutdown()
 	{
+		if (s_Data->DefragmentationContext)
+			vmaDefragmentationEnd(s_Data->Allocator, s_Data->DefragmentationContext);
+
+		for (VmaPool pool : s_Data->Pools)
+		{
+			if (pool)
+				vmaDestroyPool(s_Data->Allocator, pool);
+		}
+
 		vmaDestroyAllocator(s_Data->Allocator);
 
 		delete s_Data;
 		s_Data = nullptr;
 	}
 
+	void VulkanAllocator::BeginFrame(uint64_t frame)
+	{
+		// VMA only re-fetches the budget from the driver when the frame index changes
+		vmaSetCurrentFrameIndex(s_Data->Allocator, (uint32_t)frame);
+
+		// Warn once per heap each time it goes over, allocating past the budget may fail or page to system memory
+		for (const HeapBudget& heap : GetHeapBudgets())
+		{
+			bool overBudget = heap.Usage > heap.Budget;
+			if (overBudget && !s_Data->HeapsOverBudget[heap.HeapIndex])
+				CR_LOG_WARN("Memory heap {0} is over budget; {1} / {2} MB used", heap.HeapIndex, heap.Usage / (1024 * 1024), heap.Budget / (1024 * 1024));
+
+			s_Data->HeapsOverBudget[heap.HeapIndex] = overBudget;
+		}
+
+		// Resizing and reloading leave holes between long lived allocations, which eventually makes large allocations fail
+		if (s_Data->DefragmentationContext)
+		{
+			if (Utils::RunDefragmentationPass(s_MaxMovesPerFrame))
+				Utils::EndDefragmentation();
+		}
+		else if (frame >= s_Data->NextDefragmentationCheck)
+		{
+			s_Data->NextDefragmentationCheck = frame + s_DefragmentationCheckInterval;
+			if (Utils::IsFragmented())
+				Utils::BeginDefragmentation();
+		}
+	}
+
+	void VulkanAllocator::RegisterMovable(VmaAllocation allocation, MoveFunction move)
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+		s_Data->MovableAllocations[allocation] = move;
+	}
+
+	void VulkanAllocator::UnregisterMovable(VmaAllocation allocation)
+	{
+		bool defragmenting;
+		{
+			std::lock_guard<std::mutex> lock(s_Data->Mutex);
+			defragmenting = s_Data->DefragmentingAllocations.count(allocation) > 0;
+		}
+
+		// VMA keeps the planned moves until the end, so the allocation can only be freed once they are all done
+		if (defragmenting)
+		{
+			// A pass can hand out only part of the remaining moves, so run them until VMA reports none left
+			while (!Utils::RunDefragmentationPass(UINT32_MAX))
+				continue;
+			Utils::EndDefragmentation();
+		}
+
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+		s_Data->MovableAllocations.erase(allocation);
+	}
+
+	std::vector<HeapBudget> VulkanAllocator::GetHeapBudgets()
+	{
+		const VkPhysicalDeviceMemoryProperties* memoryProperties;
+		vmaGetMemoryProperties(s_Data->Allocator, &memoryProperties);
+
+		VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+		vmaGetBudget(s_Data->Allocator, budgets);
+
+		std::vector<HeapBudget> heaps(memoryProperties->memoryHeapCount);
+		for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++)
+		{
+			HeapBudget& heap = heaps[i];
+			heap.HeapIndex = i;
+			heap.DeviceLocal = memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+			heap.Size = memoryProperties->memoryHeaps[i].size;
+			heap.Usage = budgets[i].usage;
+			heap.Budget = budgets[i].budget;
+			heap.BlockBytes = budgets[i].blockBytes;
+			heap.AllocationBytes = budgets[i].allocationBytes;
+		}
+
+		return heaps;
+	}
+
+	std::map<std::string, AllocationStats> VulkanAllocator::GetAllocationStats()
+	{
+		std::lock_guard<std::mutex> lock(s_Data->Mutex);
+		return s_Data->TagStats;
+	}
+
 	VmaAllocator& VulkanAllocator::GetVMAAllocator()
 	{
 		return s_Data->Allocator;
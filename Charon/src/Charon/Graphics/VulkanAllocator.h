@@ -2,17 +2,53 @@
 #include "Charon/Core/Core.h"
 #include "VulkanDevice.h"
 #include <vk_mem_alloc.h>
+#include <functional>
 
 namespace Charon {
 
+	// Memory currently allocated through allocators created with the same tag
+	struct AllocationStats
+	{
+		uint64_t Bytes = 0;
+		uint64_t PeakBytes = 0;
+		uint32_t AllocationCount = 0;
+	};
+
+	// Usage and budget come from VK_EXT_memory_budget when the device supports it, otherwise they are VMA's estimate
+	struct HeapBudget
+	{
+		uint32_t HeapIndex = 0;
+		bool DeviceLocal = false;
+		uint64_t Size = 0;
+		uint64_t Usage = 0;
+		uint64_t Budget = 0;
+		uint64_t BlockBytes = 0;      // Device memory allocated by VMA
+		uint64_t AllocationBytes = 0; // Sub-allocated from those blocks
+	};
+
+	// Dedicated VMA pools for small or short lived buffers, so they don't fragment the default pools. Allocations that are too
+	// large for the pool or need a different memory type fall back to the default pools.
+	enum class VulkanMemoryPool
+	{
+		Default = 0,
+		SmallBuffers, // Buddy, CPU_TO_GPU buffers up to 256 KB. Sizes round up to a power of two.
+		Scratch,      // Linear, GPU_ONLY acceleration structure build scratch, freed right after the build
+		Staging,      // Linear, CPU_ONLY upload buffers, freed right after the copy
+		Count
+	};
+
 	class VulkanAllocator
 	{
+	public:
+		// Binds a new resource at memory + offset, copies the old one into it and swaps it in, including any descriptors.
+		// Called with the GPU idle, the old memory is released once the defragmentation pass ends.
+		using MoveFunction = std::function<void(VkDeviceMemory memory, VkDeviceSize offset)>;
 	public:
 		VulkanAllocator(const std::string& tag);
 		~VulkanAllocator();
 	
 	public:
-		VmaAllocation AllocateBuffer(const VkBufferCreateInfo& bufferCreateInfo, VmaMemoryUsage usage, VkBuffer& outBuffer);
+		VmaAllocation AllocateBuffer(const VkBufferCreateInfo& bufferCreateInfo, VmaMemoryUsage usage, VkBuffer& outBuffer, VulkanMemoryPool pool = VulkanMemoryPool::Default);
 		VmaAllocation AllocateImage(const VkImageCreateInfo& imageCreateInfo, VmaMemoryUsage usage, VkImage& outImage);
 
 		void DestroyBuffer(VkBuffer buffer, VmaAllocation allocation);
@@ -32,6 +68,18 @@ namespace Charon {
 		static void Init(Ref<VulkanDevice> device);
 		static void Shutdown();
 
+		// Refreshes the heap budgets and warns when a heap goes over budget. While device memory is fragmented, moves a few
+		// movable allocations per frame to compact it.
+		static void BeginFrame(uint64_t frame);
+
+		// Only allocations registered as movable are moved by defragmentation, everything else stays where it is.
+		// Unregister before freeing the allocation, a defragmentation that includes it is finished first.
+		static void RegisterMovable(VmaAllocation allocation, MoveFunction move);
+		static void UnregisterMovable(VmaAllocation allocation);
+
+		static std::vector<HeapBudget> GetHeapBudgets();
+		static std::map<std::string, AllocationStats> GetAllocationStats();
+
 		static VmaAllocator& GetVMAAllocator();
 
 		static uint64_t GetVulkanDeviceAddress(VkBuffer handle);
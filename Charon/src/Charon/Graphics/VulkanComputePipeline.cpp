@@ -2,11 +2,13 @@
 #include "VulkanComputePipeline.h"
 #include "Charon/Core/Application.h"
 #include "Charon/Graphics/VulkanTools.h"
+#include "Charon/Graphics/LayoutCache.h"
+#include "Charon/Graphics/PipelineCache.h"
 
 namespace Charon {
 
-	VulkanComputePipeline::VulkanComputePipeline(Ref<Shader> shader, VkPipelineLayout layout)
-		:  m_Shader(shader), m_PipelineLayout(layout)
+	VulkanComputePipeline::VulkanComputePipeline(Ref<Shader> shader, VkPipelineLayout layout, int32_t pushDescriptorSet, const ShaderPermutation& permutation)
+		:  m_Shader(shader), m_PipelineLayout(layout), m_PushDescriptorSet(pushDescriptorSet), m_Permutation(permutation)
 	{
 		Init();
 		CR_LOG_INFO("Initialized Vulkan compute pipeline");
@@ -17,23 +19,17 @@ namespace Charon {
 		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
 
 		vkDestroyPipeline(device, m_Pipeline, nullptr);
-		if (m_OwnLayout)
-			vkDestroyPipelineLayout(device, m_PipelineLayout, nullptr);
 	}
 
 	void VulkanComputePipeline::Init()
 	{
 		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
 
-		const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts = m_Shader->GetDescriptorSetLayouts();
-
 		if (!m_PipelineLayout)
 		{
-			// Set pipeline layout
-			VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-			pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-			pipelineLayoutInfo.setLayoutCount = descriptorSetLayouts.size();
-			pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+			std::vector<VkDescriptorSetLayout> descriptorSetLayouts = m_Shader->GetDescriptorSetLayouts();
+			if (m_PushDescriptorSet >= 0)
+				descriptorSetLayouts[m_PushDescriptorSet] = m_Shader->GetPushDescriptorSetLayout(m_PushDescriptorSet);
 
 			const auto& pushConstantRanges = m_Shader->GetPushConstantRanges();
 			std::vector<VkPushConstantRange> vulkanPushConstantRanges;
@@ -46,11 +42,12 @@ namespace Charon {
 				pcr.size = pushConstangeRange.Size;
 			}
 
-			pipelineLayoutInfo.pushConstantRangeCount = (uint32_t)vulkanPushConstantRanges.size();
-			pipelineLayoutInfo.pPushConstantRanges = vulkanPushConstantRanges.data();
-
-			VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout));
-			m_OwnLayout = true;
+			// Shared with every other pipeline built from the same layouts
+			m_PipelineLayout = LayoutCache::GetPipelineLayout(descriptorSetLayouts, vulkanPushConstantRanges);
+		}
+		else
+		{
+			CR_ASSERT(m_PushDescriptorSet < 0, "Push descriptor sets need a pipeline layout created from the shader");
 		}
 
 		// Create compute pipeline
@@ -58,7 +55,16 @@ namespace Charon {
 		computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
 		computePipelineCreateInfo.layout = m_PipelineLayout;
 		computePipelineCreateInfo.stage = m_Shader->GetShaderCreateInfo()[0]; // TODO: Check to make sure to get right stage for compute
-		VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &m_Pipeline));
+		computePipelineCreateInfo.stage.pSpecializationInfo = m_Permutation.GetSpecializationInfo();
+		VK_CHECK_RESULT(vkCreateComputePipelines(device, PipelineCache::GetPipelineCache(), 1, &computePipelineCreateInfo, nullptr, &m_Pipeline));
+	}
+
+	void VulkanComputePipeline::PushDescriptorSet(VkCommandBuffer commandBuffer, const DescriptorInfo* descriptors)
+	{
+		CR_ASSERT(m_PushDescriptorSet >= 0, "Pipeline was not created with a push descriptor set");
+
+		VkDescriptorUpdateTemplate updateTemplate = m_Shader->GetPushDescriptorUpdateTemplate(m_PushDescriptorSet, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout);
+		vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, updateTemplate, m_PipelineLayout, m_PushDescriptorSet, descriptors);
 	}
 
 }
\ No newline at end of file
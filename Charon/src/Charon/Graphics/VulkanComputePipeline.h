@@ -1,5 +1,6 @@
 #pragma once
 #include "Charon/Graphics/Shader.h"
+#include "Charon/Graphics/ShaderPermutation.h"
 #include <vulkan/vulkan.h>
 
 namespace Charon {
@@ -7,13 +8,17 @@ namespace Charon {
 	class VulkanComputePipeline
 	{
 	public:
-		VulkanComputePipeline(Ref<Shader> Shader, VkPipelineLayout layout = nullptr);
+		// pushDescriptorSet >= 0 creates that set as a push descriptor set, which is written with PushDescriptorSet instead of being allocated
+		VulkanComputePipeline(Ref<Shader> Shader, VkPipelineLayout layout = nullptr, int32_t pushDescriptorSet = -1, const ShaderPermutation& permutation = {});
 		~VulkanComputePipeline();
 
 	public:
 		inline VkPipeline GetPipeline() { return m_Pipeline; }
 		inline VkPipelineLayout GetPipelineLayout() { return m_PipelineLayout; }
 
+		// Data is a DescriptorInfo array indexed by binding
+		void PushDescriptorSet(VkCommandBuffer commandBuffer, const DescriptorInfo* descriptors);
+
 	private:
 		void Init();
 
@@ -21,8 +26,9 @@ namespace Charon {
 		VkPipeline m_Pipeline = nullptr;
 		VkPipelineLayout m_PipelineLayout = nullptr;
 
-		bool m_OwnLayout = false;
+		int32_t m_PushDescriptorSet = -1;
 		Ref<Shader> m_Shader;
+		ShaderPermutation m_Permutation;
 	};
 
 }
\ No newline at end of file
@@ -7,7 +7,7 @@
 
 static std::vector<const char*> s_DeviceExtensions =
 {
-	VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_SHADER_ATOMIC_INT64_EXTENSION_NAME
+	VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_SHADER_ATOMIC_INT64_EXTENSION_NAME, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME
 };
 
 namespace Charon {
@@ -80,6 +80,10 @@ namespace Charon {
 		v12Features.descriptorBindingPartiallyBound = true;
 		v12Features.descriptorIndexing = true;
 		v12Features.runtimeDescriptorArray = true;
+		v12Features.shaderSampledImageArrayNonUniformIndexing = true;
+		v12Features.descriptorBindingSampledImageUpdateAfterBind = true;
+		v12Features.descriptorBindingUpdateUnusedWhilePending = true;
+		v12Features.drawIndirectCount = true;
 		v12Features.bufferDeviceAddress = true;
 
 #define RTX 1
@@ -130,9 +134,15 @@ namespace Charon {
 		s_DeviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
 #endif
 
+		// Optional, without it VMA estimates heap usage and budget from its own allocations
+		m_MemoryBudgetSupported = IsExtensionSupported(m_PhysicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (m_MemoryBudgetSupported)
+			s_DeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
 		// Required device features
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.multiDrawIndirect = VK_TRUE;
 
 		// Logical device info
 		VkDeviceCreateInfo createInfo{};
@@ -264,6 +274,17 @@ namespace Charon {
 		return requiredExtensions.empty();
 	}
 
+	bool VulkanDevice::IsExtensionSupported(VkPhysicalDevice device, const char* extensionName)
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+		return std::any_of(availableExtensions.begin(), availableExtensions.end(), [&](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, extensionName) == 0; });
+	}
+
 	QueueFamilyIndices VulkanDevice::FindQueueIndices(VkPhysicalDevice device)
 	{
 		// Get queue family info
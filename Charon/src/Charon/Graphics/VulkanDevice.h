@@ -42,12 +42,16 @@ namespace Charon {
 		inline SwapChainSupportDetails GetSwapChainSupportDetails() { return m_SwapChainSupportDetails; }
 		SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device);
 
+		const VkPhysicalDeviceProperties& GetProperties() const { return m_PhysicalDeviceProperties.properties; }
+		bool IsMemoryBudgetSupported() const { return m_MemoryBudgetSupported; }
 		const VkPhysicalDeviceRayTracingPipelinePropertiesKHR& GetRayTracingPipelineProperties() const { return m_RayTracingPipelineProperties; }
+		const VkPhysicalDeviceAccelerationStructurePropertiesKHR& GetAccelerationStructureProperties() const { return m_AccelerationStructureProperties; }
 	private:
 		void Init();
 
 		bool IsDeviceSuitable(VkPhysicalDevice device);
 		bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+		bool IsExtensionSupported(VkPhysicalDevice device, const char* extensionName);
 		QueueFamilyIndices FindQueueIndices(VkPhysicalDevice device);
 	private:
 		VkPhysicalDevice m_PhysicalDevice = nullptr;
@@ -58,6 +62,7 @@ namespace Charon {
 		VkQueue m_GraphicsQueue = nullptr;
 		VkQueue m_PresentQueue = nullptr;
 		VkPhysicalDeviceProperties2 m_PhysicalDeviceProperties;
+		bool m_MemoryBudgetSupported = false;
 
 		SwapChainSupportDetails m_SwapChainSupportDetails;
 		QueueFamilyIndices m_QueueIndices;
@@ -273,6 +273,34 @@ VKAPI_ATTR void VKAPI_CALL vkCmdSetRayTracingPipelineStackSizeKHR(
     return gvkCmdSetRayTracingPipelineStackSizeKHR(commandBuffer, pipelineStackSize);
 }
 
+//----------------------------------------------------------------------------------------------------------
+// Push Descriptor Extension
+//----------------------------------------------------------------------------------------------------------
+
+PFN_vkCmdPushDescriptorSetKHR                         gvkCmdPushDescriptorSetKHR;
+PFN_vkCmdPushDescriptorSetWithTemplateKHR             gvkCmdPushDescriptorSetWithTemplateKHR;
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPushDescriptorSetKHR(
+    VkCommandBuffer commandBuffer,
+    VkPipelineBindPoint pipelineBindPoint,
+    VkPipelineLayout layout,
+    uint32_t set,
+    uint32_t descriptorWriteCount,
+    const VkWriteDescriptorSet* pDescriptorWrites)
+{
+    gvkCmdPushDescriptorSetKHR(commandBuffer, pipelineBindPoint, layout, set, descriptorWriteCount, pDescriptorWrites);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPushDescriptorSetWithTemplateKHR(
+    VkCommandBuffer commandBuffer,
+    VkDescriptorUpdateTemplate descriptorUpdateTemplate,
+    VkPipelineLayout layout,
+    uint32_t set,
+    const void* pData)
+{
+    gvkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, descriptorUpdateTemplate, layout, set, pData);
+}
+
 //----------------------------------------------------------------------------------------------------------
 // Debug Utils Extension
 //----------------------------------------------------------------------------------------------------------
@@ -405,6 +433,10 @@ namespace Charon {
         LOAD_DEVICE_PROC(vkGetRayTracingShaderGroupStackSizeKHR)
         LOAD_DEVICE_PROC(vkCmdSetRayTracingPipelineStackSizeKHR)
 
+        // Push Descriptor extension entry points
+        LOAD_DEVICE_PROC(vkCmdPushDescriptorSetKHR)
+        LOAD_DEVICE_PROC(vkCmdPushDescriptorSetWithTemplateKHR)
+
         // Debug Utils extension entry points
         LOAD_DEVICE_PROC(vkSetDebugUtilsObjectNameEXT)
         LOAD_DEVICE_PROC(vkSetDebugUtilsObjectTagEXT)
@@ -2,6 +2,8 @@
 #include "VulkanPipeline.h"
 #include "Charon/Core/Application.h"
 #include "Charon/Graphics/VulkanTools.h"
+#include "Charon/Graphics/LayoutCache.h"
+#include "Charon/Graphics/PipelineCache.h"
 
 namespace Charon {
 
@@ -11,8 +13,10 @@ namespace Charon {
 		VK_DYNAMIC_STATE_LINE_WIDTH
 	};
 
+	static uint32_t s_NextPipelineID = 0;
+
 	VulkanPipeline::VulkanPipeline(const PipelineSpecification& specification)
-		: m_Specification(specification)
+		: m_Specification(specification), m_ID(s_NextPipelineID++)
 	{
 		Init();
 		CR_LOG_INFO("Initialized Vulkan pipeline");
@@ -23,7 +27,6 @@ namespace Charon {
 		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
 
 		vkDestroyPipeline(device, m_Pipeline, nullptr);
-		vkDestroyPipelineLayout(device, m_PipelineLayout, nullptr);
 	}
 
 	void VulkanPipeline::Init()
@@ -143,14 +146,7 @@ namespace Charon {
 		// Set pipeline layout
 		const std::vector<VkDescriptorSetLayout>& descriptorSetLayouts = m_Specification.Shader->GetDescriptorSetLayouts();
 
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = descriptorSetLayouts.size();
-		pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-		pipelineLayoutInfo.pushConstantRangeCount = 1;    
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange; 
-
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout));
+		m_PipelineLayout = LayoutCache::GetPipelineLayout(descriptorSetLayouts, { pushConstantRange });
 
 		// Set depth test
 		VkPipelineDepthStencilStateCreateInfo depthStencilState = {};
@@ -165,7 +161,9 @@ namespace Charon {
 		depthStencilState.stencilTestEnable = VK_FALSE;
 		depthStencilState.front = depthStencilState.back;
 
-		const std::vector<VkPipelineShaderStageCreateInfo>& shaderCreateInfo = m_Specification.Shader->GetShaderCreateInfo();
+		std::vector<VkPipelineShaderStageCreateInfo> shaderCreateInfo = m_Specification.Shader->GetShaderCreateInfo();
+		for (VkPipelineShaderStageCreateInfo& stage : shaderCreateInfo)
+			stage.pSpecializationInfo = m_Specification.Permutation.GetSpecializationInfo();
 
 		// Create pipeline
 		VkGraphicsPipelineCreateInfo pipelineInfo{};
@@ -186,7 +184,7 @@ namespace Charon {
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; 
 		pipelineInfo.basePipelineIndex = -1;              
 
-		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_Pipeline));
+		VK_CHECK_RESULT(vkCreateGraphicsPipelines(device, PipelineCache::GetPipelineCache(), 1, &pipelineInfo, nullptr, &m_Pipeline));
 	}
 
 }
\ No newline at end of file
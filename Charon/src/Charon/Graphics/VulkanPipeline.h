@@ -1,6 +1,7 @@
 #pragma once
 #include "Charon/Graphics/Shader.h"
 #include "Charon/Graphics/VertexBufferLayout.h"
+#include "Charon/Graphics/ShaderPermutation.h"
 #include <vulkan/vulkan.h>
 
 namespace Charon {
@@ -11,6 +12,7 @@ namespace Charon {
 		VertexBufferLayout* Layout = nullptr;
 		VkRenderPass TargetRenderPass = nullptr;
 		bool WriteDepth = true;
+		ShaderPermutation Permutation;
 	};
 
 	class VulkanPipeline
@@ -23,6 +25,9 @@ namespace Charon {
 		inline VkPipeline GetPipeline() { return m_Pipeline; }
 		inline VkPipelineLayout GetPipelineLayout() { return m_PipelineLayout; }
 
+		// Unique per pipeline and never reused, used to sort draws by pipeline
+		inline uint32_t GetID() const { return m_ID; }
+
 	private:
 		void Init();
 
@@ -31,6 +36,7 @@ namespace Charon {
 
 		VkPipeline m_Pipeline = nullptr;
 		VkPipelineLayout m_PipelineLayout = nullptr;
+		uint32_t m_ID = 0;
 	};
 
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 #include "VulkanRayTracingPipeline.h"
 #include "Charon/Core/Application.h"
 #include "Charon/Graphics/VulkanTools.h"
+#include "Charon/Graphics/BindlessDescriptorSet.h"
+#include "Charon/Graphics/LayoutCache.h"
+#include "Charon/Graphics/PipelineCache.h"
 
 namespace Charon {
 
@@ -64,12 +67,11 @@ namespace Charon {
 	VulkanRayTracingPipeline::~VulkanRayTracingPipeline()
 	{
 		Ref<Renderer> renderer = Application::GetApp().GetRenderer();
-		renderer->SubmitResourceFree([pipeline = m_Pipeline, ownLayout = m_OwnLayout, pipelineLayout = m_PipelineLayout]()
+		renderer->SubmitResourceFree([pipeline = m_Pipeline, updateTemplate = m_DescriptorUpdateTemplate]()
 		{
 			VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
 			vkDestroyPipeline(device, pipeline, nullptr);
-			if (ownLayout)
-				vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorUpdateTemplate(device, updateTemplate, nullptr);
 		});
 	}
 
@@ -77,63 +79,44 @@ namespace Charon {
 	{
 		VkDevice device = Application::GetApp().GetVulkanDevice()->GetLogicalDevice();
 
-		// TODO: retrieve caps
-		const uint32_t MaxStorageBufferDescriptorCount = 2048;
-
-		std::array<VkDescriptorSetLayoutBinding, 10> layoutBindings = {
-			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 0),
-			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 1),
-			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 2),
-			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 3),
-			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 4, MaxStorageBufferDescriptorCount),
-			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 5, MaxStorageBufferDescriptorCount),
-			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 6),
-			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 7),
-			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 8),
-			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 9, MaxStorageBufferDescriptorCount),
+		std::array<VkDescriptorSetLayoutBinding, 9> layoutBindings = {
+			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 0), // Acceleration Structure
+			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 1), // Storage Image
+			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 2), // Storage Image
+			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 3), // Camera Uniform Buffer
+			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 4), // Geometry Pool Vertex Buffer
+			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 5), // Geometry Pool Index Buffer
+			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 6), // Submesh Data
+			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 7), // Scene Buffer
+			Utils::DescriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, 8), // Material Buffer
 		};
 
-		// TODO: flags (for bindless)
+		// Everything in set 0 changes per dispatch, so it is pushed rather than allocated
+		m_DescriptorSetLayout = LayoutCache::GetDescriptorSetLayout({ layoutBindings.begin(), layoutBindings.end() }, VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
 
-		std::array<VkDescriptorBindingFlags, layoutBindings.size()> bindingFlags =
-		{
-			0, // Binding 0: Acceleration Structure
-			0, // Binding 1: Storage Image
-			0, // Binding 2: Storage Image
-			0, // Binding 3: Camera Uniform Buffer
-			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT, // Binding 4: Vertex Buffers
-			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT, // Binding 5: Index Buffers
-			0, // Binding 6: Submesh Data
-			0, // Binding 7: Scene Buffer
-			0,  // Binding 8: Material Buffer
-			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT, // Binding 9: Textures
-		};
+		// Textures come from the global bindless set
+		static_assert(BindlessDescriptorSet::SetIndex == 1, "Ray tracing pipeline layout expects the bindless set at index 1");
+		m_PipelineLayout = LayoutCache::GetPipelineLayout({ m_DescriptorSetLayout, BindlessDescriptorSet::GetDescriptorSetLayout() });
+
+		std::vector<VkDescriptorUpdateTemplateEntry> templateEntries = Shader::GetDescriptorUpdateTemplateEntries({ layoutBindings.begin(), layoutBindings.end() });
 
-		VkDescriptorSetLayoutBindingFlagsCreateInfo descriptorSetLayoutBindingsCreateInfo{};
-		descriptorSetLayoutBindingsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
-		descriptorSetLayoutBindingsCreateInfo.pBindingFlags = bindingFlags.data();
-		descriptorSetLayoutBindingsCreateInfo.bindingCount = (uint32_t)bindingFlags.size();
-		
-		VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{};
-		descriptorSetLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		descriptorSetLayoutCreateInfo.pNext = &descriptorSetLayoutBindingsCreateInfo;
-		descriptorSetLayoutCreateInfo.pBindings = layoutBindings.data();
-		descriptorSetLayoutCreateInfo.bindingCount = (uint32_t)layoutBindings.size();
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &m_DescriptorSetLayout));
-
-		VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
-		pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutCreateInfo.setLayoutCount = 1;
-		pipelineLayoutCreateInfo.pSetLayouts = &m_DescriptorSetLayout;
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &m_PipelineLayout));
+		VkDescriptorUpdateTemplateCreateInfo templateCreateInfo{};
+		templateCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+		templateCreateInfo.descriptorUpdateEntryCount = (uint32_t)templateEntries.size();
+		templateCreateInfo.pDescriptorUpdateEntries = templateEntries.data();
+		templateCreateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR;
+		templateCreateInfo.pipelineBindPoint = VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR;
+		templateCreateInfo.pipelineLayout = m_PipelineLayout;
+		templateCreateInfo.set = 0;
+		VK_CHECK_RESULT(vkCreateDescriptorUpdateTemplate(device, &templateCreateInfo, nullptr, &m_DescriptorUpdateTemplate));
 
 		std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
 		std::vector<VkRayTracingShaderGroupCreateInfoKHR> shaderGroups;
 
 		if (m_Specification.RayGenShader)
 		{
-			const VkPipelineShaderStageCreateInfo& shaderStage = m_Specification.RayGenShader->GetShaderCreateInfo()[0];
-			shaderStages.emplace_back(shaderStage);
+			VkPipelineShaderStageCreateInfo& shaderStage = shaderStages.emplace_back(m_Specification.RayGenShader->GetShaderCreateInfo()[0]);
+			shaderStage.pSpecializationInfo = m_Specification.Permutation.GetSpecializationInfo();
 
 			VkRayTracingShaderGroupCreateInfoKHR& shaderGroup = shaderGroups.emplace_back();
 			shaderGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
@@ -148,8 +131,8 @@ namespace Charon {
 
 		if (m_Specification.MissShader)
 		{
-			const VkPipelineShaderStageCreateInfo& shaderStage = m_Specification.MissShader->GetShaderCreateInfo()[0];
-			shaderStages.emplace_back(shaderStage);
+			VkPipelineShaderStageCreateInfo& shaderStage = shaderStages.emplace_back(m_Specification.MissShader->GetShaderCreateInfo()[0]);
+			shaderStage.pSpecializationInfo = m_Specification.Permutation.GetSpecializationInfo();
 
 			VkRayTracingShaderGroupCreateInfoKHR& shaderGroup = shaderGroups.emplace_back();
 			shaderGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
@@ -164,8 +147,8 @@ namespace Charon {
 
 		if (m_Specification.ClosestHitShader)
 		{
-			const VkPipelineShaderStageCreateInfo& shaderStage = m_Specification.ClosestHitShader->GetShaderCreateInfo()[0];
-			shaderStages.emplace_back(shaderStage);
+			VkPipelineShaderStageCreateInfo& shaderStage = shaderStages.emplace_back(m_Specification.ClosestHitShader->GetShaderCreateInfo()[0]);
+			shaderStage.pSpecializationInfo = m_Specification.Permutation.GetSpecializationInfo();
 
 			VkRayTracingShaderGroupCreateInfoKHR& shaderGroup = shaderGroups.emplace_back();
 			shaderGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
@@ -186,7 +169,7 @@ namespace Charon {
 		rayTracingPipelineCreateInfo.pGroups = shaderGroups.data();
 		rayTracingPipelineCreateInfo.maxPipelineRayRecursionDepth = 4;
 		rayTracingPipelineCreateInfo.layout = m_PipelineLayout;
-		VK_CHECK_RESULT(vkCreateRayTracingPipelinesKHR(device, VK_NULL_HANDLE, VK_NULL_HANDLE, 1, &rayTracingPipelineCreateInfo, nullptr, &m_Pipeline));
+		VK_CHECK_RESULT(vkCreateRayTracingPipelinesKHR(device, VK_NULL_HANDLE, PipelineCache::GetPipelineCache(), 1, &rayTracingPipelineCreateInfo, nullptr, &m_Pipeline));
 
 		// Shader handles + binding table
 
@@ -220,6 +203,9 @@ namespace Charon {
 		}
 	}
 
-	
+	void VulkanRayTracingPipeline::PushDescriptorSet(VkCommandBuffer commandBuffer, const DescriptorInfo* descriptors)
+	{
+		vkCmdPushDescriptorSetWithTemplateKHR(commandBuffer, m_DescriptorUpdateTemplate, m_PipelineLayout, 0, descriptors);
+	}
 
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include "Charon/Graphics/Shader.h"
+#include "Charon/Graphics/ShaderPermutation.h"
 #include "Charon/Graphics/VulkanAllocator.h"
 #include <vulkan/vulkan.h>
 
@@ -10,6 +11,9 @@ namespace Charon {
 		Ref<Shader> RayGenShader;
 		Ref<Shader> MissShader;
 		Ref<Shader> ClosestHitShader;
+
+		// Applied to every stage
+		ShaderPermutation Permutation;
 	};
 
 	class VulkanRayTracingPipeline
@@ -30,6 +34,9 @@ namespace Charon {
 		inline VkPipelineLayout GetPipelineLayout() { return m_PipelineLayout; }
 		inline const VkDescriptorSetLayout& GetDescriptorSetLayout() { return m_DescriptorSetLayout; }
 		const std::vector<RTBufferInfo>& GetShaderBindingTable() { return m_ShaderBindingTable; }
+
+		// Writes set 0, data is a DescriptorInfo array indexed by binding
+		void PushDescriptorSet(VkCommandBuffer commandBuffer, const DescriptorInfo* descriptors);
 	private:
 		void Init();
 	private:
@@ -38,11 +45,11 @@ namespace Charon {
 		VkPipeline m_Pipeline = nullptr;
 		VkPipelineLayout m_PipelineLayout = nullptr;
 		VkDescriptorSetLayout m_DescriptorSetLayout = nullptr;
+		VkDescriptorUpdateTemplate m_DescriptorUpdateTemplate = nullptr;
 
 		std::vector<uint8_t> m_ShaderHandleStorage;
 		std::vector<RTBufferInfo> m_ShaderBindingTable;
 
-		bool m_OwnLayout = false;
 		Ref<Shader> m_Shader;
 	};
 
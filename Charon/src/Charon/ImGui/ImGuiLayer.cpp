@@ -2,6 +2,7 @@
 #include "ImGuiLayer.h"
 #include "Charon/Core/Application.h"
 #include "Charon/Graphics/VulkanTools.h"
+#include "Charon/Graphics/PipelineCache.h"
 #include "Charon/ImGui/imgui_impl_glfw.h"
 #include "Charon/ImGui/imgui_impl_vulkan_with_textures.h"
 
@@ -87,7 +88,7 @@ namespace Charon {
         init_info.Device = device->GetLogicalDevice();
         init_info.QueueFamily = device->GetQueueIndices().GraphicsQueue.value();
         init_info.Queue = device->GetGraphicsQueue();
-        init_info.PipelineCache = VK_NULL_HANDLE;
+        init_info.PipelineCache = PipelineCache::GetPipelineCache();
         init_info.DescriptorPool = m_DescriptorPool;
         init_info.Allocator = nullptr;
         init_info.MinImageCount = swapChain->GetMinImageCount();
@@ -347,6 +347,22 @@ static ImGui_ImplVulkan_Data* ImGui_ImplVulkan_GetBackendData()
     return ImGui::GetCurrentContext() ? (ImGui_ImplVulkan_Data*)ImGui::GetIO().BackendRendererUserData : NULL;
 }
 
+// Descriptor sets handed out by ImGui_ImplVulkan_AddTexture, one per sampler/view/layout combination.
+// They live in the ImGui descriptor pool until ImGui_ImplVulkan_RemoveTexture is called for the view.
+struct ImGui_ImplVulkan_TextureKey
+{
+    VkSampler       Sampler;
+    VkImageView     ImageView;
+    VkImageLayout   ImageLayout;
+
+    bool operator<(const ImGui_ImplVulkan_TextureKey& other) const
+    {
+        return std::tie(ImageView, Sampler, ImageLayout) < std::tie(other.ImageView, other.Sampler, other.ImageLayout);
+    }
+};
+
+static std::map<ImGui_ImplVulkan_TextureKey, VkDescriptorSet> s_TextureCache;
+
 static uint32_t ImGui_ImplVulkan_MemoryType(VkMemoryPropertyFlags properties, uint32_t type_bits)
 {
     ImGui_ImplVulkan_Data* bd = ImGui_ImplVulkan_GetBackendData();
@@ -1117,6 +1133,9 @@ void ImGui_ImplVulkan_Shutdown()
     // Clean up windows
     ImGui_ImplVulkan_ShutdownPlatformInterface();
 
+    // Cached texture sets are released together with the descriptor pool
+    s_TextureCache.clear();
+
     io.BackendRendererName = NULL;
     io.BackendRendererUserData = NULL;
     IM_DELETE(bd);
@@ -1457,27 +1476,36 @@ void ImGui_ImplVulkanH_CreateWindowSwapChain(VkPhysicalDevice physical_device, V
     }
 }
 
-struct VkDetails
+ImTextureID ImGui_ImplVulkan_AddTexture(VkSampler sampler, VkImageView image_view, VkImageLayout image_layout)
 {
-    VkSampler sampler;
-    VkImageView image_view;
-    VkImageLayout image_layout;
-    VkDescriptorSet descriptor_set;
-};
+    ImGui_ImplVulkan_TextureKey key = { sampler, image_view, image_layout };
+    auto it = s_TextureCache.find(key);
+    if (it != s_TextureCache.end())
+        return (ImTextureID)it->second;
 
-static std::unordered_map<void*, VkDetails> s_VulkanCache;
-ImTextureID ImGui_ImplVulkan_AddTexture(VkSampler sampler, VkImageView image_view, VkImageLayout image_layout)
+    VkDescriptorSet descriptor_set = (VkDescriptorSet)ImGui_ImplVulkan_AddTexture_Internal(sampler, image_view, image_layout);
+    s_TextureCache[key] = descriptor_set;
+    return (ImTextureID)descriptor_set;
+}
+
+void ImGui_ImplVulkan_RemoveTexture(VkImageView image_view)
 {
     ImGui_ImplVulkan_Data* bd = ImGui_ImplVulkan_GetBackendData();
-    ImGui_ImplVulkan_InitInfo* v = &bd->VulkanInitInfo;
-    VkDescriptorSetAllocateInfo alloc_info = {};
-    alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    alloc_info.descriptorSetCount = 1;
-    alloc_info.pSetLayouts = &bd->DescriptorSetLayout;
-    VkDescriptorSet descriptor_set = Charon::Renderer::AllocateDescriptorSet(alloc_info);
-    ImGui_ImplVulkan_UpdateTextureInfo(descriptor_set, sampler, image_view, image_layout);
-    return (ImTextureID)descriptor_set;
+
+    // Entries are ordered by view first, so all sets for this view are adjacent
+    auto it = s_TextureCache.lower_bound({ VK_NULL_HANDLE, image_view, (VkImageLayout)0 });
+    while (it != s_TextureCache.end() && it->first.ImageView == image_view)
+    {
+        if (bd != NULL)
+        {
+            ImGui_ImplVulkan_InitInfo* v = &bd->VulkanInitInfo;
+            VkResult err = vkFreeDescriptorSets(v->Device, v->DescriptorPool, 1, &it->second);
+            check_vk_result(err);
+        }
+        it = s_TextureCache.erase(it);
+    }
 }
+
 ImTextureID ImGui_ImplVulkan_AddTexture_Internal(VkSampler sampler, VkImageView image_view, VkImageLayout image_layout)
 {
     ImGui_ImplVulkan_Data* bd = ImGui_ImplVulkan_GetBackendData();
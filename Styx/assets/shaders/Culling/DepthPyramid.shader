@@ -0,0 +1,36 @@
+#Shader Compute
+#version 450
+
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+// Depth attachment for the first mip, previous pyramid mip otherwise
+layout(binding = 0) uniform sampler2D u_Source;
+layout(binding = 1, r32f) uniform writeonly image2D o_Destination;
+
+layout(push_constant) uniform PyramidData
+{
+	uvec2 SourceSize;
+	uvec2 DestinationSize;
+} u_PyramidData;
+
+void main()
+{
+	uvec2 texel = gl_GlobalInvocationID.xy;
+	if (any(greaterThanEqual(texel, u_PyramidData.DestinationSize)))
+		return;
+
+	// Source footprint of this texel, covers up to 3x3 texels when the source is not a power of two
+	uvec2 begin = (texel * u_PyramidData.SourceSize) / u_PyramidData.DestinationSize;
+	uvec2 end = ((texel + 1) * u_PyramidData.SourceSize + u_PyramidData.DestinationSize - 1) / u_PyramidData.DestinationSize;
+	end = min(end, u_PyramidData.SourceSize);
+
+	// Keep the farthest depth so testing against it never rejects a visible object
+	float depth = 0.0;
+	for (uint y = begin.y; y < end.y; y++)
+	{
+		for (uint x = begin.x; x < end.x; x++)
+			depth = max(depth, texelFetch(u_Source, ivec2(x, y), 0).r);
+	}
+
+	imageStore(o_Destination, ivec2(texel), vec4(depth));
+}
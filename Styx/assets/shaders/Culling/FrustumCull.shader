@@ -0,0 +1,206 @@
+#Shader Compute
+#version 450
+
+layout(local_size_x = 64, local_size_y = 1, local_size_z = 1) in;
+
+// Must match Charon::GPUDrawCommand, one per batch of instances sharing a submesh
+struct DrawCommand
+{
+	vec4 BoundsMin;
+	vec4 BoundsMax;
+	uint IndexCount;
+	uint FirstIndex;
+	int VertexOffset;
+	uint InstanceOffset;
+	uint InstanceCount;
+};
+
+// Must match VkDrawIndexedIndirectCommand
+struct DrawIndexedIndirectCommand
+{
+	uint IndexCount;
+	uint InstanceCount;
+	uint FirstIndex;
+	int VertexOffset;
+	uint FirstInstance;
+};
+
+layout(std430, binding = 0) readonly buffer DrawBuffer
+{
+	DrawCommand Draws[];
+} u_DrawBuffer;
+
+// Submitted transforms first, then the visible transforms of the early and late phase, MaxInstanceCount each
+layout(std430, binding = 1) buffer InstanceBuffer
+{
+	mat4 Transforms[];
+} u_InstanceBuffer;
+
+// Early phase commands first, late phase commands start at MaxInstanceCount
+layout(std430, binding = 2) writeonly buffer IndirectBuffer
+{
+	DrawIndexedIndirectCommand Commands[];
+} u_IndirectBuffer;
+
+layout(std430, binding = 3) buffer DrawCountBuffer
+{
+	uint DrawCounts[2];
+} u_DrawCountBuffer;
+
+// Result of the early phase for every instance, read by the late phase
+layout(std430, binding = 4) buffer VisibilityBuffer
+{
+	uint States[];
+} u_VisibilityBuffer;
+
+layout(binding = 5) uniform sampler2D u_DepthPyramid;
+
+layout(push_constant) uniform CullData
+{
+	mat4 ViewProjection; // Matches the depth pyramid
+	vec4 FrustumPlanes[6];
+	vec2 DepthPyramidSize;
+	uint DepthPyramidMipCount;
+	uint DrawCount;
+	uint MaxInstanceCount;
+	uint Phase;
+	uint OcclusionCulling;
+} u_CullData;
+
+const uint PHASE_EARLY = 0;
+const uint PHASE_LATE = 1;
+
+const uint STATE_CULLED = 0;
+const uint STATE_OCCLUDED = 1;
+const uint STATE_DRAWN = 2;
+
+shared uint s_VisibleCount;
+
+bool IsInsideFrustum(vec3 worldCenter, vec3 worldExtents)
+{
+	for (int i = 0; i < 6; i++)
+	{
+		vec4 plane = u_CullData.FrustumPlanes[i];
+		float distance = dot(plane.xyz, worldCenter) + plane.w;
+		float radius = dot(abs(plane.xyz), worldExtents);
+
+		if (distance + radius < 0.0)
+			return false;
+	}
+
+	return true;
+}
+
+bool IsOccluded(vec3 worldCenter, vec3 worldExtents)
+{
+	// Screen space rectangle and nearest depth of the box
+	vec2 uvMin = vec2(1.0);
+	vec2 uvMax = vec2(0.0);
+	float nearestDepth = 1.0;
+
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = worldCenter + worldExtents * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+		vec4 clip = u_CullData.ViewProjection * vec4(corner, 1.0);
+
+		// Boxes crossing the near plane can't be projected, treat them as visible
+		if (clip.w <= 0.0 || clip.z < 0.0)
+			return false;
+
+		vec3 ndc = clip.xyz / clip.w;
+		uvMin = min(uvMin, ndc.xy * 0.5 + 0.5);
+		uvMax = max(uvMax, ndc.xy * 0.5 + 0.5);
+		nearestDepth = min(nearestDepth, ndc.z);
+	}
+
+	uvMin = clamp(uvMin, vec2(0.0), vec2(1.0));
+	uvMax = clamp(uvMax, vec2(0.0), vec2(1.0));
+
+	// Pick the mip where the rectangle covers at most 2x2 texels
+	vec2 size = (uvMax - uvMin) * u_CullData.DepthPyramidSize;
+	uint mip = min(uint(ceil(log2(max(max(size.x, size.y), 1.0)))), u_CullData.DepthPyramidMipCount - 1);
+
+	ivec2 mipSize = max(ivec2(u_CullData.DepthPyramidSize) >> int(mip), ivec2(1));
+	ivec2 texelMin = clamp(ivec2(uvMin * vec2(mipSize)), ivec2(0), mipSize - 1);
+	ivec2 texelMax = clamp(ivec2(uvMax * vec2(mipSize)), ivec2(0), mipSize - 1);
+
+	float farthestDepth = 0.0;
+	for (int y = texelMin.y; y <= texelMax.y; y++)
+	{
+		for (int x = texelMin.x; x <= texelMax.x; x++)
+			farthestDepth = max(farthestDepth, texelFetch(u_DepthPyramid, ivec2(x, y), int(mip)).r);
+	}
+
+	return nearestDepth > farthestDepth;
+}
+
+bool IsInstanceVisible(uint instanceIndex, vec3 center, vec3 extents)
+{
+	// The late phase only re-tests instances the early phase rejected with the previous frame's pyramid
+	if (u_CullData.Phase == PHASE_LATE && u_VisibilityBuffer.States[instanceIndex] != STATE_OCCLUDED)
+		return false;
+
+	// Transform the local box into a world space center and extents
+	mat4 transform = u_InstanceBuffer.Transforms[instanceIndex];
+	vec3 worldCenter = vec3(transform * vec4(center, 1.0));
+	vec3 worldExtents = mat3(abs(transform[0].xyz), abs(transform[1].xyz), abs(transform[2].xyz)) * extents;
+
+	if (u_CullData.Phase == PHASE_LATE)
+		return !IsOccluded(worldCenter, worldExtents);
+
+	if (!IsInsideFrustum(worldCenter, worldExtents))
+	{
+		u_VisibilityBuffer.States[instanceIndex] = STATE_CULLED;
+		return false;
+	}
+
+	if (u_CullData.OcclusionCulling != 0 && IsOccluded(worldCenter, worldExtents))
+	{
+		u_VisibilityBuffer.States[instanceIndex] = STATE_OCCLUDED;
+		return false;
+	}
+
+	u_VisibilityBuffer.States[instanceIndex] = STATE_DRAWN;
+	return true;
+}
+
+void main()
+{
+	// One workgroup per batch, folded into y past the dispatch size limit
+	uint drawIndex = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+	if (drawIndex >= u_CullData.DrawCount)
+		return;
+
+	if (gl_LocalInvocationIndex == 0)
+		s_VisibleCount = 0;
+
+	barrier();
+
+	DrawCommand draw = u_DrawBuffer.Draws[drawIndex];
+	vec3 center = (draw.BoundsMin.xyz + draw.BoundsMax.xyz) * 0.5;
+	vec3 extents = (draw.BoundsMax.xyz - draw.BoundsMin.xyz) * 0.5;
+
+	// Visible transforms are compacted into this phase's region, at the same offset the batch has in the submitted one
+	uint firstInstance = (u_CullData.Phase + 1) * u_CullData.MaxInstanceCount + draw.InstanceOffset;
+
+	for (uint i = gl_LocalInvocationIndex; i < draw.InstanceCount; i += gl_WorkGroupSize.x)
+	{
+		uint instanceIndex = draw.InstanceOffset + i;
+		if (IsInstanceVisible(instanceIndex, center, extents))
+			u_InstanceBuffer.Transforms[firstInstance + atomicAdd(s_VisibleCount, 1)] = u_InstanceBuffer.Transforms[instanceIndex];
+	}
+
+	barrier();
+
+	// One instanced command for the batch
+	if (gl_LocalInvocationIndex != 0 || s_VisibleCount == 0)
+		return;
+
+	uint commandIndex = u_CullData.Phase * u_CullData.MaxInstanceCount + atomicAdd(u_DrawCountBuffer.DrawCounts[u_CullData.Phase], 1);
+
+	u_IndirectBuffer.Commands[commandIndex].IndexCount = draw.IndexCount;
+	u_IndirectBuffer.Commands[commandIndex].InstanceCount = s_VisibleCount;
+	u_IndirectBuffer.Commands[commandIndex].FirstIndex = draw.FirstIndex;
+	u_IndirectBuffer.Commands[commandIndex].VertexOffset = draw.VertexOffset;
+	u_IndirectBuffer.Commands[commandIndex].FirstInstance = firstInstance;
+}
@@ -20,11 +20,14 @@ layout(location = 0) rayPayloadInEXT Payload g_RayPayload;
 
 hitAttributeEXT vec2 g_HitAttributes;
 
-layout(std430, binding = 4) buffer Vertices { float Data[]; } m_VertexBuffers[];
-layout(std430, binding = 5) buffer Indices { uint Data[]; } m_IndexBuffers[];
+layout(std430, binding = 4) buffer Vertices { float Data[]; } m_VertexBuffer;
+layout(std430, binding = 5) buffer Indices { uint Data[]; } m_IndexBuffer;
 layout(std430, binding = 6) buffer SubmeshData { uint Data[]; } m_SubmeshData;
 layout(std430, binding = 8) buffer Materials { float Data[]; } m_Materials;
-layout(binding = 9) uniform sampler2D u_Textures[];
+
+// Bindless resources
+layout(set = 1, binding = 0) uniform texture2D u_Textures[];
+layout(set = 1, binding = 1) uniform sampler u_Samplers[];
 
 struct Vertex
 {
@@ -47,7 +50,7 @@ struct Material
 	uint RoughnessMap;
 };
 
-Vertex UnpackVertex(uint vertexBufferIndex, uint index, uint vertexOffset)
+Vertex UnpackVertex(uint index, uint vertexOffset)
 {
 	index += vertexOffset;
 
@@ -57,31 +60,31 @@ Vertex UnpackVertex(uint vertexBufferIndex, uint index, uint vertexOffset)
 	const int offset = stride / 4;
 
 	vertex.Position = vec3(
-		m_VertexBuffers[vertexBufferIndex].Data[offset * index + 0],
-		m_VertexBuffers[vertexBufferIndex].Data[offset * index + 1],
-		m_VertexBuffers[vertexBufferIndex].Data[offset * index + 2]
+		m_VertexBuffer.Data[offset * index + 0],
+		m_VertexBuffer.Data[offset * index + 1],
+		m_VertexBuffer.Data[offset * index + 2]
 	);
 
 	vertex.Normal = vec3(
-		m_VertexBuffers[vertexBufferIndex].Data[offset * index + 3],
-		m_VertexBuffers[vertexBufferIndex].Data[offset * index + 4],
-		m_VertexBuffers[vertexBufferIndex].Data[offset * index + 5]
+		m_VertexBuffer.Data[offset * index + 3],
+		m_VertexBuffer.Data[offset * index + 4],
+		m_VertexBuffer.Data[offset * index + 5]
 	);
 
 	vertex.Tangent = vec3(
-		m_VertexBuffers[vertexBufferIndex].Data[offset * index + 6],
-		m_VertexBuffers[vertexBufferIndex].Data[offset * index + 7],
-		m_VertexBuffers[vertexBufferIndex].Data[offset * index + 8]
+		m_VertexBuffer.Data[offset * index + 6],
+		m_VertexBuffer.Data[offset * index + 7],
+		m_VertexBuffer.Data[offset * index + 8]
 	);
 
 
-	float binormalSign = m_VertexBuffers[vertexBufferIndex].Data[offset * index + 9];
+	float binormalSign = m_VertexBuffer.Data[offset * index + 9];
 
 	vertex.Binormal = cross(normalize(vertex.Normal), normalize(vertex.Tangent)) * binormalSign;
 
 	vertex.TextureCoords = vec2(
-		m_VertexBuffers[vertexBufferIndex].Data[offset * index + 10],
-		m_VertexBuffers[vertexBufferIndex].Data[offset * index + 11]
+		m_VertexBuffer.Data[offset * index + 10],
+		m_VertexBuffer.Data[offset * index + 11]
 	);
 
 	return vertex;
@@ -136,21 +139,20 @@ Material UnpackMaterial(uint materialIndex)
 
 void main()
 {
-	uint bufferIndex = m_SubmeshData.Data[gl_InstanceCustomIndexEXT * 4 + 0];
-	uint vertexOffset = m_SubmeshData.Data[gl_InstanceCustomIndexEXT * 4 + 1];
-	uint indexOffset = m_SubmeshData.Data[gl_InstanceCustomIndexEXT * 4 + 2];
-	uint materialIndex = m_SubmeshData.Data[gl_InstanceCustomIndexEXT * 4 + 3];
+	uint vertexOffset = m_SubmeshData.Data[gl_InstanceCustomIndexEXT * 3 + 0];
+	uint indexOffset = m_SubmeshData.Data[gl_InstanceCustomIndexEXT * 3 + 1];
+	uint materialIndex = m_SubmeshData.Data[gl_InstanceCustomIndexEXT * 3 + 2];
 
 	Material material = UnpackMaterial(materialIndex);
 
-	uint index0 = m_IndexBuffers[bufferIndex].Data[gl_PrimitiveID * 3 + 0 + indexOffset];
-	uint index1 = m_IndexBuffers[bufferIndex].Data[gl_PrimitiveID * 3 + 1 + indexOffset];
-	uint index2 = m_IndexBuffers[bufferIndex].Data[gl_PrimitiveID * 3 + 2 + indexOffset];
+	uint index0 = m_IndexBuffer.Data[gl_PrimitiveID * 3 + 0 + indexOffset];
+	uint index1 = m_IndexBuffer.Data[gl_PrimitiveID * 3 + 1 + indexOffset];
+	uint index2 = m_IndexBuffer.Data[gl_PrimitiveID * 3 + 2 + indexOffset];
 	
 	Vertex vertices[3] = Vertex[](
-		UnpackVertex(bufferIndex, index0, vertexOffset),
-		UnpackVertex(bufferIndex, index1, vertexOffset),
-		UnpackVertex(bufferIndex, index2, vertexOffset)
+		UnpackVertex(index0, vertexOffset),
+		UnpackVertex(index1, vertexOffset),
+		UnpackVertex(index2, vertexOffset)
 	);
 
 	// Weight to each vertex
@@ -187,7 +189,7 @@ void main()
 	// sample texture
 	if (material.AlbedoMap > 0)
 		//g_RayPayload.Albedo = vec3(1, 0, 1);
-		g_RayPayload.Albedo = texture(u_Textures[material.AlbedoMap], vertex.TextureCoords).rgb;
+		g_RayPayload.Albedo = texture(sampler2D(u_Textures[nonuniformEXT(material.AlbedoMap)], u_Samplers[0]), vertex.TextureCoords).rgb;
 
 	g_RayPayload.Metallic = material.Metallic;
 	g_RayPayload.Roughness = material.Roughness;
@@ -49,6 +49,10 @@ layout(location = 0) rayPayloadEXT Payload g_RayPayload;
 const float PI = 3.14159265359;
 const float Epsilon = 0.00001;
 
+// Specialization constants, set by RayTracingLayer
+layout(constant_id = 0) const int MAX_BOUNCES = 10;
+layout(constant_id = 1) const int SAMPLES_PER_PIXEL = 2;
+
 ////////////////////////////////////////////////////////////////
 // Utility Functions ///////////////////////////////////////////
 ////////////////////////////////////////////////////////////////
@@ -289,7 +293,6 @@ vec3 TracePath(RayDesc ray, uint seed)
 	uint mask = 0xff;
 
 	vec3 color = vec3(0.0);
-	const int MAX_BOUNCES = 10;
 
 	float numPaths = 0.0f;
 	bool twoSided = false;
@@ -360,8 +363,7 @@ void main()
 
 	vec3 color = vec3(0.0);
 
-	int samples = 2;
-	for (int i = 0; i < samples; i++)
+	for (int i = 0; i < SAMPLES_PER_PIXEL; i++)
 	{
 		vec2 pixelCenter = vec2(gl_LaunchIDEXT.xy) + vec2(0.5);
 		//if (i > 0)
@@ -385,7 +387,7 @@ void main()
 		color += TracePath(desc, seed);
 	}
 
-	float numPaths = samples;
+	float numPaths = SAMPLES_PER_PIXEL;
 	if (frameNumber > 1)
 	{
 		vec4 data = imageLoad(o_AccumulationImage, ivec2(gl_LaunchIDEXT.xy));
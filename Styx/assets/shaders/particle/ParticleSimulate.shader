@@ -143,13 +143,17 @@ vec3 reconstruct_position(in vec2 uv, in float z, in mat4 inverse_view_projectio
 const uint THREADCOUNT_EMIT = 256;
 const uint THREADCOUNT_SIMULATION = 256;
 
+// Specialization constants, set by ParticleLayer
+layout(constant_id = 0) const bool ENABLE_DEPTH_COLLISION = true;
+layout(constant_id = 1) const uint GRADIENT_POINT_COUNT = 0;
+
 /////////////////////////////
 // Move to include  ^
 /////////////////////////////
 
 vec3 GetParticleColor(float lifePercentage, vec3 particleColor)
 {
-	if (u_Emitter.GradientPointCount == 0)
+	if (GRADIENT_POINT_COUNT == 0)
 		return particleColor;
 
 	// Gradient position == lifePercentage
@@ -161,14 +165,14 @@ vec3 GetParticleColor(float lifePercentage, vec3 particleColor)
 	upper.Position = -1.0f;
 
 	// If only 1 point, or we're beneath the first point, return the first point
-	if (u_Emitter.GradientPointCount == 1 || position <= u_Emitter.ColorGradientPoints[0].Position)
+	if (GRADIENT_POINT_COUNT == 1 || position <= u_Emitter.ColorGradientPoints[0].Position)
 		return u_Emitter.ColorGradientPoints[0].Color;
 
 	// If we're beyond the last point, return the last point
-	if (position >= u_Emitter.ColorGradientPoints[u_Emitter.GradientPointCount - 1].Position)
-		return u_Emitter.ColorGradientPoints[u_Emitter.GradientPointCount - 1].Color;
+	if (position >= u_Emitter.ColorGradientPoints[GRADIENT_POINT_COUNT - 1].Position)
+		return u_Emitter.ColorGradientPoints[GRADIENT_POINT_COUNT - 1].Color;
 
-	for (int i = 0; i < u_Emitter.GradientPointCount; i++)
+	for (int i = 0; i < GRADIENT_POINT_COUNT; i++)
 	{
 		if (u_Emitter.ColorGradientPoints[i].Position <= position)
 		{
@@ -260,7 +264,8 @@ void main()
 			particle.Position += particle.Velocity * u_Emitter.DeltaTime;
 			particle.Velocity.y -= u_Emitter.Gravity * u_Emitter.DeltaTime;
 			particle.CurrentLife -= u_Emitter.DeltaTime;
-			//particle.Color = GetParticleColor(1.0f - particle.CurrentLife / particle.Lifetime, particle.Color);
+			if (GRADIENT_POINT_COUNT > 0)
+				particle.Color = GetParticleColor(1.0f - particle.CurrentLife / particle.Lifetime, particle.Color);
 			
 			// particle.Velocity.x = 5.0f;
 			// particle.Velocity.y = 0.0f;
@@ -284,6 +289,7 @@ void main()
 			u_CameraDistanceBuffer.DistanceToCamera[newAliveIndex] = distSQ;
 
 			// Depth buffer collisions
+			if (ENABLE_DEPTH_COLLISION)
 			{
 				vec4 pos2D = u_CameraBuffer.ViewProjection * vec4(particle.Position.xyz, 1);
 				pos2D.xyz /= pos2D.w; // pos2D.w == near -> far (0.1 -> 100)
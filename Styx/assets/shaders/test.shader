@@ -9,21 +9,23 @@ layout(location = 3) in vec2 a_TexCoord;
 layout(location = 0) out vec3 v_WorldPosition;
 layout(location = 1) out vec3 v_Normal;
 
-layout(push_constant) uniform constants
-{
-    mat4 Transform;
-} PushConstants;
-
 layout(set = 0, binding = 0) uniform CameraBuffer
 {
     mat4 ViewProjection;
     mat4 InverseViewProjection;
 } u_CameraBuffer;
 
+layout(std430, set = 0, binding = 1) readonly buffer InstanceBuffer
+{
+    mat4 Transforms[];
+} s_InstanceBuffer;
+
 void main() 
 {
-    v_WorldPosition = vec3(PushConstants.Transform * vec4(a_Position, 1.0));
-    gl_Position = u_CameraBuffer.ViewProjection * PushConstants.Transform * vec4(a_Position, 1.0);
+    mat4 transform = s_InstanceBuffer.Transforms[gl_InstanceIndex];
+
+    v_WorldPosition = vec3(transform * vec4(a_Position, 1.0));
+    gl_Position = u_CameraBuffer.ViewProjection * transform * vec4(a_Position, 1.0);
     v_Normal = a_Normal;
 }
 
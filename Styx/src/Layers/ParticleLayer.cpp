@@ -94,10 +94,15 @@ namespace Charon {
 		m_ParticleShaders.End = CreateRef<Shader>("assets/shaders/particle/ParticleEnd.shader");
 
 		// Pipelines
-		m_ParticlePipelines.Begin = CreateRef<VulkanComputePipeline>(m_ParticleShaders.Begin);
-		m_ParticlePipelines.Emit = CreateRef<VulkanComputePipeline>(m_ParticleShaders.Emit);
-		m_ParticlePipelines.Simulate = CreateRef<VulkanComputePipeline>(m_ParticleShaders.Simulate);
-		m_ParticlePipelines.End = CreateRef<VulkanComputePipeline>(m_ParticleShaders.End);
+		m_ParticlePipelines.Begin.Set(CreateRef<VulkanComputePipeline>(m_ParticleShaders.Begin));
+		m_ParticlePipelines.Emit.Set(CreateRef<VulkanComputePipeline>(m_ParticleShaders.Emit));
+		ShaderPermutation simulatePermutation = GetSimulatePermutation();
+		m_SimulatePermutationHash = simulatePermutation.GetHash();
+		m_ParticlePipelines.Simulate.Set(m_SimulatePermutations.Get(simulatePermutation, [this](const ShaderPermutation& permutation)
+		{
+			return CreateRef<VulkanComputePipeline>(m_ParticleShaders.Simulate, nullptr, -1, permutation);
+		}));
+		m_ParticlePipelines.End.Set(CreateRef<VulkanComputePipeline>(m_ParticleShaders.End));
 
 		// Buffers
 		m_ParticleBuffers.ParticleBuffer = CreateRef<StorageBuffer>(sizeof(Particle) * m_MaxParticles);
@@ -107,7 +112,7 @@ namespace Charon {
 		m_ParticleBuffers.DeadBuffer = CreateRef<StorageBuffer>(sizeof(uint32_t) * m_MaxParticles);
 		m_ParticleBuffers.CounterBuffer = CreateRef<StorageBuffer>(sizeof(CounterBuffer));
 		m_ParticleBuffers.IndirectDrawBuffer = CreateRef<StorageBuffer>(sizeof(IndirectDrawBuffer), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
-		m_ParticleBuffers.VertexBuffer = CreateRef<StorageBuffer>(sizeof(ParticleVertex) * 4 * m_MaxParticles, false, true);
+		m_ParticleBuffers.VertexBuffer = CreateRef<StorageBuffer>(sizeof(ParticleVertex) * 4 * m_MaxParticles, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
 		m_ParticleBuffers.CameraDistanceBuffer = CreateRef<StorageBuffer>(sizeof(uint32_t) * m_MaxParticles, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
 		m_ParticleBuffers.ParticleDrawDetails = CreateRef<UniformBuffer>(&m_ParticleDrawDetails, sizeof(ParticleDrawDetails));
 		m_ParticleBuffers.IndexBuffer = CreateRef<IndexBuffer>(sizeof(uint32_t) * m_MaxIndices, m_MaxIndices);
@@ -115,6 +120,7 @@ namespace Charon {
 		// Display
 		m_Camera = CreateRef<Camera>(glm::perspectiveFov(glm::radians(45.0f), 1280.0f, 720.0f, 0.1f, 100.0f));
 		m_ViewportPanel = CreateRef<ViewportPanel>();
+		m_MemoryStatsPanel = CreateRef<MemoryStatsPanel>();
 
 		// Init buffers 
 		{
@@ -149,23 +155,7 @@ namespace Charon {
 		// Particle renderer pipeline
 		{
 			m_ParticleShader = CreateRef<Shader>("assets/shaders/particle/particle.shader");
-
-			VertexBufferLayout* layout = new VertexBufferLayout({
-				{ ShaderUniformType::FLOAT3, offsetof(ParticleVertex, Position) },
-			});
-
-			// TODO: Fix incorrect stride calculation for structs
-			layout->SetStride(layout->GetStride() + sizeof(float));
-
-			PipelineSpecification pipelineSpec;
-			pipelineSpec.Shader = m_ParticleShader;
-			pipelineSpec.TargetRenderPass = renderer->GetFramebuffer()->GetRenderPass();
-			pipelineSpec.Layout = layout;
-			pipelineSpec.WriteDepth = false;
-
-			m_ParticleRendererPipeline = CreateRef<VulkanPipeline>(pipelineSpec);
-
-			delete layout;
+			m_ParticleRendererPipeline.Set(CreateRendererPipeline(m_ParticleShader, renderer->GetFramebuffer()->GetRenderPass()));
 		}
 
 		// Particle renderer write descriptors
@@ -186,16 +176,16 @@ namespace Charon {
 			
 			VkWriteDescriptorSet& cameraWriteDescriptor = m_ParticleRendererWriteDescriptors.emplace_back();
 			cameraWriteDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			cameraWriteDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			cameraWriteDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 			cameraWriteDescriptor.dstBinding = 2;
-			cameraWriteDescriptor.pBufferInfo = &renderer->GetCameraUB()->getDescriptorBufferInfo();
+			cameraWriteDescriptor.pBufferInfo = &renderer->GetCameraUB()->GetDynamicDescriptorBufferInfo();
 			cameraWriteDescriptor.descriptorCount = 1;
 
 			VkWriteDescriptorSet& particleDrawDetailsWriteDescriptor = m_ParticleRendererWriteDescriptors.emplace_back();
 			particleDrawDetailsWriteDescriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			particleDrawDetailsWriteDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			particleDrawDetailsWriteDescriptor.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 			particleDrawDetailsWriteDescriptor.dstBinding = 3;
-			particleDrawDetailsWriteDescriptor.pBufferInfo = &m_ParticleBuffers.ParticleDrawDetails->getDescriptorBufferInfo();
+			particleDrawDetailsWriteDescriptor.pBufferInfo = &m_ParticleBuffers.ParticleDrawDetails->GetDynamicDescriptorBufferInfo();
 			particleDrawDetailsWriteDescriptor.descriptorCount = 1;
 
 		}
@@ -253,16 +243,16 @@ namespace Charon {
 
 			VkWriteDescriptorSet& emitterBufferWD = m_ParticleSimulationWriteDescriptors.emplace_back();
 			emitterBufferWD.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			emitterBufferWD.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			emitterBufferWD.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 			emitterBufferWD.dstBinding = 7;
-			emitterBufferWD.pBufferInfo = &m_ParticleBuffers.EmitterBuffer->getDescriptorBufferInfo();
+			emitterBufferWD.pBufferInfo = &m_ParticleBuffers.EmitterBuffer->GetDynamicDescriptorBufferInfo();
 			emitterBufferWD.descriptorCount = 1;
 
 			VkWriteDescriptorSet& cameraBufferWD = m_ParticleSimulationWriteDescriptors.emplace_back();
 			cameraBufferWD.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			cameraBufferWD.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			cameraBufferWD.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 			cameraBufferWD.dstBinding = 8;
-			cameraBufferWD.pBufferInfo = &renderer->GetCameraUB()->getDescriptorBufferInfo();
+			cameraBufferWD.pBufferInfo = &renderer->GetCameraUB()->GetDynamicDescriptorBufferInfo();
 			cameraBufferWD.descriptorCount = 1;
 
 			VkWriteDescriptorSet& cameraDistanceBufferWD = m_ParticleSimulationWriteDescriptors.emplace_back();
@@ -297,6 +287,17 @@ namespace Charon {
 			m_NeedsClear = false;
 		}
 
+		// Switching a baked setting back to a permutation built before reuses its pipeline
+		ShaderPermutation simulatePermutation = GetSimulatePermutation();
+		if (simulatePermutation.GetHash() != m_SimulatePermutationHash)
+			RebuildSimulatePipeline(simulatePermutation);
+
+		m_ParticlePipelines.Begin.Update();
+		m_ParticlePipelines.Emit.Update();
+		m_ParticlePipelines.Simulate.Update();
+		m_ParticlePipelines.End.Update();
+		m_ParticleRendererPipeline.Update();
+
 		m_Camera->Update();
 
 		// Skip if paused 
@@ -327,6 +328,8 @@ namespace Charon {
 
 		// Upload emitter buffer
 		m_ParticleBuffers.EmitterBuffer->UpdateBuffer(&m_Emitter);
+		m_ParticleBuffers.EmitterBuffer->Upload();
+		renderer->GetCameraUB()->Upload();
 		
 		Ref<StorageBuffer> activeParticleBuffer;
 
@@ -359,6 +362,9 @@ namespace Charon {
 			vkUpdateDescriptorSets(device->GetLogicalDevice(), m_ParticleSimulationWriteDescriptors.size(), m_ParticleSimulationWriteDescriptors.data(), 0, NULL);
 		}
 
+		// Offsets of the dynamic uniform buffers in binding order, emitter then camera
+		std::array<uint32_t, 2> simulationOffsets = { m_ParticleBuffers.EmitterBuffer->GetDynamicOffset(), renderer->GetCameraUB()->GetDynamicOffset() };
+
 		// Particle compute
 		{
 			{
@@ -366,8 +372,8 @@ namespace Charon {
 				{
 					VkCommandBuffer commandBuffer = device->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
-					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Begin->GetPipeline());
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Begin->GetPipelineLayout(), 0, 1, &m_ParticleSimulationDescriptorSet, 0, 0);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Begin.Get()->GetPipeline());
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Begin.Get()->GetPipelineLayout(), 0, 1, &m_ParticleSimulationDescriptorSet, (uint32_t)simulationOffsets.size(), simulationOffsets.data());
 					vkCmdDispatch(commandBuffer, 1, 1, 1);
 
 					device->FlushCommandBuffer(commandBuffer, true);
@@ -377,8 +383,8 @@ namespace Charon {
 				{
 					VkCommandBuffer commandBuffer = device->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
-					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Emit->GetPipeline());
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Emit->GetPipelineLayout(), 0, 1, &m_ParticleSimulationDescriptorSet, 0, 0);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Emit.Get()->GetPipeline());
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Emit.Get()->GetPipelineLayout(), 0, 1, &m_ParticleSimulationDescriptorSet, (uint32_t)simulationOffsets.size(), simulationOffsets.data());
 
 					VkDeviceSize offset = { 0 };
 					vkCmdDispatchIndirect(commandBuffer, m_ParticleBuffers.IndirectDrawBuffer->GetBuffer(), offset);
@@ -390,8 +396,8 @@ namespace Charon {
 				{
 					VkCommandBuffer commandBuffer = device->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
-					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Simulate->GetPipeline());
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Simulate->GetPipelineLayout(), 0, 1, &m_ParticleSimulationDescriptorSet, 0, 0);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Simulate.Get()->GetPipeline());
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.Simulate.Get()->GetPipelineLayout(), 0, 1, &m_ParticleSimulationDescriptorSet, (uint32_t)simulationOffsets.size(), simulationOffsets.data());
 
 					VkDeviceSize offset = { offsetof(IndirectDrawBuffer, DispatchSimulation) };
 					vkCmdDispatchIndirect(commandBuffer, m_ParticleBuffers.IndirectDrawBuffer->GetBuffer(), offset);
@@ -403,8 +409,8 @@ namespace Charon {
 				{
 					VkCommandBuffer commandBuffer = device->CreateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
 
-					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.End->GetPipeline());
-					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.End->GetPipelineLayout(), 0, 1, &m_ParticleSimulationDescriptorSet, 0, 0);
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.End.Get()->GetPipeline());
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_ParticlePipelines.End.Get()->GetPipelineLayout(), 0, 1, &m_ParticleSimulationDescriptorSet, (uint32_t)simulationOffsets.size(), simulationOffsets.data());
 					vkCmdDispatch(commandBuffer, 1, 1, 1);
 
 					device->FlushCommandBuffer(commandBuffer, true);
@@ -448,6 +454,81 @@ namespace Charon {
 		return -1;
 	}
 
+	void ParticleLayer::ReloadShaders()
+	{
+		m_ParticlePipelines.Begin.Rebuild([]() { return CreateComputePipeline("assets/shaders/particle/ParticleBegin.shader"); });
+		m_ParticlePipelines.Emit.Rebuild([]() { return CreateComputePipeline("assets/shaders/particle/ParticleEmit.shader"); });
+		m_SimulatePermutations.Clear();
+		RebuildSimulatePipeline(GetSimulatePermutation());
+		m_ParticlePipelines.End.Rebuild([]() { return CreateComputePipeline("assets/shaders/particle/ParticleEnd.shader"); });
+
+		VkRenderPass renderPass = Application::GetApp().GetRenderer()->GetFramebuffer()->GetRenderPass();
+		m_ParticleRendererPipeline.Rebuild([renderPass]() -> Ref<VulkanPipeline>
+		{
+			Ref<Shader> shader = CreateRef<Shader>("assets/shaders/particle/particle.shader");
+			if (!shader->CompiledSuccessfully())
+				return nullptr;
+
+			return CreateRendererPipeline(shader, renderPass);
+		});
+	}
+
+	ShaderPermutation ParticleLayer::GetSimulatePermutation()
+	{
+		// Gradient lookups loop over a constant point count, so the compiler can unroll them or remove them entirely
+		uint32_t gradientPointCount = 0;
+		if (m_EnableColorOverLifetime)
+			gradientPointCount = (uint32_t)std::min(m_ColorLifetimeGradient.getMarks().size(), std::size(m_Emitter.ColorGradientPoints));
+
+		ShaderPermutation permutation;
+		permutation.Set(EnableDepthCollision, m_EnableDepthCollision);
+		permutation.Set(GradientPointCount, gradientPointCount);
+		return permutation;
+	}
+
+	void ParticleLayer::RebuildSimulatePipeline(const ShaderPermutation& permutation)
+	{
+		m_SimulatePermutationHash = permutation.GetHash();
+		m_ParticlePipelines.Simulate.Rebuild([this, permutation]()
+		{
+			return m_SimulatePermutations.Get(permutation, [](const ShaderPermutation& simulatePermutation)
+			{
+				return CreateComputePipeline("assets/shaders/particle/ParticleSimulate.shader", simulatePermutation);
+			});
+		});
+	}
+
+	// Runs on a worker thread, descriptor sets are shared with the old pipeline so the set layouts must not change
+	Ref<VulkanComputePipeline> ParticleLayer::CreateComputePipeline(const std::string& path, const ShaderPermutation& permutation)
+	{
+		Ref<Shader> shader = CreateRef<Shader>(path);
+		if (!shader->CompiledSuccessfully())
+		{
+			CR_LOG_CRITICAL("Failed to compile {0}", path);
+			return nullptr;
+		}
+
+		return CreateRef<VulkanComputePipeline>(shader, nullptr, -1, permutation);
+	}
+
+	Ref<VulkanPipeline> ParticleLayer::CreateRendererPipeline(Ref<Shader> shader, VkRenderPass renderPass)
+	{
+		VertexBufferLayout layout({
+			{ ShaderUniformType::FLOAT3, offsetof(ParticleVertex, Position) },
+		});
+
+		// TODO: Fix incorrect stride calculation for structs
+		layout.SetStride(layout.GetStride() + sizeof(float));
+
+		PipelineSpecification pipelineSpec;
+		pipelineSpec.Shader = shader;
+		pipelineSpec.TargetRenderPass = renderPass;
+		pipelineSpec.Layout = &layout;
+		pipelineSpec.WriteDepth = false;
+
+		return CreateRef<VulkanPipeline>(pipelineSpec);
+	}
+
 	void ParticleLayer::OnRender()
 	{
 		auto renderer = Application::GetApp().GetRenderer();
@@ -512,14 +593,17 @@ namespace Charon {
 			// Particles (no clear)
 			renderer->BeginRenderPass(renderer->GetFramebuffer());
 			{
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ParticleRendererPipeline->GetPipeline());
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ParticleRendererPipeline.Get()->GetPipeline());
 
 				VkDeviceSize offset = 0;
 				VkBuffer vertexBuffer = m_ParticleBuffers.VertexBuffer->GetBuffer();
 				vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
 
 				vkCmdBindIndexBuffer(commandBuffer, m_ParticleBuffers.IndexBuffer->GetBuffer(), 0, VK_INDEX_TYPE_UINT32);
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ParticleRendererPipeline->GetPipelineLayout(), 0, 1, &m_ParticleRendererDescriptorSet, 0, 0);
+				// Dynamic uniform buffers in binding order, camera then draw details
+				m_ParticleBuffers.ParticleDrawDetails->Upload();
+				std::array<uint32_t, 2> rendererOffsets = { renderer->GetCameraUB()->GetDynamicOffset(), m_ParticleBuffers.ParticleDrawDetails->GetDynamicOffset() };
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ParticleRendererPipeline.Get()->GetPipelineLayout(), 0, 1, &m_ParticleRendererDescriptorSet, (uint32_t)rendererOffsets.size(), rendererOffsets.data());
 
 				VkDeviceSize indirectBufferOffset = { offsetof(IndirectDrawBuffer, DrawParticles) };
 				vkCmdDrawIndexedIndirect(commandBuffer, m_ParticleBuffers.IndirectDrawBuffer->GetBuffer(), indirectBufferOffset, 1, 0);
@@ -535,6 +619,7 @@ namespace Charon {
 	void ParticleLayer::OnImGUIRender()
 	{
 		m_NeedsClear = m_ViewportPanel->Render(m_Camera);
+		m_MemoryStatsPanel->Render();
 
 		// Particle Settings Panel
 		{
@@ -576,6 +661,7 @@ namespace Charon {
 				static ImGradientMark* selectedMark = nullptr;
 				bool isDragging = false;
 
+				ImGui::Checkbox("Enable Color Over Lifetime", &m_EnableColorOverLifetime);
 				bool updated = GradientEditor(&m_ColorLifetimeGradient, "Color Over Lifetime", draggingMark, selectedMark, isDragging);
 
 				static ImVec2 values[12];
@@ -665,6 +751,16 @@ namespace Charon {
 			if (ImGui::CollapsingHeader("Debug"))
 			{
 				ImGui::Checkbox("Enable Sorting", &m_EnableSorting);
+				ImGui::Checkbox("Enable Depth Collision", &m_EnableDepthCollision);
+
+				if (ImGui::Button("Reload Shaders"))
+					ReloadShaders();
+
+				if (m_ParticleRendererPipeline.IsBuilding() || m_ParticlePipelines.Simulate.IsBuilding())
+				{
+					ImGui::SameLine();
+					ImGui::TextUnformatted("Compiling...");
+				}
 
 				if (m_Pause)
 				{
@@ -4,9 +4,12 @@
 #include "Charon/Graphics/Camera.h"
 #include "Charon/Graphics/VulkanComputePipeline.h"
 #include "Charon/Graphics/VulkanPipeline.h"
+#include "Charon/Graphics/AsyncPipeline.h"
+#include "Charon/Graphics/ShaderPermutation.h"
 #include "Charon/Graphics/Buffers.h"
 #include "Charon/Graphics/Texture2D.h"
 #include "UI/ViewportPanel.h"
+#include "UI/MemoryStatsPanel.h"
 #include "UI/ImGuiColorGradient.h"
 #include "Particles/ParticleSort.h"
 
@@ -103,10 +106,25 @@ namespace Charon {
         void OnImGUIRender();
     private:
 		int GetGraphIndex(const std::vector<glm::vec2>& bezierCubicPoints, float x);
+
+        // Recompiles every particle shader on the thread pool, the current pipelines are used until they finish
+        void ReloadShaders();
+        static Ref<VulkanComputePipeline> CreateComputePipeline(const std::string& path, const ShaderPermutation& permutation = {});
+
+        // Simulation settings baked into ParticleSimulate.shader as specialization constants
+        enum SimulateConstant : uint32_t
+        {
+            EnableDepthCollision = 0,
+            GradientPointCount = 1
+        };
+        ShaderPermutation GetSimulatePermutation();
+        void RebuildSimulatePipeline(const ShaderPermutation& permutation);
+        static Ref<VulkanPipeline> CreateRendererPipeline(Ref<Shader> shader, VkRenderPass renderPass);
     private:
         // Display
         Ref<Camera> m_Camera;
         Ref<ViewportPanel> m_ViewportPanel;
+        Ref<MemoryStatsPanel> m_MemoryStatsPanel;
 
         // Default emitter
         Emitter m_Emitter;
@@ -124,7 +142,7 @@ namespace Charon {
         Ref<ParticleSort> m_ParticleSort;
 
         // Particle rendering
-        Ref<VulkanPipeline> m_ParticleRendererPipeline;
+        AsyncPipeline<VulkanPipeline> m_ParticleRendererPipeline;
         Ref<Shader> m_ParticleShader;
 
         // DescriptorSet for rendering
@@ -143,12 +161,16 @@ namespace Charon {
             Ref<Shader> End;
         } m_ParticleShaders;
 
+        // Declared before the pipelines so it outlives any build still running on the thread pool
+        PipelinePermutationCache<VulkanComputePipeline> m_SimulatePermutations;
+        uint64_t m_SimulatePermutationHash = 0;
+
         struct ParticlePipelines
         {
-            Ref<VulkanComputePipeline> Begin;
-            Ref<VulkanComputePipeline> Emit;
-            Ref<VulkanComputePipeline> Simulate;
-            Ref<VulkanComputePipeline> End;
+            AsyncPipeline<VulkanComputePipeline> Begin;
+            AsyncPipeline<VulkanComputePipeline> Emit;
+            AsyncPipeline<VulkanComputePipeline> Simulate;
+            AsyncPipeline<VulkanComputePipeline> End;
         } m_ParticlePipelines;
 
         struct ParticleBuffers
@@ -173,6 +195,8 @@ namespace Charon {
 
         // Debug settings
         bool m_EnableSorting = true;
+        bool m_EnableDepthCollision = true;
+        bool m_EnableColorOverLifetime = false;
         bool m_Pause = false;
         bool m_NextFrame = false;
         bool m_NeedsClear = true;
@@ -3,6 +3,8 @@
 #include "Charon/Core/Core.h"
 #include "Charon/Core/Application.h"
 #include "Charon/Graphics/Mesh.h"
+#include "Charon/Graphics/GeometryPool.h"
+#include "Charon/Graphics/BindlessDescriptorSet.h"
 #include "Charon/Graphics/SceneRenderer.h"
 #include "Charon/Scene/Components.h"
 #include "Charon/ImGui/imgui_impl_vulkan_with_textures.h"
@@ -14,44 +16,6 @@
 
 namespace Charon {
 
-	namespace Utils {
-
-		inline VkWriteDescriptorSet WriteDescriptorSet(
-			VkDescriptorSet dstSet,
-			VkDescriptorType type,
-			uint32_t binding,
-			const VkDescriptorBufferInfo* bufferInfo,
-			uint32_t descriptorCount = 1)
-		{
-			VkWriteDescriptorSet writeDescriptorSet{};
-			writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			writeDescriptorSet.dstSet = dstSet;
-			writeDescriptorSet.descriptorType = type;
-			writeDescriptorSet.dstBinding = binding;
-			writeDescriptorSet.pBufferInfo = bufferInfo;
-			writeDescriptorSet.descriptorCount = descriptorCount;
-			return writeDescriptorSet;
-		}
-
-		inline VkWriteDescriptorSet WriteDescriptorSet(
-			VkDescriptorSet dstSet,
-			VkDescriptorType type,
-			uint32_t binding,
-			const VkDescriptorImageInfo* imageInfo,
-			uint32_t descriptorCount = 1)
-		{
-			VkWriteDescriptorSet writeDescriptorSet{};
-			writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			writeDescriptorSet.dstSet = dstSet;
-			writeDescriptorSet.descriptorType = type;
-			writeDescriptorSet.dstBinding = binding;
-			writeDescriptorSet.pImageInfo = imageInfo;
-			writeDescriptorSet.descriptorCount = descriptorCount;
-			return writeDescriptorSet;
-		}
-	}
-
-
 	RayTracingLayer::RayTracingLayer()
 		: Layer("RayTracing")
 	{
@@ -63,6 +27,7 @@ namespace Charon {
 		m_Scene = CreateRef<Scene>();
 		m_Camera = CreateRef<Camera>(glm::perspectiveFov(glm::radians(45.0f), 1280.0f, 720.0f, 0.1f, 100.0f));
 		m_ViewportPanel = CreateRef<ViewportPanel>();
+		m_MemoryStatsPanel = CreateRef<MemoryStatsPanel>();
 
 		m_SceneObject = m_Scene->CreateObject("Test Object");
 		//m_MeshHandle = AssetManager::Load<Mesh>("assets/models/CornellWithSphere.gltf");
@@ -75,8 +40,8 @@ namespace Charon {
 			m_AccelerationStructure = CreateRef<VulkanAccelerationStructure>(spec);
 		}
 
-		if (!CreateRayTracingPipeline())
-			CR_LOG_CRITICAL("Failed to create Ray Tracing pipeline!");
+		// Rays are not traced until the pipeline has finished building
+		RebuildRayTracingPipeline();
 
 		{
 			ImageSpecification spec;
@@ -108,14 +73,15 @@ namespace Charon {
 		m_Camera->Update();
 		m_Scene->Update();
 
-		if (!m_Accumulate)
+		// Restart accumulation when a rebuilt pipeline is swapped in
+		if (m_RayTracingPipeline.Update() || !m_Accumulate)
 			m_SceneBuffer.FrameIndex = 1;
 		m_SceneUB->UpdateBuffer(&m_SceneBuffer);
 	}
 
 	void RayTracingLayer::RayTracingPass()
 	{
-		if (m_RTWidth == 0 || m_RTHeight == 0)
+		if (m_RTWidth == 0 || m_RTHeight == 0 || !m_RayTracingPipeline.IsReady())
 			return;
 
 		// Resize image if needed
@@ -126,107 +92,101 @@ namespace Charon {
 			m_Camera->SetProjectionMatrix(glm::perspectiveFov(glm::radians(45.0f), (float)m_RTWidth, (float)m_RTHeight, 0.1f, 100.0f));
 		}
 
-		Ref<VulkanDevice> device = Application::GetApp().GetVulkanDevice();
 		auto renderer = Application::GetApp().GetRenderer();
-		VkCommandBuffer commandBuffer = renderer->GetActiveCommandBuffer();
 
 		Ref<UniformBuffer> uniformBuffer = renderer->GetCameraUB();
-		Ref<StorageBuffer> submeshDataSB = m_AccelerationStructure->GetSubmeshDataStorageBuffer();
-
-		VkDescriptorSetAllocateInfo descriptorSetInfo{};
-		descriptorSetInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		descriptorSetInfo.pSetLayouts = &m_RayTracingPipeline->GetDescriptorSetLayout();
-		descriptorSetInfo.descriptorSetCount = 1;
-
-		VkDescriptorSet descriptorSet = renderer->AllocateDescriptorSet(descriptorSetInfo);
-
-		VkWriteDescriptorSetAccelerationStructureKHR asDescriptorWrite{};
-		asDescriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR;
-		asDescriptorWrite.accelerationStructureCount = 1;
-		asDescriptorWrite.pAccelerationStructures = &m_AccelerationStructure->GetAccelerationStructure();
-
-		VkWriteDescriptorSet accelerationStructureWrite{};
-		accelerationStructureWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		accelerationStructureWrite.pNext = &asDescriptorWrite;
-		accelerationStructureWrite.dstSet = descriptorSet;
-		accelerationStructureWrite.dstBinding = 0;
-		accelerationStructureWrite.descriptorCount = 1;
-		accelerationStructureWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+		uniformBuffer->Upload();
+		m_SceneUB->Upload();
 
-		const auto& asSpec = m_AccelerationStructure->GetSpecification();
-
-		std::vector<VkDescriptorBufferInfo> vertexBufferInfos;
-		{
-			VkBuffer vb = asSpec.Mesh->GetVertexBuffer()->GetBuffer();
-			vertexBufferInfos.push_back({ vb, 0, VK_WHOLE_SIZE });
-		}
+		Ref<StorageBuffer> submeshDataSB = m_AccelerationStructure->GetSubmeshDataStorageBuffer();
 
-		std::vector<VkDescriptorBufferInfo> indexBufferInfos;
-		{
-			VkBuffer ib = asSpec.Mesh->GetIndexBuffer()->GetBuffer();
-			indexBufferInfos.push_back({ ib, 0, VK_WHOLE_SIZE });
-		}
-		
-		std::vector<VkDescriptorImageInfo> textureImageInfos;
+		std::array<DescriptorInfo, 9> descriptors;
+		descriptors[0] = m_AccelerationStructure->GetAccelerationStructure();
+		descriptors[1] = m_Image->GetDescriptorImageInfo();
+		descriptors[2] = m_AccumulationImage->GetDescriptorImageInfo();
+		descriptors[3] = uniformBuffer->getDescriptorBufferInfo();
+		descriptors[4] = VkDescriptorBufferInfo{ GeometryPool::GetVertexBuffer(), 0, VK_WHOLE_SIZE };
+		descriptors[5] = VkDescriptorBufferInfo{ GeometryPool::GetIndexBuffer(), 0, VK_WHOLE_SIZE };
+		descriptors[6] = submeshDataSB->getDescriptorBufferInfo();
+		descriptors[7] = m_SceneUB->getDescriptorBufferInfo();
+		descriptors[8] = m_AccelerationStructure->GetMaterialBuffer()->getDescriptorBufferInfo();
+
+		// Any material may be hit, so every texture of the scene counts as used
+		for (const Ref<Texture2D>& texture : m_AccelerationStructure->GetTextures())
+			texture->MarkUsed();
+
+		// Accumulation reads last frame's result, so both images are ordered against the previous frame as well
+		Ref<RenderGraph> graph = renderer->GetRenderGraph();
+		RenderGraphResource image = graph->ImportImage(m_Image);
+		RenderGraphResource accumulationImage = graph->ImportImage(m_AccumulationImage);
+
+		graph->AddPass("RayTracing", {
+			{ image, RenderGraphAccess::RayTracingWrite },
+			{ accumulationImage, RenderGraphAccess::RayTracingWrite } },
+			[&](VkCommandBuffer commandBuffer)
 		{
-			const auto& textures = m_AccelerationStructure->GetTextures();
-			for (auto texture : textures)
-			{
-				textureImageInfos.push_back(texture->GetDescriptorImageInfo());
-			}
-		}
+			Ref<VulkanRayTracingPipeline> pipeline = m_RayTracingPipeline.Get();
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline->GetPipeline());
+			pipeline->PushDescriptorSet(commandBuffer, descriptors.data());
+			BindlessDescriptorSet::Bind(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipeline->GetPipelineLayout());
 
-		std::vector<VkWriteDescriptorSet> rayTracingWriteDescriptors = {
-			accelerationStructureWrite,
-			Utils::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, &m_Image->GetDescriptorImageInfo()),
-			Utils::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2, &m_AccumulationImage->GetDescriptorImageInfo()),
-			Utils::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3, &uniformBuffer->getDescriptorBufferInfo()),
-			Utils::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4, vertexBufferInfos.data(), (uint32_t)vertexBufferInfos.size()),
-			Utils::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5, indexBufferInfos.data(), (uint32_t)indexBufferInfos.size()),
-			Utils::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 6, &submeshDataSB->getDescriptorBufferInfo()),
-			Utils::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 7, &m_SceneUB->getDescriptorBufferInfo()),
-			Utils::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 8, &m_AccelerationStructure->GetMaterialBuffer()->getDescriptorBufferInfo()),
-			Utils::WriteDescriptorSet(descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 9, textureImageInfos.data(), (uint32_t)textureImageInfos.size()),
-		};
+			const auto& shaderBindingTable = pipeline->GetShaderBindingTable();
 
-		vkUpdateDescriptorSets(device->GetLogicalDevice(), rayTracingWriteDescriptors.size(), rayTracingWriteDescriptors.data(), 0, NULL);
+			VkStridedDeviceAddressRegionKHR empty{};
 
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_RayTracingPipeline->GetPipeline());
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_RayTracingPipeline->GetPipelineLayout(), 0, 1, &descriptorSet, 0, 0);
+			vkCmdTraceRaysKHR(commandBuffer,
+				&shaderBindingTable[0].StridedDeviceAddressRegion,
+				&shaderBindingTable[1].StridedDeviceAddressRegion,
+				&shaderBindingTable[2].StridedDeviceAddressRegion,
+				&empty,
+				m_RTWidth,
+				m_RTHeight,
+				1);
+		});
 
-		const auto& shaderBindingTable = m_RayTracingPipeline->GetShaderBindingTable();
+		// The viewport samples the result after the graph
+		graph->AddPass("Present", { { image, RenderGraphAccess::FragmentRead } });
+		graph->Execute(renderer->GetActiveCommandBuffer());
 
-		VkStridedDeviceAddressRegionKHR empty{};
+		m_SceneBuffer.FrameIndex++;
+	}
 
-		vkCmdTraceRaysKHR(commandBuffer,
-			&shaderBindingTable[0].StridedDeviceAddressRegion,
-			&shaderBindingTable[1].StridedDeviceAddressRegion,
-			&shaderBindingTable[2].StridedDeviceAddressRegion,
-			&empty,
-			m_RTWidth,
-			m_RTHeight,
-			1);
+	void RayTracingLayer::RebuildRayTracingPipeline()
+	{
+		ShaderPermutation permutation;
+		permutation.Set(MaxBounces, m_MaxBounces);
+		permutation.Set(SamplesPerPixel, m_SamplesPerPixel);
 
-		m_SceneBuffer.FrameIndex++;
+		m_RayTracingPipeline.Rebuild([this, permutation]() { return m_RayTracingPermutations.Get(permutation, CreateRayTracingPipeline); });
 	}
 
-	bool RayTracingLayer::CreateRayTracingPipeline()
+	// Runs on a worker thread
+	Ref<VulkanRayTracingPipeline> RayTracingLayer::CreateRayTracingPipeline(const ShaderPermutation& permutation)
 	{
 		RayTracingPipelineSpecification spec;
-		spec.RayGenShader = CreateRef<Shader>("assets/shaders/RayTracing/RayGen.glsl");
-		if (!spec.RayGenShader->CompiledSuccessfully())
-			return false;
+		spec.Permutation = permutation;
+
+		// Each shader is compiled on its own thread
+		const std::pair<const char*, Ref<Shader>*> shaders[] =
+		{
+			{ "assets/shaders/RayTracing/RayGen.glsl", &spec.RayGenShader },
+			{ "assets/shaders/RayTracing/Miss.glsl", &spec.MissShader },
+			{ "assets/shaders/RayTracing/ClosestHit.glsl", &spec.ClosestHitShader }
+		};
 
-		spec.MissShader = CreateRef<Shader>("assets/shaders/RayTracing/Miss.glsl");
-		if (!spec.MissShader->CompiledSuccessfully())
-			return false;
+		Application::GetApp().GetThreadPool()->ParallelFor((uint32_t)std::size(shaders), 1, [&](uint32_t begin, uint32_t end, uint32_t slot)
+		{
+			for (uint32_t i = begin; i < end; i++)
+				*shaders[i].second = CreateRef<Shader>(shaders[i].first);
+		});
 
-		spec.ClosestHitShader = CreateRef<Shader>("assets/shaders/RayTracing/ClosestHit.glsl");
-		if (!spec.ClosestHitShader->CompiledSuccessfully())
-			return false;
+		if (!spec.RayGenShader->CompiledSuccessfully() || !spec.MissShader->CompiledSuccessfully() || !spec.ClosestHitShader->CompiledSuccessfully())
+		{
+			CR_LOG_CRITICAL("Failed to create Ray Tracing pipeline!");
+			return nullptr;
+		}
 
-		m_RayTracingPipeline = CreateRef<VulkanRayTracingPipeline>(spec);
-		return true;
+		return CreateRef<VulkanRayTracingPipeline>(spec);
 	}
 
 	void RayTracingLayer::OnRender()
@@ -239,6 +199,7 @@ namespace Charon {
 	void RayTracingLayer::OnImGUIRender()
 	{
 		m_ViewportPanel->Render(nullptr);
+		m_MemoryStatsPanel->Render();
 
 		ImGui::Begin("Ray Tracing");
 		const auto& descriptorInfo = m_Image->GetDescriptorImageInfo();
@@ -253,8 +214,14 @@ namespace Charon {
 		{
 			if (ImGui::Button("Reload Pipeline"))
 			{
-				if (!CreateRayTracingPipeline())
-					CR_LOG_CRITICAL("Failed to create Ray Tracing pipeline!");
+				m_RayTracingPermutations.Clear();
+				RebuildRayTracingPipeline();
+			}
+
+			if (m_RayTracingPipeline.IsBuilding())
+			{
+				ImGui::SameLine();
+				ImGui::TextUnformatted("Compiling...");
 			}
 
 			if (ImGui::Button("Render"))
@@ -264,6 +231,12 @@ namespace Charon {
 
 			ImGui::Checkbox("Accumulate", &m_Accumulate);
 
+			// Baked into the pipeline, so changing them switches permutation
+			bool permutationChanged = ImGui::SliderInt("Max Bounces", &m_MaxBounces, 1, 16);
+			permutationChanged |= ImGui::SliderInt("Samples Per Pixel", &m_SamplesPerPixel, 1, 16);
+			if (permutationChanged)
+				RebuildRayTracingPipeline();
+
 			ImGui::DragFloat3("Directional Light", glm::value_ptr(m_SceneBuffer.DirectionalLight_Direction), 0.01f, -1.0f, 1.0f);
 			ImGui::DragFloat3("Point Light", glm::value_ptr(m_SceneBuffer.PointLight_Position), 0.01f);
 		}
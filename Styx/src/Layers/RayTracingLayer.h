@@ -8,7 +8,10 @@
 
 #include "Charon/Graphics/VulkanAccelerationStructure.h"
 #include "Charon/Graphics/VulkanRayTracingPipeline.h"
+#include "Charon/Graphics/AsyncPipeline.h"
+#include "Charon/Graphics/ShaderPermutation.h"
 #include "UI/ViewportPanel.h"
+#include "UI/MemoryStatsPanel.h"
 
 namespace Charon {
 
@@ -26,13 +29,22 @@ namespace Charon {
 
 		void RayTracingPass();
 	private:
-		bool CreateRayTracingPipeline();
+		// Specialization constants of RayGen.glsl
+		enum RayGenConstant : uint32_t
+		{
+			MaxBounces = 0,
+			SamplesPerPixel = 1
+		};
+
+		void RebuildRayTracingPipeline();
+		static Ref<VulkanRayTracingPipeline> CreateRayTracingPipeline(const ShaderPermutation& permutation);
 	private:
 		Ref<Camera> m_Camera;
 		Ref<Scene> m_Scene;
 		SceneObject m_SceneObject;
 		AssetHandle m_MeshHandle;
 		Ref<ViewportPanel> m_ViewportPanel;
+		Ref<MemoryStatsPanel> m_MemoryStatsPanel;
 
 		struct SceneBuffer
 		{
@@ -46,9 +58,12 @@ namespace Charon {
 		uint32_t m_RTWidth = 0, m_RTHeight = 0;
 
 		bool m_Accumulate = true;
+		int32_t m_MaxBounces = 10;
+		int32_t m_SamplesPerPixel = 2;
 
 		Ref<VulkanAccelerationStructure> m_AccelerationStructure;
-		Ref<VulkanRayTracingPipeline> m_RayTracingPipeline;
+		PipelinePermutationCache<VulkanRayTracingPipeline> m_RayTracingPermutations;
+		AsyncPipeline<VulkanRayTracingPipeline> m_RayTracingPipeline;
 		Ref<Image> m_Image, m_AccumulationImage;
 		std::vector<VkWriteDescriptorSet> m_RayTracingWriteDescriptors;
 	};
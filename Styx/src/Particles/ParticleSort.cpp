@@ -1,4 +1,5 @@
 #include "ParticleSort.h"
+#include "Charon/Graphics/LayoutCache.h"
 #define FFX_CPP
 #include "../assets/shaders/sorting/FFX_ParallelSort.h"
 
@@ -12,18 +13,32 @@ namespace Charon {
     {
         m_MaxParticles = maxParticles;
 
-        Ref<VulkanDevice> device = Application::GetApp().GetVulkanDevice();
-
         // Create buffers
         CreateBuffers();
 
-        // Compile shaders
-        CompileShader(m_ComputePipelines.FPS_Count, "FPS_Count");
-        CompileShader(m_ComputePipelines.FPS_CountReduce, "FPS_CountReduce");
-        CompileShader(m_ComputePipelines.FPS_Scan, "FPS_Scan");
-        CompileShader(m_ComputePipelines.FPS_ScanAdd, "FPS_ScanAdd");
-        CompileShader(m_ComputePipelines.FPS_Scatter, "FPS_Scatter");
-        CompileShader(m_ComputePipelines.FPS_ScatterPayload, "FPS_Scatter", "kRS_ValueCopy"); //#define kRS_ValueCopy
+        // Compile shaders, the variants are independent so they are compiled in parallel
+        struct ShaderVariant
+        {
+            SortPipeline* Pipeline;
+            std::string_view EntryPoint;
+            std::string Define;
+        };
+
+        const ShaderVariant variants[] =
+        {
+            { &m_ComputePipelines.FPS_Count, "FPS_Count", "" },
+            { &m_ComputePipelines.FPS_CountReduce, "FPS_CountReduce", "" },
+            { &m_ComputePipelines.FPS_Scan, "FPS_Scan", "" },
+            { &m_ComputePipelines.FPS_ScanAdd, "FPS_ScanAdd", "" },
+            { &m_ComputePipelines.FPS_Scatter, "FPS_Scatter", "" },
+            { &m_ComputePipelines.FPS_ScatterPayload, "FPS_Scatter", "kRS_ValueCopy" } //#define kRS_ValueCopy
+        };
+
+        Application::GetApp().GetThreadPool()->ParallelFor((uint32_t)std::size(variants), 1, [&](uint32_t begin, uint32_t end, uint32_t slot)
+        {
+            for (uint32_t i = begin; i < end; i++)
+                CompileShader(*variants[i].Pipeline, variants[i].EntryPoint, variants[i].Define);
+        });
 
         // Create main sorting pipeline
         {
@@ -32,12 +47,7 @@ namespace Charon {
             constant_range.offset = 0;
             constant_range.size = 4;
 
-            VkPipelineLayoutCreateInfo layout_create_info = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-            layout_create_info.pNext = nullptr;
-            layout_create_info.flags = 0;
-            layout_create_info.setLayoutCount = 6;
-
-            std::vector<VkDescriptorSetLayout> layouts(layout_create_info.setLayoutCount);
+            std::vector<VkDescriptorSetLayout> layouts(6);
             layouts[0] = m_ComputePipelines.FPS_Count.Shader->GetDescriptorSetLayout(0);
             layouts[2] = m_ComputePipelines.FPS_ScatterPayload.Shader->GetDescriptorSetLayout(2);
             layouts[3] = m_ComputePipelines.FPS_ScanAdd.Shader->GetDescriptorSetLayout(3);
@@ -46,19 +56,10 @@ namespace Charon {
             for (size_t i = 0; i < layouts.size(); i++)
             {
                 if (!layouts[i])
-                {
-                    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-                    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-                    layoutInfo.bindingCount = 0;
-                    layoutInfo.pBindings = nullptr;
-                    VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->GetLogicalDevice(), &layoutInfo, nullptr, &layouts[i]));
-                }
+                    layouts[i] = LayoutCache::GetDescriptorSetLayout({});
             }
 
-            layout_create_info.pSetLayouts = layouts.data();
-            layout_create_info.pushConstantRangeCount = 1;
-            layout_create_info.pPushConstantRanges = &constant_range;
-            VK_CHECK_RESULT(vkCreatePipelineLayout(device->GetLogicalDevice(), &layout_create_info, nullptr, &m_SortPipelineLayout))
+            m_SortPipelineLayout = LayoutCache::GetPipelineLayout(layouts, { constant_range });
         }
 
         // Create Pipelines
@@ -333,16 +334,16 @@ namespace Charon {
         }
         else
         {
-            FFX_ParallelSortCB* dst = m_ConstantBuffer->Map<FFX_ParallelSortCB>();
-            memcpy(dst, &constantBufferData, sizeof(FFX_ParallelSortCB));
-            m_ConstantBuffer->Unmap();
+            m_ConstantBuffer->UpdateBuffer(&constantBufferData);
+            m_ConstantBuffer->Upload();
 
-            VkDescriptorBufferInfo constantBuffer = m_ConstantBuffer->getDescriptorBufferInfo();
+            VkDescriptorBufferInfo constantBuffer = m_ConstantBuffer->GetDynamicDescriptorBufferInfo();
             BindConstantBuffer(constantBuffer, m_SortDescriptorSetConstants[frameConstants]);
         }
 
-        // Bind constants
-        vkCmdBindDescriptorSets(commandList, VK_PIPELINE_BIND_POINT_COMPUTE, m_SortPipelineLayout, 0, 1, &m_SortDescriptorSetConstants[frameConstants], 0, nullptr);
+        // Bind constants, the constant buffer binding is dynamic and the indirect constants sit at the start of their buffer
+        uint32_t constantBufferOffset = bIndirectDispatch ? 0 : m_ConstantBuffer->GetDynamicOffset();
+        vkCmdBindDescriptorSets(commandList, VK_PIPELINE_BIND_POINT_COMPUTE, m_SortPipelineLayout, 0, 1, &m_SortDescriptorSetConstants[frameConstants], 1, &constantBufferOffset);
 
         // Perform Radix Sort (currently only support 32-bit key/payload sorting
         uint32_t inputSet = 0;
@@ -515,15 +516,11 @@ namespace Charon {
 
     void ParticleSort::CompileShader(SortPipeline& pipeline, std::string_view entryPoint, const std::string& define /*= ""*/)
     {
+        std::vector<std::wstring> defines;
         if (!define.empty())
-        {
-            std::vector<std::wstring> defines = { std::wstring(define.begin(), define.end()) };
-            pipeline.Shader = CreateRef<Shader>("assets/shaders/sorting/ParallelSortCS.hlsl", entryPoint, defines);
-        }
-        else
-        {
-            pipeline.Shader = CreateRef<Shader>("assets/shaders/sorting/ParallelSortCS.hlsl", entryPoint);
-        }
+            defines.push_back(std::wstring(define.begin(), define.end()));
+
+        pipeline.Shader = CreateRef<Shader>("assets/shaders/sorting/ParallelSortCS.hlsl", entryPoint, defines);
     }
     
     void ParticleSort::CompileAndCreatePipeline(SortPipeline& pipeline, VkPipelineLayout layout)
@@ -564,7 +561,7 @@ namespace Charon {
         write_set.dstBinding = Binding;
         write_set.dstArrayElement = 0;
         write_set.descriptorCount = Count;
-        write_set.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        write_set.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         write_set.pImageInfo = nullptr;
         write_set.pBufferInfo = &GPUCB;
         write_set.pTexelBufferView = nullptr;
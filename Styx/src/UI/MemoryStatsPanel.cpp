@@ -0,0 +1,67 @@
+#include "MemoryStatsPanel.h"
+#include "Charon/Graphics/VulkanAllocator.h"
+#include "Charon/Graphics/ResidencyManager.h"
+
+namespace Charon {
+
+	namespace Utils {
+
+		static float ToMB(uint64_t bytes)
+		{
+			return (float)bytes / (1024.0f * 1024.0f);
+		}
+
+	}
+
+	MemoryStatsPanel::MemoryStatsPanel()
+	{
+	}
+
+	void MemoryStatsPanel::Render()
+	{
+		if (ImGui::Begin("Memory"))
+		{
+			for (const HeapBudget& heap : VulkanAllocator::GetHeapBudgets())
+			{
+				ImGui::Text("Heap %u%s - %.0f MB", heap.HeapIndex, heap.DeviceLocal ? " (device local)" : "", Utils::ToMB(heap.Size));
+
+				char overlay[64];
+				snprintf(overlay, sizeof(overlay), "%.1f / %.1f MB", Utils::ToMB(heap.Usage), Utils::ToMB(heap.Budget));
+				float fraction = heap.Budget > 0 ? (float)((double)heap.Usage / (double)heap.Budget) : 0.0f;
+				ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), overlay);
+
+				ImGui::Text("VMA blocks: %.1f MB, allocations: %.1f MB", Utils::ToMB(heap.BlockBytes), Utils::ToMB(heap.AllocationBytes));
+				ImGui::Separator();
+			}
+
+			ImGui::Text("Residency: %u / %u evicted, %.1f MB saved", ResidencyManager::GetEvictedCount(), ResidencyManager::GetResourceCount(), Utils::ToMB(ResidencyManager::GetEvictedBytes()));
+			ImGui::Separator();
+
+			if (ImGui::BeginTable("Allocations", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders))
+			{
+				ImGui::TableSetupColumn("Tag");
+				ImGui::TableSetupColumn("Count");
+				ImGui::TableSetupColumn("MB");
+				ImGui::TableSetupColumn("Peak MB");
+				ImGui::TableHeadersRow();
+
+				for (const auto& [tag, stats] : VulkanAllocator::GetAllocationStats())
+				{
+					ImGui::TableNextRow();
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted(tag.c_str());
+					ImGui::TableNextColumn();
+					ImGui::Text("%u", stats.AllocationCount);
+					ImGui::TableNextColumn();
+					ImGui::Text("%.2f", Utils::ToMB(stats.Bytes));
+					ImGui::TableNextColumn();
+					ImGui::Text("%.2f", Utils::ToMB(stats.PeakBytes));
+				}
+
+				ImGui::EndTable();
+			}
+		}
+		ImGui::End();
+	}
+
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "Charon/Core/Core.h"
+#include <imgui/imgui.h>
+
+namespace Charon {
+
+	// Heap budgets and per-tag allocation counters from VulkanAllocator
+	class MemoryStatsPanel
+	{
+	public:
+		MemoryStatsPanel();
+
+	public:
+		void Render();
+	};
+
+}
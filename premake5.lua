@@ -92,6 +92,7 @@ project "Charon"
 
 		defines 
 		{
+			"CR_DEBUG",
 			"CR_ENABLE_ASSERTS"
 		}
 
@@ -156,6 +157,7 @@ project "Styx"
 		
 		defines 
 		{
+			"CR_DEBUG",
 			"CR_ENABLE_ASSERTS"
 		}
 